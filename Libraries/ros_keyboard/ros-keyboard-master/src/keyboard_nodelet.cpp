@@ -0,0 +1,68 @@
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/thread.hpp>
+#include "keyboard.h"
+
+namespace keyboard {
+  // Same as main.cpp, but key events are published as shared pointers so
+  // nodelets in the same manager get them without serialization.
+  // SDL has to be polled from the thread that opened the window, so the
+  // keyboard is created and polled in a thread of its own.
+  class KeyboardNodelet : public nodelet::Nodelet {
+    public:
+      KeyboardNodelet() : running(false) {}
+      ~KeyboardNodelet(void)
+      {
+        running = false;
+        if (thread) thread->join();
+      }
+
+    private:
+      virtual void onInit()
+      {
+        ros::NodeHandle& n = getPrivateNodeHandle();
+
+        pub_down = n.advertise<keyboard::Key>("keydown", 10);
+        pub_up = n.advertise<keyboard::Key>("keyup", 10);
+
+        bool allow_repeat=false;
+        n.param<bool>( "allow_repeat", allow_repeat, false ); // disable by default
+        n.param<int>( "repeat_delay", repeat_delay, SDL_DEFAULT_REPEAT_DELAY );
+        n.param<int>( "repeat_interval", repeat_interval, SDL_DEFAULT_REPEAT_INTERVAL );
+
+        if ( !allow_repeat ) repeat_delay=0; // disable
+
+        running = true;
+        thread.reset(new boost::thread(boost::bind(&KeyboardNodelet::poll, this)));
+      }
+
+      void poll()
+      {
+        keyboard::Keyboard kbd( repeat_delay, repeat_interval );
+
+        ros::Rate r(50);
+
+        bool pressed, new_event;
+        uint16_t code, modifiers;
+        while (running && ros::ok() && kbd.get_key(new_event, pressed, code, modifiers)) {
+          if (new_event) {
+            keyboard::KeyPtr k(new keyboard::Key());
+            k->header.stamp = ros::Time::now();
+            k->code = code;
+            k->modifiers = modifiers;
+            if (pressed) pub_down.publish(k);
+            else pub_up.publish(k);
+          }
+          r.sleep();
+        }
+      }
+
+      ros::Publisher pub_down, pub_up;
+      int repeat_delay, repeat_interval;
+      volatile bool running;
+      boost::shared_ptr<boost::thread> thread;
+  };
+}
+
+PLUGINLIB_EXPORT_CLASS(keyboard::KeyboardNodelet, nodelet::Nodelet)
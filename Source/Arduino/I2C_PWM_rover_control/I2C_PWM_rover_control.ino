@@ -11,6 +11,7 @@
 #include "std_msgs/Int16MultiArray.h"
 #include <Wire.h>                     // For I2C
 #include <Adafruit_PWMServoDriver.h>  // For I2C PWM board
+#include <PwmChannel.h>               // Source/Arduino/libraries/PwmChannel (set the sketchbook to Source/Arduino)
 
 
 /* Testing Commands:
@@ -73,6 +74,13 @@ const PROGMEM int STEER_SERVO_SIDE_LEFT_PIN = 13;
 const PROGMEM int STEER_SERVO_FRONT_RIGHT_PIN = 14;
 const PROGMEM int STEER_SERVO_FRONT_LEFT_PIN = 15;
 
+// Arm servo channels, the calibration above carried in the type (see PwmChannel.h)
+typedef AngleServoKind<ARM_SERVO_MIN, ARM_SERVO_MAX, ARM_SERVO_NEUTRAL, ARM_SERVO_FULL_TURN> ArmServo;
+typedef PwmChannel<ARM_BASE_PIN, ArmServo>     ArmBase;
+typedef PwmChannel<ARM_SHOULDER_PIN, ArmServo> ArmShoulder;
+typedef PwmChannel<ARM_ELBOW_PIN, ArmServo>    ArmElbow;
+typedef PwmChannel<ARM_WRIST_PIN, ArmServo>    ArmWrist;
+
 // I2C PWM variables
 Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
 
@@ -80,24 +88,6 @@ Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
 ros::NodeHandle nh;
 
 
-/***** arm_angle_to_pulse()
-  Converts a servo angle (0 - 180) into a PWM pulse
-  @INPUT int - new arm servo angle
-  @RETURN double - pwm pulse
-
-  PWM_pulse = <neurtal_pwm> + (angle/360) * <full_turn_pwm>     */
-uint16_t arm_angle_to_pulse(int int_angle) {
-  double angle = int_angle * 1.0;  // Typecast angle to double to prevent overflow
-  uint16_t pulse = (uint16_t) (ARM_SERVO_NEUTRAL + ((angle*ARM_SERVO_FULL_TURN)/360));
-  // Check if within range
-  if (pulse < ARM_SERVO_MIN) {
-    pulse = (uint16_t) ARM_SERVO_MIN;
-  } else if (pulse > ARM_SERVO_MAX) { 
-    pulse = (uint16_t) ARM_SERVO_MAX;
-  }
-  return pulse;
-}
-
 /***** manual_arm_cmd_update()
   Interpreter for manual arm servo messages.
     Updates A SINGLE SERVO.
@@ -126,9 +116,8 @@ void manual_arm_cmd_update(const std_msgs::Int16MultiArray& cmd_msg) {
     return;   // No angle to update... just return
   }
 
-  // Calculate and set pulse
-  double pulse = arm_angle_to_pulse(new_servo_angle);
-  pwm.setPWM(servo_number, 0, pulse);
+  // Calculate and set pulse (one call site for the four servos)
+  pwm_kind_write<ArmServo>(pwm, servo_number, new_servo_angle);
 }
 
 /***** manual_drive_servo_update() ###
@@ -139,10 +128,7 @@ void manual_arm_cmd_update(const std_msgs::Int16MultiArray& cmd_msg) {
     [1] - new servo angle
 */
 void manual_drive_servo_update(const std_msgs::Int16MultiArray& cmd_msg) {
-  // Get servo servo number and angle from cmd_msg
-  uint8_t servo_number = (uint8_t) cmd_msg.data[0];
-  uint16_t new_servo_angle = (uint16_t) cmd_msg.data[1];
-
+  // Not subscribed yet (see sub_drive_steer_manual)
 }
 
 /***** manual_drive_motor_update() ###
@@ -179,10 +165,10 @@ void setup(){
   pwm.setPWMFreq(PWM_FREQUENCY);
 
   // Send arm servos to home position
-  pwm.setPWM(0, 0, ARM_SERVO_NEUTRAL);
-  pwm.setPWM(1, 0, ARM_SERVO_NEUTRAL);
-  pwm.setPWM(2, 0, ARM_SERVO_NEUTRAL);
-  pwm.setPWM(3, 0, ARM_SERVO_NEUTRAL);
+  ArmBase::home(pwm);
+  ArmShoulder::home(pwm);
+  ArmElbow::home(pwm);
+  ArmWrist::home(pwm);
 
   // Initialize vacuum pump controls
   pinMode(VACUUM_PIN, OUTPUT);
@@ -1,29 +1,62 @@
+//----------    T R A N S P O R T    ----------
+// 1 = RoverProtocol binary frames on Serial (arduino_command_translator _transport:=binary)
+// 0 = rosserial, arduino_cmd topic (serial_node.py)
+#ifndef USE_BINARY_PROTOCOL
+#define USE_BINARY_PROTOCOL 0
+#endif
+// 1 = echo every command's sequence number back (arduino_echo topic or ROVER_FRAME_ECHO
+//     frames) for the latency tracing in arduino_command_translator
+#ifndef TRACE_ECHO
+#define TRACE_ECHO 1
+#endif
+
 #include <avr/pgmspace.h>             // Enable use of PROGMEM
-#include <Wire.h>                     // For I2C PWM board
-#include <Adafruit_PWMServoDriver.h>
-#include <pt.h>                       // Protothread library
+#include <TwiQueue.h>                 // Source/Arduino/libraries/TwiQueue (interrupt driven I2C, replaces Wire)
+#include <PCA9685Batch.h>             // Source/Arduino/libraries/PCA9685Batch (batched channel writes)
+#include <PwmChannel.h>               // Source/Arduino/libraries/PwmChannel (channel kinds and their ranges)
+#include <TickScheduler.h>            // Source/Arduino/libraries/TickScheduler (1 kHz timer tick, task table)
+#include <RoverProtocol.h>            // Source/Arduino/libraries/RoverProtocol (set the sketchbook to Source/Arduino)
+#if !USE_BINARY_PROTOCOL
 #include <ros.h>                      // ROS libraries
 #include <std_msgs/MultiArrayLayout.h>
 #include <std_msgs/MultiArrayDimension.h>
 #include <std_msgs/UInt16MultiArray.h>
+#include <std_msgs/UInt8MultiArray.h>
+#endif
 
 /*----------  R A M   U S A G E  ----------
-  10% - Wire.h
+  (measured on the rover: free_ram in the telemetry, see TELEMETRY)
+  Constants and the channel table are in flash (see CHANNEL TABLE)
+  192 B - TwiQueue ring buffer
+  552 B - rosserial buffers (384 B in, 160 B out, 4 topic slots, see nh)
 
   NEEDED FOR EXECUTION
   36 B - message array
+  67 B - PCA9685 batch (queued pulses, shadow registers)
    2 B - local int in callback
 
    OR 
 
    2 B - local int in motor update
 
+  75 B - motor profiles (5 motors)
+ 180 B - servo moves (by message index)
+  66 B - scheduler task table (3 tasks)
+  76 B - telemetry report being collected
+  90 B - packed telemetry report
+ 128 B - serial output queue
+
 */
 
 /*----------    T E S T I N G   C O M M A N D S    ----------
 To test this code without running the "Mission Control" code:
   $ rosrun rosserial_python serial_node.py _port:=/dev/<PORT NUMBER>
-  $ rostopic pub arm_cmd std_msgs/UInt16MultiArray '{data: [<I2C_INDEX>, <servo_1>, etc.]}' */
+  $ rostopic pub arm_cmd std_msgs/UInt16MultiArray '{data: [<I2C_INDEX>, <servo_1>, etc.]}'
+With USE_BINARY_PROTOCOL (no serial_node.py):
+  $ rosrun manual_keyboard_control arduino_command_translator _transport:=binary _port:=/dev/<PORT NUMBER>
+Without the rover (soak tests and benchmarks on a PC, see Source/Arduino/sim):
+  $ cmake -S Source/Arduino/sim -B build && cmake --build build
+  $ build/arduino_manual_keyboard_control_sim --soak 3600 */
 
 
 /*-----------------------------------------------------------------------------------
@@ -60,111 +93,351 @@ To test this code without running the "Mission Control" code:
 //-----------------------------------------------------------------------------------
 //------------------------------   C O N S T A N T S   ------------------------------
 //-----------------------------------------------------------------------------------
+// Plain consts are folded into the code (no RAM); tables are kept in flash
+// (PROGMEM) and read with pgm_read_*(), see CHANNEL TABLE
 //----------   P W M    C O N S T A N T S   ----------
-const PROGMEM int PWM_FREQUENCY         = 50;
-const PROGMEM int PWM_RESOLUTION        = 4096;
-const PROGMEM uint16_t ABSOLUTE_MAX_PWM = 4093;  // avoid extremes
-const PROGMEM uint16_t ABSOLUTE_MIN_PWM = 3;     // avoid extremes
+const int PWM_FREQUENCY         = 50;
+const uint32_t TWI_FREQUENCY    = 100000;  // I2C clock (the PCA9685 can take 400 kHz)
+const int PWM_RESOLUTION        = 4096;
+const uint16_t ABSOLUTE_MAX_PWM = 4093;  // avoid extremes
+const uint16_t ABSOLUTE_MIN_PWM = 3;     // avoid extremes
 
 //----------   A R M   S E R V O   C O N S T A N T S   ----------
 // # Hitec HS-785HB 
-const PROGMEM int ARM_PWM_MIN         = 126;  // "-315 degrees", min pulse length count (out of 4096@50Hz)
-const PROGMEM int ARM_PWM_MAX         = 504;  // "+315 degrees", max pulse length count (out of 4096@50Hz)
-const PROGMEM int ARM_PWM_NEUTRAL     = 315;  // "0 degrees", center pulse length count (out of 4096@50Hz)
-const PROGMEM int ARM_PWM_360_DEGREES = 216;  // "360 degrees", one full rotation
+const int ARM_PWM_MIN         = 126;  // "-315 degrees", min pulse length count (out of 4096@50Hz)
+const int ARM_PWM_MAX         = 504;  // "+315 degrees", max pulse length count (out of 4096@50Hz)
+const int ARM_PWM_NEUTRAL     = 315;  // "0 degrees", center pulse length count (out of 4096@50Hz)
+const int ARM_PWM_360_DEGREES = 216;  // "360 degrees", one full rotation
 
 //----------   S T E E R I N G   S E R V O   C O N S T A N T S   ----------
-const PROGMEM int STEER_PWM_MIN         = 105;
-const PROGMEM int STEER_PWM_MAX         = 495;
-const PROGMEM int STEER_PWM_NEUTRAL     = 295;
-const PROGMEM int STEER_PWM_360_DEGREES = 720;
+const int STEER_PWM_MIN         = 105;
+const int STEER_PWM_MAX         = 495;
+const int STEER_PWM_NEUTRAL     = 295;
+const int STEER_PWM_360_DEGREES = 720;
 
 //----------   G R I P P E R   S E R V O   C O N S T A N T S   ----------
 // # Hitec HS-422 (gripper rotation servo)
-const PROGMEM int GRIPPER_ROTATE_PWM_MIN         = 105;
-const PROGMEM int GRIPPER_ROTATE_PWM_MAX         = 495;
-const PROGMEM int GRIPPER_ROTATE_PWM_NEUTRAL     = 295;
-const PROGMEM int GRIPPER_ROTATE_PWM_360_DEGREES = 720;
+const int GRIPPER_ROTATE_PWM_MIN         = 105;
+const int GRIPPER_ROTATE_PWM_MAX         = 495;
+const int GRIPPER_ROTATE_PWM_NEUTRAL     = 295;
+const int GRIPPER_ROTATE_PWM_360_DEGREES = 720;
 // # Hitec HS-322HD (gripper claw servo)
-const PROGMEM int GRIPPER_CLAW_PWM_CLOSED = 276;
-const PROGMEM int GRIPPER_CLAW_PWM_OPEN   = 355;
+const int GRIPPER_CLAW_PWM_CLOSED = 276;
+const int GRIPPER_CLAW_PWM_OPEN   = 355;
 
 //----------   D C   M O T O R   C O N S T A N T S   ----------
-const PROGMEM int NEUTRAL_SPEED_PWM     = 292; // Neutral speed PWM value
+const int NEUTRAL_SPEED_PWM     = 292; // Neutral speed PWM value
 
+//----------   C H A N N E L   K I N D S   ----------
+// The calibrations above as PwmChannel kinds, for the CHANNEL TABLE.  The
+// translator sends pulses, so the kinds' conversions are not used here,
+// only their ranges (checked at compile time)
+typedef AngleServoKind<ARM_PWM_MIN, ARM_PWM_MAX, ARM_PWM_NEUTRAL, ARM_PWM_360_DEGREES> ArmServo;
+typedef AngleServoKind<STEER_PWM_MIN, STEER_PWM_MAX, STEER_PWM_NEUTRAL, STEER_PWM_360_DEGREES> SteerServo;
+typedef AngleServoKind<GRIPPER_ROTATE_PWM_MIN, GRIPPER_ROTATE_PWM_MAX,
+                       GRIPPER_ROTATE_PWM_NEUTRAL, GRIPPER_ROTATE_PWM_360_DEGREES> GripperRotateServo;
+typedef PulseKind<GRIPPER_CLAW_PWM_CLOSED, GRIPPER_CLAW_PWM_OPEN, GRIPPER_CLAW_PWM_OPEN> GripperClawServo;
+typedef PulseKind<ABSOLUTE_MIN_PWM, ABSOLUTE_MAX_PWM, NEUTRAL_SPEED_PWM> DriveMotor;  // Ramp targets
 
-//-----------------------------------------------------------------------------------
-//------------------------   P I N S   C O N S T A N T S   --------------------------
-//-----------------------------------------------------------------------------------
-//----------    A R M   P I N S    ----------
-const PROGMEM int ARM_PWM_PIN_BASE     = 0;
-const PROGMEM int ARM_PWM_PIN_SHOULDER = 1;
-const PROGMEM int ARM_PWM_PIN_ELBOW    = 2;
-const PROGMEM int ARM_PWM_PIN_WRIST    = 3;
-
-//----------    S T E E R   P I N S    ----------
-const PROGMEM int STEER_PWM_PIN_R   = 4;
-const PROGMEM int STEER_PWM_PIN_F_R = 5;
-const PROGMEM int STEER_PWM_PIN_F_L = 6;
-
-//----------    G R I P P E R   P I N S    ----------
-const PROGMEM int GRIPPER_PWM_PIN_ROTATE = 8;
-const PROGMEM int GRIPPER_PWM_PIN_CLAW 	 = 9;
-
-//----------    D R I V E   P I N S    ----------
-const PROGMEM int DRIVE_PWM_PIN_R   = 11;
-const PROGMEM int DRIVE_PWM_PIN_S_R = 12;
-const PROGMEM int DRIVE_PWM_PIN_S_L = 13;
-const PROGMEM int DRIVE_PWM_PIN_F_R = 14;
-const PROGMEM int DRIVE_PWM_PIN_F_L = 15;
-
-//----------    M A S T   P I N    ----------
-const PROGMEM int MAST_PWM_PIN = 7;
 
 //-----------------------------------------------------------------------------------
 //--------------   A R R A Y   &   M E S S A G E   C O S N T A N T S   --------------
 //-----------------------------------------------------------------------------------
 //----------    M E S S A G E   I N D E C E S    ----------
-const PROGMEM int MSG_INDEX_ARM_BASE       =  0;
-const PROGMEM int MSG_INDEX_ARM_SHOULDER   =  1;
-const PROGMEM int MSG_INDEX_ARM_ELBOW      =  2;
-const PROGMEM int MSG_INDEX_ARM_WRIST      =  3;
-const PROGMEM int MSG_INDEX_STEER_R        =  4;
-const PROGMEM int MSG_INDEX_STEER_F_R      =  5;
-const PROGMEM int MSG_INDEX_STEER_F_L      =  6;
-const PROGMEM int MSG_INDEX_DRIVE_R        =  7;
-const PROGMEM int MSG_INDEX_DRIVE_S_R      =  8;
-const PROGMEM int MSG_INDEX_DRIVE_S_L      =  9;
-const PROGMEM int MSG_INDEX_DRIVE_F_R      = 10;
-const PROGMEM int MSG_INDEX_DRIVE_F_L      = 11;
-const PROGMEM int MSG_INDEX_GRIPPER_ROTATE = 12;  
-const PROGMEM int MSG_INDEX_GRIPPER_CLAW   = 13;  
-//const PROGMEM int MSG_INDEX_MAST_STEPPER = 14;  // MIGHT NOT BE USED...
+const int MSG_INDEX_ARM_BASE       =  0;
+const int MSG_INDEX_ARM_SHOULDER   =  1;
+const int MSG_INDEX_ARM_ELBOW      =  2;
+const int MSG_INDEX_ARM_WRIST      =  3;
+const int MSG_INDEX_STEER_R        =  4;
+const int MSG_INDEX_STEER_F_R      =  5;
+const int MSG_INDEX_STEER_F_L      =  6;
+const int MSG_INDEX_DRIVE_R        =  7;
+const int MSG_INDEX_DRIVE_S_R      =  8;
+const int MSG_INDEX_DRIVE_S_L      =  9;
+const int MSG_INDEX_DRIVE_F_R      = 10;
+const int MSG_INDEX_DRIVE_F_L      = 11;
+const int MSG_INDEX_GRIPPER_ROTATE = 12;  
+const int MSG_INDEX_GRIPPER_CLAW   = 13;  
+const int MSG_INDEX_MAST_STEPPER   = 14;  // MIGHT NOT BE USED...
+const int MSG_CHANNEL_COUNT        = 15;
+
+//----------    C H A N N E L   T A B L E    ----------
+/* Every channel by message index (the PIN REFERENCE TABLE): its PCA9685 pin,
+    what drives it and the pulses it takes.  In flash, read it with the
+    channel_*() accessors.
+    - CHANNEL_SERVO: the pulse is written to the pin
+    - CHANNEL_MOTOR: the pulse is the target of a DC motor's ramp (see
+                     MOTOR PROFILES), motor array index = message index - MSG_INDEX_DRIVE_R
+    - CHANNEL_NONE:  not driven (yet), its pulses are ignored  */
+const uint8_t CHANNEL_NONE  = 0;
+const uint8_t CHANNEL_SERVO = 1;
+const uint8_t CHANNEL_MOTOR = 2;
+
+struct ChannelDescriptor {
+  uint8_t  pin;
+  uint8_t  msg_index;      // Its own index, so the table can be checked
+  uint8_t  kind;
+  uint16_t pulse_min;
+  uint16_t pulse_max;
+  uint16_t pulse_neutral;  // Home position (servos), stopped (motors)
+};
+
+// A kind's pulse_min, pulse_max, pulse_neutral
+#define CHANNEL_RANGE(KIND)  KIND::PULSE_MIN, KIND::PULSE_MAX, KIND::PULSE_NEUTRAL
+
+const ChannelDescriptor CHANNELS[MSG_CHANNEL_COUNT] PROGMEM = {
+  // PIN  MSG INDEX                 KIND           MIN, MAX, NEUTRAL
+  {  0,  MSG_INDEX_ARM_BASE,       CHANNEL_SERVO, CHANNEL_RANGE(ArmServo) },
+  {  1,  MSG_INDEX_ARM_SHOULDER,   CHANNEL_SERVO, CHANNEL_RANGE(ArmServo) },
+  {  2,  MSG_INDEX_ARM_ELBOW,      CHANNEL_SERVO, CHANNEL_RANGE(ArmServo) },
+  {  3,  MSG_INDEX_ARM_WRIST,      CHANNEL_SERVO, CHANNEL_RANGE(ArmServo) },
+  {  4,  MSG_INDEX_STEER_R,        CHANNEL_SERVO, CHANNEL_RANGE(SteerServo) },
+  {  5,  MSG_INDEX_STEER_F_R,      CHANNEL_SERVO, CHANNEL_RANGE(SteerServo) },
+  {  6,  MSG_INDEX_STEER_F_L,      CHANNEL_SERVO, CHANNEL_RANGE(SteerServo) },
+  { 11,  MSG_INDEX_DRIVE_R,        CHANNEL_MOTOR, CHANNEL_RANGE(DriveMotor) },
+  { 12,  MSG_INDEX_DRIVE_S_R,      CHANNEL_MOTOR, CHANNEL_RANGE(DriveMotor) },
+  { 13,  MSG_INDEX_DRIVE_S_L,      CHANNEL_MOTOR, CHANNEL_RANGE(DriveMotor) },
+  { 14,  MSG_INDEX_DRIVE_F_R,      CHANNEL_MOTOR, CHANNEL_RANGE(DriveMotor) },
+  { 15,  MSG_INDEX_DRIVE_F_L,      CHANNEL_MOTOR, CHANNEL_RANGE(DriveMotor) },
+  {  8,  MSG_INDEX_GRIPPER_ROTATE, CHANNEL_SERVO, CHANNEL_RANGE(GripperRotateServo) },
+  {  9,  MSG_INDEX_GRIPPER_CLAW,   CHANNEL_SERVO, CHANNEL_RANGE(GripperClawServo) },
+  {  7,  MSG_INDEX_MAST_STEPPER,   CHANNEL_NONE,  0, 0, 0 },
+};
+
+//----------    D E L T A   F R A M E S    ----------
+/* arduino_cmd carries three kinds of frame:
+  - Keyframe:    the MSG_CHANNEL_COUNT pulses, in message index order
+  - Delta frame: a tag word (DELTA_FRAME_TAG | <number of changes>) followed by
+                 one word per changed channel: (<message index> << 12) | <pulse>
+  - Move frame:  a tag word (MOVE_FRAME_TAG | <number of moves>) followed by
+                 MOVE_WORDS words per move (see SERVO MOVES)
+  A keyframe or delta frame may end with one more word, the frame's sequence number, which is
+    echoed back on arduino_echo as [<sequence number>, <apply time (us)>]
+    (the apply time ends when the pulses are queued for the I2C bus).
+  Must match arduino_command_translator.cpp  */
+const uint16_t DELTA_FRAME_TAG      = 0xF000;
+const uint16_t DELTA_FRAME_TAG_MASK = 0xF000;
+const uint8_t  DELTA_CHANNEL_SHIFT  = 12;
+const uint16_t DELTA_PULSE_MASK     = 0x0FFF;
+const uint16_t MOVE_FRAME_TAG       = 0xE000;
+
+//----------    M O T O R   P R O F I L E S    ----------
+/* arduino_motor_profile (or a ROVER_FRAME_MOTOR_PROFILE frame's pulses) sets
+    how the DC motors ramp to their targets:
+      <motor mask>    - bit per motor array index the profile is for
+      <profile>       - PROFILE_TRAPEZOIDAL or PROFILE_S_CURVE
+      <acceleration>  - most change of pulse (counts/s)
+      <jerk>          - most change of acceleration (counts/s^2, S-curve only)
+      <emergency deceleration> - most change of pulse (counts/s) when the
+                        target is NEUTRAL_SPEED_PWM (a stop is never S-curved)
+    A 0 leaves that limit as it was.
+  Must match arduino_command_translator.cpp  */
+const uint8_t PROFILE_WORD_MOTORS       = 0;
+const uint8_t PROFILE_WORD_PROFILE      = 1;
+const uint8_t PROFILE_WORD_ACCELERATION = 2;
+const uint8_t PROFILE_WORD_JERK         = 3;
+const uint8_t PROFILE_WORD_EMERGENCY    = 4;
+const uint8_t PROFILE_WORDS             = 5;
+
+const uint8_t PROFILE_TRAPEZOIDAL = 0;
+const uint8_t PROFILE_S_CURVE     = 1;
+
+// Defaults until the translator sends a profile
+const uint16_t DEFAULT_ACCELERATION = 500;   // counts/s (neutral to full speed in ~0.1 s)
+const uint16_t DEFAULT_JERK         = 5000;  // counts/s^2
+const uint16_t DEFAULT_EMERGENCY    = 2000;  // counts/s
+
+const uint8_t MOTOR_FRACTION_BITS = 8;  // Motor pulses and rates are kept in 24.8 fixed point
+
+//----------    S E R V O   M O V E S    ----------
+/* A move frame on arduino_cmd (or a ROVER_FRAME_SERVO_MOVE frame's pulses)
+    moves servos to a pulse over a time instead of in one step, a pair of
+    words per servo:
+      (<message index> << 12) | <target pulse>  - as in a delta frame
+      <duration>                                - ms (0 = at once)
+    The motor task steps every move toward its target once every
+    MOTOR_TASK_PERIOD (the 50 Hz PWM frame), in 16.16 fixed point, so a slow
+    sweep is one message instead of a command per step.
+  A command with another pulse for a moving servo stops the move and sets
+    that pulse; the move's own target (a keyframe repeating it) does not.
+  Must match arduino_command_translator.cpp  */
+const uint8_t MOVE_WORDS         = 2;   // Per servo
+const uint8_t MOVE_FRACTION_BITS = 16;
 
 //----------    M O T O R   A R R A Y   I N D E C E S    ----------
-const PROGMEM int DRIVE_ARRAY_INDEX_R   = 0;
-const PROGMEM int DRIVE_ARRAY_INDEX_S_R = 1;
-const PROGMEM int DRIVE_ARRAY_INDEX_S_L = 2;
-const PROGMEM int DRIVE_ARRAY_INDEX_F_R = 3;
-const PROGMEM int DRIVE_ARRAY_INDEX_F_L = 4;
+// Message indices MSG_INDEX_DRIVE_R to MSG_INDEX_DRIVE_F_L, in order
+const uint8_t MOTOR_COUNT = 5;
 
 
 //-----------------------------------------------------------------------------------
 //-----------------------   G L O B A L   V A R I A B L E S   -----------------------
 //-----------------------------------------------------------------------------------
 //----------    M O T O R   A C C E L E R A T I O N    ----------
-static struct pt motor_protothread;         // Protothread for motor speed updates
-const PROGMEM int MOTOR_PTHREAD_DELAY = 20; // Motor speed update delay (in ms)
-uint16_t target_motor_pwm[5];               // Target pulse for DC motors
-uint16_t current_motor_pwm[5];              // Target pulse for DC motors
+uint16_t target_motor_pwm[MOTOR_COUNT];             // Target pulse for DC motors
+uint16_t current_motor_pwm[MOTOR_COUNT];             // Pulse last set on the DC motors
+
+// Ramp of each DC motor (see MOTOR PROFILES); limits are per motor task
+// period, rates and pulses are 24.8 fixed point counts
+struct MotorProfile {
+  uint8_t  profile;
+  uint16_t acceleration;  // Most change of pulse per period
+  uint16_t jerk;          // Most change of rate per period
+  uint16_t emergency;     // Most change of pulse per period, stopping
+  int32_t  pulse;
+  int32_t  rate;          // Change of pulse over the last period
+};
+MotorProfile motor_profile[MOTOR_COUNT];
+
+//----------    S E R V O   M O V E S    ----------
+// Servo moves in progress (see SERVO MOVES), by message index
+struct ServoMove {
+  uint16_t periods;  // Steps left (0 = not moving)
+  uint16_t target;
+  int32_t  pulse;    // 16.16 fixed point
+  int32_t  step;     // Change of pulse every period
+};
+ServoMove servo_move[MSG_CHANNEL_COUNT];
+
+//----------    S H A D O W   R E F R E S H    ----------
+// Unchanged channels are never rewritten (see PCA9685Batch.h), so every
+// channel is rewritten this often in case the PCA9685 lost its registers
+const unsigned long SHADOW_REFRESH_PERIOD = 2000;  // ms
+unsigned long last_shadow_refresh = 0;
+
+//----------    T A S K S    ----------
+// Periods in scheduler ticks (ms)
+const uint16_t SERIAL_TASK_PERIOD    = 1;     // 115 bytes/tick at 115200 baud, the buffer holds 64
+const uint16_t MOTOR_TASK_PERIOD     = 20;    // Motor speed update period
+const uint16_t TELEMETRY_TASK_PERIOD = 1000;
+
+const uint8_t TASK_SERIAL    = 0;
+const uint8_t TASK_MOTOR     = 1;
+const uint8_t TASK_TELEMETRY = 2;
+const uint8_t TASK_COUNT     = 3;
+
+//----------    T E L E M E T R Y    ----------
+/* Every TELEMETRY_TASK_PERIOD the firmware's statistics since the last report
+    (loop period, command apply time, I2C transaction time, frame and error
+    counts, least free RAM and the timing of every task) are sent as one
+    packed RoverTelemetry report (see RoverProtocol.h): the bytes of an
+    arduino_telemetry UInt8MultiArray, or ROVER_TELEMETRY_PAGES telemetry
+    frames.  arduino_command_translator puts it on /diagnostics.
+  Counting is a few adds and compares per sample; nothing is sent between
+    reports.  */
+RoverTelemetry telemetry;                                         // Report being collected
+uint8_t telemetry_buffer[ROVER_TELEMETRY_PAGES * ROVER_PAYLOAD_SIZE];  // Packed report
+unsigned long last_loop = 0;           // micros() at the last loop()
+unsigned long last_report = 0;         // millis() at the last report
+uint16_t reported_i2c_errors = 0;      // Totals at the last report
+uint16_t reported_i2c_refused = 0;
+uint16_t reported_crc_errors = 0;
+
+//----------    S E R I A L   O U T P U T    ----------
+/* Everything the sketch sends (echoes, telemetry, rosserial's own messages)
+    is queued here, and task_serial() hands Serial only what its 64 B
+    transmit buffer can take, so no task waits on the link (a telemetry
+    report is ~10 ms of it).  A message longer than the free space empties
+    the queue and is written straight, waiting: rosserial's topic
+    negotiation at connect.  The telemetry never does, it waits in
+    telemetry_buffer until it fits (see task_telemetry()).  */
+const uint8_t SERIAL_OUT_SIZE = 128;
+#if USE_BINARY_PROTOCOL
+const uint8_t TELEMETRY_SEND_SIZE = ROVER_TELEMETRY_PAGES * ROVER_FRAME_SIZE;
+#else
+const uint8_t TELEMETRY_SEND_SIZE = ROVER_TELEMETRY_SIZE + 20;  // rosserial framing (8 B), array layout and length (12 B)
+#endif
+uint8_t serial_out[SERIAL_OUT_SIZE];   // Ring buffer
+uint8_t serial_out_head = 0;           // Next byte to send
+uint8_t serial_out_length = 0;         // Bytes queued
+bool telemetry_pending = false;        // telemetry_buffer holds a report not sent yet
+
+/***** serial_out_free() ***
+  @RETURN the bytes serial_out_write() can take without waiting  */
+uint8_t serial_out_free() {
+  return SERIAL_OUT_SIZE - serial_out_length;
+}
+
+/***** serial_out_send() ***
+  Moves as much of the queue as fits into Serial's transmit buffer
+  @INPUT wait - true to write all of it, waiting for the link  */
+void serial_out_send(bool wait) {
+  while (serial_out_length > 0) {
+    uint8_t chunk = min(serial_out_length, (uint8_t) (SERIAL_OUT_SIZE - serial_out_head));
+    if (!wait) {
+      int room = Serial.availableForWrite();
+      if (room <= 0) {
+        return;
+      }
+      chunk = min(chunk, (uint8_t) room);
+    }
+    Serial.write(serial_out + serial_out_head, chunk);
+    serial_out_head = (uint8_t) ((serial_out_head + chunk) % SERIAL_OUT_SIZE);
+    serial_out_length -= chunk;
+  }
+}
+
+/***** serial_out_write() ***
+  Queues bytes for serial_out_send() (or writes them, waiting, if they do
+    not fit)  */
+void serial_out_write(const uint8_t * data, uint16_t length) {
+  if (length > serial_out_free()) {
+    serial_out_send(true);
+    Serial.write(data, length);
+    return;
+  }
+  uint8_t tail = (uint8_t) ((serial_out_head + serial_out_length) % SERIAL_OUT_SIZE);
+  for (uint16_t i = 0; i < length; i++) {
+    serial_out[tail] = data[i];
+    tail = (uint8_t) ((tail + 1) % SERIAL_OUT_SIZE);
+  }
+  serial_out_length += (uint8_t) length;
+}
 
-const PROGMEM uint16_t motor_increment = 1;
+#if !USE_BINARY_PROTOCOL
+// rosserial's ArduinoHardware, writing through the queue
+class QueuedHardware : public ArduinoHardware {
+ public:
+  void write(uint8_t * data, int length) {
+    serial_out_write(data, (uint16_t) length);
+  }
+};
+#endif
 
 //----------    O T H E R   V A R I A B L E S    ----------
-// ROS node handle (makes everything work)
-ros::NodeHandle nh;
-// Adafruit PWM Driver (for driving servos and motors)
-Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
+uint8_t expected_seq = 0;     // Sequence number of the next command frame
+bool seq_synced = false;      // False until the first frame
+#if USE_BINARY_PROTOCOL
+// Binary command frame decoder
+RoverDecoder decoder;
+#if TRACE_ECHO
+RoverFrame echo_frame;        // Echo of the last frame applied
+#endif
+RoverFrame telemetry_frame;
+uint8_t send_buffer[ROVER_FRAME_SIZE];  // Encoded echo/telemetry frame
+#else
+// ROS node handle (makes everything work), sized for this sketch instead of
+// ros::NodeHandle (25 subscribers, 25 publishers, 280 B buffers each way on
+// an ATmega328P): the unused slots and output buffer pay for a longer input
+// buffer.  Output: the telemetry (110 B framed) and the topic negotiation
+// (~105 B for arduino_motor_profile).  More topics need more slots.
+const int ROS_SUBSCRIBERS  = 2;
+const int ROS_PUBLISHERS   = 2;
+const int ROS_INPUT_SIZE   = 384;
+const int ROS_OUTPUT_SIZE  = 160;
+ros::NodeHandle_<QueuedHardware, ROS_SUBSCRIBERS, ROS_PUBLISHERS, ROS_INPUT_SIZE, ROS_OUTPUT_SIZE> nh;
+#if TRACE_ECHO
+// Echo of the last frame applied: [<sequence number>, <apply time (us)>]
+uint16_t echo_data[2];
+std_msgs::UInt16MultiArray echo_msg;
+ros::Publisher pub_arduino_echo("arduino_echo", &echo_msg);
+#endif
+std_msgs::UInt8MultiArray telemetry_msg;
+ros::Publisher pub_arduino_telemetry("arduino_telemetry", &telemetry_msg);
+#endif
+// PCA9685 PWM board (for driving servos and motors): pulses waiting to be
+// written in as few I2C transactions as possible (see PCA9685Batch.h), sent
+// in the background by the TWI interrupt
+PCA9685Batch pwm_batch;
 
 
 
@@ -172,198 +445,548 @@ Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
 //--------------------   C O D E   B E G I N S   H E R E   --------------------------
 //-----------------------------------------------------------------------------------
 
-/* 
-  0 < MIN_REVERSE_SPEED < NEUTRAL_SPEED_PWM < MIN_FORWARD_SPEED < 4096
-
-  Cases:
-    if TARGET > CURRENT
-      if CURRENT == NEUTRAL_SPEED_PWM then CURRENT = MIN_FORWARD_SPEED
-      else increment CURRENT
-    else if TARGET < CURRENT
-      if CURRENT == NEUTRAL_SPEED_PWM then CURRENT = MIN_REVERSE_SPEED
-      else decrement CURRENT
-    else return
-*/
-void pthread_motor_helper(int motor_index, int drive_pwm_pin) {
-  if (target_motor_pwm[motor_index] > current_motor_pwm[motor_index]) {
-    // The target speed is higher than current speed
-    current_motor_pwm[motor_index] += motor_increment;
-  } else if (target_motor_pwm[motor_index] < current_motor_pwm[motor_index]) {
-    // The target speed is lower than the current speed
-    current_motor_pwm[motor_index] -= motor_increment;
+/***** channel_*() ***
+  Fields of a channel's CHANNEL TABLE entry, read from flash
+  @INPUT index - message index of the channel (< MSG_CHANNEL_COUNT)  */
+uint8_t channel_pin(uint8_t index) {
+  return pgm_read_byte(&CHANNELS[index].pin);
+}
+
+uint8_t channel_msg_index(uint8_t index) {
+  return pgm_read_byte(&CHANNELS[index].msg_index);
+}
+
+uint8_t channel_kind(uint8_t index) {
+  return pgm_read_byte(&CHANNELS[index].kind);
+}
+
+uint16_t channel_min(uint8_t index) {
+  return pgm_read_word(&CHANNELS[index].pulse_min);
+}
+
+uint16_t channel_max(uint8_t index) {
+  return pgm_read_word(&CHANNELS[index].pulse_max);
+}
+
+uint16_t channel_neutral(uint8_t index) {
+  return pgm_read_word(&CHANNELS[index].pulse_neutral);
+}
+
+/***** per_period() ***
+  Converts a limit to 24.8 fixed point counts per motor task period
+  @INPUT per_second - counts/s (power 1) or counts/s^2 (power 2)
+  @RETURN at least 1, so a ramp always gets there  */
+uint16_t per_period(uint16_t per_second, uint8_t power) {
+  uint32_t value = (uint32_t) per_second * MOTOR_TASK_PERIOD;
+  if (power == 2) {
+    value = value * MOTOR_TASK_PERIOD * 16 / 62500;  // << 8, / 1000000
   } else {
-    // We are at target speed
-    return;
+    value = (value << MOTOR_FRACTION_BITS) / 1000;
   }
-
-  pwm.setPWM(drive_pwm_pin, 0, current_motor_pwm[motor_index]);
+  return (uint16_t) constrain(value, 1, 0xFFFF);
 }
 
-static int pthread_update_DC_motors(struct pt * pt) {
-  static unsigned long timestamp = 0;
-  PT_BEGIN(pt);
-  while(true) {
-    PT_WAIT_UNTIL(pt, (long)millis() - (long)timestamp > MOTOR_PTHREAD_DELAY);
-    timestamp = millis();
-    
-    pthread_motor_helper(DRIVE_ARRAY_INDEX_R,
-                         DRIVE_PWM_PIN_R);
-    pthread_motor_helper(DRIVE_ARRAY_INDEX_S_R,
-                         DRIVE_PWM_PIN_S_R);
-    pthread_motor_helper(DRIVE_ARRAY_INDEX_S_L, 
-                         DRIVE_PWM_PIN_S_L);
-    pthread_motor_helper(DRIVE_ARRAY_INDEX_F_R, 
-                         DRIVE_PWM_PIN_F_R);
-    pthread_motor_helper(DRIVE_ARRAY_INDEX_F_L,
-                         DRIVE_PWM_PIN_F_L);
+/***** set_motor_profile() ***
+  Applies a profile message (see MOTOR PROFILES)  */
+void set_motor_profile(const uint16_t * words) {
+  for (uint8_t index = 0; index < MOTOR_COUNT; index++) {
+    if (!(words[PROFILE_WORD_MOTORS] & (1 << index))) {
+      continue;
+    }
+    MotorProfile& motor = motor_profile[index];
+    if (words[PROFILE_WORD_PROFILE] <= PROFILE_S_CURVE) {
+      motor.profile = words[PROFILE_WORD_PROFILE];
+    }
+    if (words[PROFILE_WORD_ACCELERATION] != 0) {
+      motor.acceleration = per_period(words[PROFILE_WORD_ACCELERATION], 1);
+    }
+    if (words[PROFILE_WORD_JERK] != 0) {
+      motor.jerk = per_period(words[PROFILE_WORD_JERK], 2);
+    }
+    if (words[PROFILE_WORD_EMERGENCY] != 0) {
+      motor.emergency = per_period(words[PROFILE_WORD_EMERGENCY], 1);
+    }
   }
-  PT_END(pt);
+}
+
+/***** stopping_distance() ***
+  @RETURN how far the pulse still moves if rate comes down by jerk every period  */
+uint32_t stopping_distance(uint32_t rate, uint16_t jerk) {
+  uint32_t periods = (rate + jerk - 1) / jerk;
+  return periods * rate - periods * ((periods - 1) * jerk / 2);
 }
 
 /*
-  This method acts as a callback for the rostopic listener.
-  The values in the array SHOULD BE CORRECT PWM PULSE VALUES
+  Moves one motor's pulse toward its target by one period of its profile:
+    - Stopping (target NEUTRAL_SPEED_PWM): straight there, at most the
+      emergency deceleration every period
+    - Trapezoidal: straight there, at most the acceleration every period
+    - S-curve: the rate ramps up by the jerk every period (up to the
+      acceleration), and back down once the target is within the stopping
+      distance, so the pulse eases in and out of every change
 */
-void arduino_cmd_callback(const std_msgs::UInt16MultiArray& cmd_msg) {
-  // Local value used to read data from the array
-  uint16_t valueReadFromArray;
-
-  //----------  A R M   S E R V O S  ----------
-  // Arm base servo
-  valueReadFromArray =  ((uint16_t) cmd_msg.data[MSG_INDEX_ARM_BASE]);
-  if (ARM_PWM_MIN <= valueReadFromArray && valueReadFromArray <= ARM_PWM_MAX) {
-    pwm.setPWM(ARM_PWM_PIN_BASE, 0, valueReadFromArray);
+void pthread_motor_helper(int motor_index, int drive_pwm_pin) {
+  MotorProfile& motor = motor_profile[motor_index];
+  int32_t target = (int32_t) target_motor_pwm[motor_index] << MOTOR_FRACTION_BITS;
+  int32_t error = target - motor.pulse;
+  if (error == 0) {
+    motor.rate = 0;
+    return;  // We are at target speed
   }
-  // Arm shoulder servo
-  valueReadFromArray =  ((uint16_t) cmd_msg.data[MSG_INDEX_ARM_SHOULDER]);
-  if (ARM_PWM_MIN <= valueReadFromArray && valueReadFromArray <= ARM_PWM_MAX) {
-    pwm.setPWM(ARM_PWM_PIN_SHOULDER, 0, valueReadFromArray);
+
+  int32_t step;
+  if (target_motor_pwm[motor_index] == NEUTRAL_SPEED_PWM || motor.profile == PROFILE_TRAPEZOIDAL) {
+    int32_t limit = (target_motor_pwm[motor_index] == NEUTRAL_SPEED_PWM) ? motor.emergency : motor.acceleration;
+    step = constrain(error, -limit, limit);
+  } else {
+    // Rate toward the target (negative while still moving away from it)
+    uint32_t distance = (uint32_t) labs(error);
+    int32_t speed = (error > 0) ? motor.rate : -motor.rate;
+    if (speed > 0 && stopping_distance(speed, motor.jerk) >= distance) {
+      if (speed > motor.jerk) {
+        speed -= motor.jerk;
+      }
+    } else {
+      speed = min(speed + motor.jerk, (int32_t) motor.acceleration);
+    }
+    step = (speed > 0 && (uint32_t) speed >= distance) ? error : ((error > 0) ? speed : -speed);
   }
-  // Arm elbow servo
-  valueReadFromArray =  ((uint16_t) cmd_msg.data[MSG_INDEX_ARM_ELBOW]);
-  if (ARM_PWM_MIN <= valueReadFromArray && valueReadFromArray <= ARM_PWM_MAX) {
-    pwm.setPWM(ARM_PWM_PIN_ELBOW, 0, valueReadFromArray);
+
+  motor.pulse = constrain(motor.pulse + step,
+                          (int32_t) ABSOLUTE_MIN_PWM << MOTOR_FRACTION_BITS,
+                          (int32_t) ABSOLUTE_MAX_PWM << MOTOR_FRACTION_BITS);
+  motor.rate = (motor.pulse == target) ? 0 : step;
+  current_motor_pwm[motor_index] = (uint16_t) ((motor.pulse + (1 << (MOTOR_FRACTION_BITS - 1))) >> MOTOR_FRACTION_BITS);
+  pca9685_batch_set(&pwm_batch, drive_pwm_pin, current_motor_pwm[motor_index]);
+}
+
+/***** start_servo_move() ***
+  Starts moving a servo from its current pulse (see SERVO MOVES), ignoring
+    targets outside the range of the servo
+  @INPUT word - (<message index> << 12) | <target pulse>
+  @INPUT duration - ms  */
+void start_servo_move(uint16_t word, uint16_t duration) {
+  uint8_t index = word >> DELTA_CHANNEL_SHIFT;
+  uint16_t target = word & DELTA_PULSE_MASK;
+  if (index >= MSG_CHANNEL_COUNT || channel_kind(index) != CHANNEL_SERVO ||
+      target < channel_min(index) || channel_max(index) < target) {
+    return;
   }
-  // Arm wrist servo
-  valueReadFromArray =  ((uint16_t) cmd_msg.data[MSG_INDEX_ARM_WRIST]);
-  if (ARM_PWM_MIN <= valueReadFromArray && valueReadFromArray <= ARM_PWM_MAX) {
-    pwm.setPWM(ARM_PWM_PIN_WRIST, 0, valueReadFromArray);
+  ServoMove& move = servo_move[index];
+  uint16_t periods = (duration + MOTOR_TASK_PERIOD / 2) / MOTOR_TASK_PERIOD;
+  if (periods == 0) {
+    move.periods = 0;
+    pca9685_batch_set(&pwm_batch, channel_pin(index), target);
+    return;
   }
+  int32_t start = (int32_t) pwm_batch.pulse[channel_pin(index)] << MOVE_FRACTION_BITS;
+  move.target = target;
+  move.pulse = start;
+  move.step = (((int32_t) target << MOVE_FRACTION_BITS) - start) / periods;
+  move.periods = periods;
+}
 
+/***** set_servo_moves() ***
+  Applies a servo move message (see SERVO MOVES)
+  @INPUT length - words in the message  */
+void set_servo_moves(const uint16_t * words, uint8_t length) {
+  for (uint8_t i = 0; i + 1 < length; i += MOVE_WORDS) {
+    start_servo_move(words[i], words[i + 1]);
+  }
+}
 
-  //----------  S T E E R   S E R V O S  ----------
-  // Update rear steer servo
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_STEER_R]);
-  if (STEER_PWM_MIN <= valueReadFromArray && valueReadFromArray <= STEER_PWM_MAX) {
-    pwm.setPWM(STEER_PWM_PIN_R, 0, valueReadFromArray);
+/***** update_servo_moves() ***
+  Steps every moving servo one period toward its target (the last step
+    lands on it)  */
+void update_servo_moves() {
+  for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+    ServoMove& move = servo_move[index];
+    if (move.periods == 0) {
+      continue;
+    }
+    uint16_t pulse;
+    if (--move.periods == 0) {
+      pulse = move.target;
+    } else {
+      move.pulse += move.step;
+      pulse = (uint16_t) ((move.pulse + (1L << (MOVE_FRACTION_BITS - 1))) >> MOVE_FRACTION_BITS);
+    }
+    pca9685_batch_set(&pwm_batch, channel_pin(index), pulse);
   }
-  // Update front right steer servo
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_STEER_F_R]);
-  if (STEER_PWM_MIN <= valueReadFromArray && valueReadFromArray <= STEER_PWM_MAX) {
-    pwm.setPWM(STEER_PWM_PIN_F_R, 0, valueReadFromArray);
+}
+
+/***** task_update_DC_motors() ***
+  Motor task (every MOTOR_TASK_PERIOD): moves every motor one period of
+    its profile toward its target, and every moving servo one step  */
+void task_update_DC_motors() {
+  unsigned long timestamp = millis();
+
+  for (uint8_t motor = 0; motor < MOTOR_COUNT; motor++) {
+    pthread_motor_helper(motor, channel_pin(MSG_INDEX_DRIVE_R + motor));
   }
-  // Update front left steer servo
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_STEER_F_L]);
-  if (STEER_PWM_MIN <= valueReadFromArray && valueReadFromArray <= STEER_PWM_MAX) {
-    pwm.setPWM(STEER_PWM_PIN_F_L, 0, valueReadFromArray);
+  update_servo_moves();
+  if (timestamp - last_shadow_refresh >= SHADOW_REFRESH_PERIOD) {
+    last_shadow_refresh = timestamp;
+    pca9685_batch_refresh(&pwm_batch);
   }
+  // The motors are pins 11-15: one transaction however many changed (and
+  // one for each run of moving servos)
+  pca9685_batch_flush(&pwm_batch);
+}
 
-  //----------  D R I V E   M O T O R S  ----------
-
-  // Update rear drive motor
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_DRIVE_R]);
-  if (ABSOLUTE_MIN_PWM <= valueReadFromArray && valueReadFromArray <= ABSOLUTE_MAX_PWM) {
-    target_motor_pwm[DRIVE_ARRAY_INDEX_R]   = valueReadFromArray;
+/***** apply_channel() ***
+  Queues one pulse for its servo (or sets the target of its DC motor),
+    ignoring pulses outside the range of the servo/motor.
+  The queued pulses are written by pca9685_batch_flush() once the whole
+    command has been applied, skipping the ones the PCA9685 already has
+    (a keyframe usually changes nothing at all).
+  A moving servo keeps moving if the pulse is its target, and stops there
+    otherwise (see SERVO MOVES).
+  @INPUT index - message index of the channel (see the PIN REFERENCE TABLE)
+  @INPUT valueReadFromArray - the PWM pulse
+*/
+void apply_channel(uint8_t index, uint16_t valueReadFromArray) {
+  if (index >= MSG_CHANNEL_COUNT ||
+      valueReadFromArray < channel_min(index) || channel_max(index) < valueReadFromArray) {
+    return;
   }
-  // Update side right drive motors
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_DRIVE_S_R]);
-  if (ABSOLUTE_MIN_PWM <= valueReadFromArray && valueReadFromArray <= ABSOLUTE_MAX_PWM) {
-    target_motor_pwm[DRIVE_ARRAY_INDEX_S_R] = valueReadFromArray;
+  switch (channel_kind(index)) {
+    case CHANNEL_SERVO:
+      if (servo_move[index].periods > 0) {
+        if (valueReadFromArray == servo_move[index].target) {
+          break;
+        }
+        servo_move[index].periods = 0;
+      }
+      pca9685_batch_set(&pwm_batch, channel_pin(index), valueReadFromArray);
+      break;
+    case CHANNEL_MOTOR:
+      target_motor_pwm[index - MSG_INDEX_DRIVE_R] = valueReadFromArray;
+      break;
+    default:
+      break;  // Mast stepper: TODO
   }
-  // Update side left drive motors
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_DRIVE_S_L]);
-  if (ABSOLUTE_MIN_PWM <= valueReadFromArray && valueReadFromArray <= ABSOLUTE_MAX_PWM) {
-    target_motor_pwm[DRIVE_ARRAY_INDEX_S_L] = valueReadFromArray;
+}
+
+/***** free_ram() ***
+  @RETURN bytes between the top of the heap and the stack  */
+uint16_t free_ram() {
+  extern int __heap_start, * __brkval;
+  int top;
+  return (uint16_t) ((uintptr_t) &top - (__brkval == 0 ? (uintptr_t) &__heap_start : (uintptr_t) __brkval));
+}
+
+/***** count_command() ***
+  Adds one applied command frame to the telemetry
+  @INPUT seq - its sequence number
+  @INPUT received - micros() when it was received  */
+void count_command(uint8_t seq, unsigned long received) {
+  if (seq_synced) {
+    telemetry.lost_frames += (uint8_t) (seq - expected_seq);
   }
-  // Update front right drive motor
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_DRIVE_F_R]);
-  if (ABSOLUTE_MIN_PWM <= valueReadFromArray && valueReadFromArray <= ABSOLUTE_MAX_PWM) {
-    target_motor_pwm[DRIVE_ARRAY_INDEX_F_R] = valueReadFromArray;
+  seq_synced = true;
+  expected_seq = seq + 1;
+
+  telemetry.frames++;
+  rover_timer_add(&telemetry.command, micros() - received);
+  // The deepest the stack gets: inside the command callback
+  uint16_t ram = free_ram();
+  if (ram < telemetry.free_ram) {
+    telemetry.free_ram = ram;
   }
-  // Update front right drive motor
-  valueReadFromArray = ((uint16_t) cmd_msg.data[MSG_INDEX_DRIVE_F_L]);
-  if (ABSOLUTE_MIN_PWM <= valueReadFromArray && valueReadFromArray <= ABSOLUTE_MAX_PWM) {
-    target_motor_pwm[DRIVE_ARRAY_INDEX_F_L] = valueReadFromArray;
+}
+
+#if USE_BINARY_PROTOCOL
+/***** read_binary_frames() ***
+  Feeds every received byte to the decoder, and applies the changed
+    channels (mask bits) of each good frame.
+*/
+void read_binary_frames() {
+  while (Serial.available() > 0) {
+    if (!rover_decoder_push(&decoder, (uint8_t) Serial.read())) {
+      continue;
+    }
+    unsigned long received = micros();
+    const RoverFrame& frame = decoder.frame;
+    if (frame.type == ROVER_FRAME_MOTOR_PROFILE) {
+      set_motor_profile(frame.pulse);
+      continue;
+    }
+    if (frame.type == ROVER_FRAME_SERVO_MOVE) {
+      set_servo_moves(frame.pulse, (uint8_t) min(frame.mask, (uint16_t) ROVER_CHANNEL_COUNT));
+      pca9685_batch_flush(&pwm_batch);  // Moves over 0 ms
+      continue;
+    }
+    if (frame.type != ROVER_FRAME_COMMAND) {
+      continue;
+    }
+
+    for (uint8_t index = 0; index < ROVER_CHANNEL_COUNT; index++) {
+      if (frame.mask & (1 << index)) {
+        apply_channel(index, frame.pulse[index]);
+      }
+    }
+    pca9685_batch_flush(&pwm_batch);
+    count_command(frame.seq, received);
+
+#if TRACE_ECHO
+    echo_frame.seq = frame.seq;
+    echo_frame.type = ROVER_FRAME_ECHO;
+    echo_frame.pulse[ROVER_ECHO_APPLY_US] = (uint16_t) (micros() - received);
+    serial_out_write(send_buffer, rover_encode_frame(send_buffer, &echo_frame));
+#endif
   }
+}
 
+#else
+/*
+  This method acts as a callback for the rostopic listener.
+  The message is a keyframe (MSG_CHANNEL_COUNT pulses, in message index
+    order), a delta frame or a move frame (see DELTA FRAMES above).  Moves
+    come on the same topic so they are applied before the frames after them.
+  The values SHOULD BE CORRECT PWM PULSE VALUES
+*/
+void arduino_cmd_callback(const std_msgs::UInt16MultiArray& cmd_msg) {
+  if (cmd_msg.data_length == 0) {
+    return;
+  }
+  unsigned long received = micros();
+  uint8_t length = 0;  // Words before the sequence number
+
+  if ((cmd_msg.data[0] & DELTA_FRAME_TAG_MASK) == MOVE_FRAME_TAG) {
+    // Move frame: servos to move (see SERVO MOVES), no sequence number
+    uint8_t moves = min(cmd_msg.data[0] & DELTA_PULSE_MASK, (cmd_msg.data_length - 1) / MOVE_WORDS);
+    set_servo_moves(cmd_msg.data + 1, moves * MOVE_WORDS);
+    pca9685_batch_flush(&pwm_batch);  // Moves over 0 ms
+    return;
+  }
 
-  //----------  G R I P P E R   ----------
- 	// Update gripper rotation
-  valueReadFromArray =  ((uint16_t) cmd_msg.data[MSG_INDEX_GRIPPER_ROTATE]);
-  if (GRIPPER_ROTATE_PWM_MIN <= valueReadFromArray && valueReadFromArray <= GRIPPER_ROTATE_PWM_MAX) {
-    pwm.setPWM(GRIPPER_PWM_PIN_ROTATE, 0,valueReadFromArray);
+  if ((cmd_msg.data[0] & DELTA_FRAME_TAG_MASK) == DELTA_FRAME_TAG) {
+    // Delta frame: only the channels that changed
+    uint8_t changes = cmd_msg.data[0] & DELTA_PULSE_MASK;
+    if (changes > cmd_msg.data_length - 1) {
+      changes = cmd_msg.data_length - 1;
+    }
+    for (uint8_t i = 1; i <= changes; i++) {
+      apply_channel(cmd_msg.data[i] >> DELTA_CHANNEL_SHIFT, cmd_msg.data[i] & DELTA_PULSE_MASK);
+    }
+    length = changes + 1;
+  } else if (cmd_msg.data_length >= MSG_CHANNEL_COUNT) {
+    // Keyframe: every channel
+    for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+      apply_channel(index, cmd_msg.data[index]);
+    }
+    length = MSG_CHANNEL_COUNT;
   }
-  // Update gripper claw
-  valueReadFromArray =  ((uint16_t) cmd_msg.data[MSG_INDEX_GRIPPER_CLAW]);
-  if (GRIPPER_CLAW_PWM_CLOSED <= valueReadFromArray && valueReadFromArray <= GRIPPER_CLAW_PWM_OPEN) {
-    pwm.setPWM(GRIPPER_PWM_PIN_CLAW, 0,valueReadFromArray);
+  pca9685_batch_flush(&pwm_batch);
+  if (length > 0 && cmd_msg.data_length > length) {
+    count_command((uint8_t) cmd_msg.data[length], received);
   }
 
-  //----------  MAST STEPPER  ----------
-  // TODO
+#if TRACE_ECHO
+  if (length > 0 && cmd_msg.data_length > length) {
+    echo_data[0] = cmd_msg.data[length];
+    echo_data[1] = (uint16_t) (micros() - received);
+    pub_arduino_echo.publish(&echo_msg);
+  }
+#endif
+}
+
+
+/*
+  Callback for arduino_motor_profile (see MOTOR PROFILES)
+*/
+void arduino_motor_profile_callback(const std_msgs::UInt16MultiArray& profile_msg) {
+  if (profile_msg.data_length >= PROFILE_WORDS) {
+    set_motor_profile(profile_msg.data);
+  }
 }
 
 
 /***** Subscribe to the following rostopics:
-   + arduino_cmd       - Reads an array used to update servos and Motors*/
+   + arduino_cmd           - Reads an array used to update servos and Motors
+                             (and moves servos to a pulse over a time)
+   + arduino_motor_profile - Sets how the motors ramp to their targets */
 ros::Subscriber<std_msgs::UInt16MultiArray> sub_arduino_cmd("arduino_cmd", arduino_cmd_callback);
+ros::Subscriber<std_msgs::UInt16MultiArray> sub_arduino_motor_profile("arduino_motor_profile", arduino_motor_profile_callback);
+#endif
+
+void send_telemetry();
+
+/***** task_serial() ***
+  Serial task (every SERIAL_TASK_PERIOD): applies the commands received
+    since the last tick  */
+void task_serial() {
+  // Pulses that did not fit in the I2C queue last time
+  if (pca9685_batch_pending(&pwm_batch)) {
+    pca9685_batch_flush(&pwm_batch);
+  }
+#if USE_BINARY_PROTOCOL
+  read_binary_frames();
+#else
+  nh.spinOnce();
+#endif
+  if (telemetry_pending && serial_out_free() >= TELEMETRY_SEND_SIZE) {
+    send_telemetry();
+  }
+  serial_out_send(false);
+}
+
+void task_telemetry();
+
+SchedulerTask tasks[TASK_COUNT] = {
+  SCHEDULER_TASK(task_serial, SERIAL_TASK_PERIOD),
+  SCHEDULER_TASK(task_update_DC_motors, MOTOR_TASK_PERIOD),
+  SCHEDULER_TASK(task_telemetry, TELEMETRY_TASK_PERIOD),
+};
+
+/***** reset_telemetry() ***
+  Starts collecting the next report  */
+void reset_telemetry() {
+  telemetry.version = ROVER_TELEMETRY_VERSION;
+  rover_timer_reset(&telemetry.loop);
+  rover_timer_reset(&telemetry.command);
+  rover_timer_reset(&telemetry.i2c);
+  telemetry.frames = 0;
+  telemetry.lost_frames = 0;
+  telemetry.free_ram = free_ram();
+}
+
+/***** task_telemetry() ***
+  Telemetry task (every TELEMETRY_TASK_PERIOD): packs the report (see
+    TELEMETRY above) for task_serial() to send, and starts the next one  */
+void task_telemetry() {
+  unsigned long now = millis();
+  telemetry.period_ms = (uint16_t) (now - last_report);
+  last_report = now;
+
+  TwiQueueTiming i2c;
+  twi_queue_take_timing(&i2c);
+  telemetry.i2c.count = i2c.count;
+  telemetry.i2c.min_us = i2c.min_us;
+  telemetry.i2c.max_us = i2c.max_us;
+  telemetry.i2c.total_us = i2c.total_us;
+  uint8_t sreg = SREG;
+  cli();  // 16 bit counters written by the TWI interrupt
+  uint16_t errors = twi_queue_errors;
+  uint16_t refused = twi_queue_refused;
+  SREG = sreg;
+  telemetry.i2c_errors = errors - reported_i2c_errors;
+  telemetry.i2c_refused = refused - reported_i2c_refused;
+  reported_i2c_errors = errors;
+  reported_i2c_refused = refused;
+#if USE_BINARY_PROTOCOL
+  telemetry.crc_errors = decoder.crc_errors - reported_crc_errors;
+  reported_crc_errors = decoder.crc_errors;
+#else
+  telemetry.crc_errors = 0;
+#endif
+
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    SchedulerTask& task = tasks[i];
+    RoverTaskTelemetry& report = telemetry.task[i];
+    report.runs = task.runs;
+    report.overruns = task.overruns;
+    report.jitter_max_us = task.jitter_max;
+    report.jitter_avg_us = (task.runs > 1) ? (uint16_t) (task.jitter_sum / (task.runs - 1)) : 0;
+    report.run_max_us = task.run_max;
+    // The next interval is measured from this run
+    unsigned long last_start = task.last_start;
+    uint16_t runs = task.runs;
+    scheduler_reset_stats(&task);
+    if (runs > 0) {
+      task.runs = 1;
+      task.last_start = last_start;
+    }
+  }
+
+  rover_telemetry_pack(telemetry_buffer, &telemetry);
+#if USE_BINARY_PROTOCOL
+  telemetry_frame.seq = telemetry.seq;
+#endif
+  telemetry_pending = true;  // Sent by task_serial() once it fits (see SERIAL OUTPUT)
+  telemetry.seq++;
+  reset_telemetry();
+}
+
+/***** send_telemetry() ***
+  Queues the packed report (TELEMETRY_SEND_SIZE bytes) on serial_out  */
+void send_telemetry() {
+#if USE_BINARY_PROTOCOL
+  for (uint8_t page = 0; page < ROVER_TELEMETRY_PAGES; page++) {
+    const uint8_t * bytes = telemetry_buffer + page * ROVER_PAYLOAD_SIZE;
+    telemetry_frame.mask = page;
+    for (uint8_t i = 0; i < ROVER_CHANNEL_COUNT; i++) {
+      telemetry_frame.pulse[i] = (uint16_t) bytes[2 * i] | ((uint16_t) bytes[2 * i + 1] << 8);
+    }
+    serial_out_write(send_buffer, rover_encode_frame(send_buffer, &telemetry_frame));
+  }
+#else
+  pub_arduino_telemetry.publish(&telemetry_msg);
+#endif
+  telemetry_pending = false;
+}
 
 void setup(){
+#if USE_BINARY_PROTOCOL
+  Serial.begin(ROVER_PROTOCOL_BAUD);
+  rover_decoder_init(&decoder);
+  telemetry_frame.type = ROVER_FRAME_TELEMETRY;
+#else
   nh.initNode();    // Initialize ROS node handle
   nh.subscribe(sub_arduino_cmd); // Subscribe to command topic
+  nh.subscribe(sub_arduino_motor_profile);
+#if TRACE_ECHO
+  echo_msg.data_length = 2;
+  echo_msg.data = echo_data;
+  nh.advertise(pub_arduino_echo);
+#endif
+  telemetry_msg.data_length = ROVER_TELEMETRY_SIZE;
+  telemetry_msg.data = telemetry_buffer;
+  nh.advertise(pub_arduino_telemetry);
+#endif
 
   // Initialize I2C PWM board
-  pwm.begin();
-  pwm.setPWMFreq(PWM_FREQUENCY);
-
-  // Initialize arm servos (set to home position)
-  pwm.setPWM(ARM_PWM_PIN_BASE, 0, ARM_PWM_NEUTRAL);
-  pwm.setPWM(ARM_PWM_PIN_SHOULDER, 0, ARM_PWM_NEUTRAL);
-  pwm.setPWM(ARM_PWM_PIN_ELBOW, 0, ARM_PWM_NEUTRAL);
-  pwm.setPWM(ARM_PWM_PIN_WRIST, 0, ARM_PWM_NEUTRAL);
-
-  // Initialize steer servos (set to neutral)
-  pwm.setPWM(STEER_PWM_PIN_R, 0, STEER_PWM_NEUTRAL);
-  pwm.setPWM(STEER_PWM_PIN_F_R, 0, STEER_PWM_NEUTRAL);
-  pwm.setPWM(STEER_PWM_PIN_F_L, 0, STEER_PWM_NEUTRAL);
-
-  // Initialize gripper servos: 
-  //	- 0 degres rotation
-  //	- open claw
-  pwm.setPWM(GRIPPER_PWM_PIN_CLAW, 0, GRIPPER_CLAW_PWM_OPEN);
-  pwm.setPWM(GRIPPER_PWM_PIN_ROTATE, 0, GRIPPER_ROTATE_PWM_NEUTRAL);
-
-  // Initialize array for "target" motor pwm (to "NEUTRAL_SPEED_PWM")
-  target_motor_pwm[DRIVE_ARRAY_INDEX_R]   = NEUTRAL_SPEED_PWM;
-  target_motor_pwm[DRIVE_ARRAY_INDEX_S_R] = NEUTRAL_SPEED_PWM;
-  target_motor_pwm[DRIVE_ARRAY_INDEX_S_L] = NEUTRAL_SPEED_PWM;
-  target_motor_pwm[DRIVE_ARRAY_INDEX_F_R] = NEUTRAL_SPEED_PWM;
-  target_motor_pwm[DRIVE_ARRAY_INDEX_F_L] = NEUTRAL_SPEED_PWM;
-
-  // Initialize array for "current" motor pwm (to "NEUTRAL_SPEED_PWM")
-  current_motor_pwm[DRIVE_ARRAY_INDEX_R]   = NEUTRAL_SPEED_PWM;
-  current_motor_pwm[DRIVE_ARRAY_INDEX_S_R] = NEUTRAL_SPEED_PWM;
-  current_motor_pwm[DRIVE_ARRAY_INDEX_S_L] = NEUTRAL_SPEED_PWM;
-  current_motor_pwm[DRIVE_ARRAY_INDEX_F_R] = NEUTRAL_SPEED_PWM;
-  current_motor_pwm[DRIVE_ARRAY_INDEX_F_L] = NEUTRAL_SPEED_PWM;
-
-  // Initialize protothread(s)
-  PT_INIT(&motor_protothread);
+  twi_queue_begin(TWI_FREQUENCY);
+  pca9685_batch_init(&pwm_batch, PCA9685_DEFAULT_ADDRESS);
+  pca9685_batch_begin(&pwm_batch, PWM_FREQUENCY);
+
+  // Initialize servos (set to home position: arm and steering neutral,
+  // gripper at 0 degrees rotation with the claw open) and the "target" and
+  // "current" motor pwm (to "NEUTRAL_SPEED_PWM")
+  for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+    if (channel_kind(index) == CHANNEL_SERVO) {
+      pca9685_batch_set(&pwm_batch, channel_pin(index), channel_neutral(index));
+    } else if (channel_kind(index) == CHANNEL_MOTOR) {
+      target_motor_pwm[index - MSG_INDEX_DRIVE_R]  = channel_neutral(index);
+      current_motor_pwm[index - MSG_INDEX_DRIVE_R] = channel_neutral(index);
+    }
+  }
+
+  // Start every motor at neutral on the default profile
+  uint16_t profile[PROFILE_WORDS] = { 0x1F, PROFILE_TRAPEZOIDAL, DEFAULT_ACCELERATION, DEFAULT_JERK, DEFAULT_EMERGENCY };
+  set_motor_profile(profile);
+  for (uint8_t index = 0; index < MOTOR_COUNT; index++) {
+    motor_profile[index].pulse = (int32_t) NEUTRAL_SPEED_PWM << MOTOR_FRACTION_BITS;
+    motor_profile[index].rate = 0;
+  }
+
+  // Write the servo home positions (pins 0-6 and 8-9, 2 transactions)
+  pca9685_batch_flush(&pwm_batch);
+
+  // Start the 1 kHz tick
+  reset_telemetry();
+  last_report = millis();
+  last_loop = micros();
+  scheduler_begin(tasks, TASK_COUNT);
 }
 
 void loop(){
-  pthread_update_DC_motors(&motor_protothread);
-  nh.spinOnce();
-  delay(10);
+  unsigned long now = micros();
+  rover_timer_add(&telemetry.loop, now - last_loop);
+  last_loop = now;
+
+  // Every task is run from here when its period is up, nothing waits
+  scheduler_run(tasks, TASK_COUNT);
 }
                                                                                       
@@ -0,0 +1,167 @@
+#ifndef PCA9685_BATCH_H
+#define PCA9685_BATCH_H
+
+#include <stdint.h>
+#include <Arduino.h>
+#include <TwiQueue.h>             // Source/Arduino/libraries/TwiQueue
+
+/*-----------------------------------------------------------------------------------
+//----------------   P C A 9 6 8 5   B A T C H E D   W R I T E S   -----------------
+//-----------------------------------------------------------------------------------
+  Adafruit_PWMServoDriver::setPWM() is one I2C transaction per channel
+  (address, register, 4 data bytes).  The PCA9685 moves its register pointer
+  on after every byte when MODE1 AI is set, so a run of consecutive channels
+  can go out in one transaction: address, LEDn_ON_L, then 4 bytes per channel.
+
+  A sketch collects the pulses of a command with pca9685_batch_set() and
+  writes them with pca9685_batch_flush(): one transaction per run of
+  consecutive channels (at most PCA9685_BATCH_RUN).  With the rover's pin
+  map a keyframe is 3 transactions (pins 0-6, 8-9 and 11-15) instead of 14.
+
+  The transactions go to the interrupt driven TwiQueue, so a flush never
+  waits for the bus.  A run that does not fit in the queue stays queued here
+  and goes out with a later flush (pca9685_batch_pending()).
+
+  The batch also keeps a shadow of what was last written to every channel,
+  and pca9685_batch_set() drops a pulse the chip already has.  A command that
+  moves one joint is one 5 data byte transaction, not a rewrite of every
+  channel.  pca9685_batch_refresh() rewrites every known channel, in case the
+  chip lost its registers (brownout) behind the shadow's back.
+
+  Pulses are written like setPWM(pin, 0, pulse): ON at count 0, OFF at pulse.
+*/
+
+//----------   R E G I S T E R S   ----------
+#define PCA9685_DEFAULT_ADDRESS  0x40
+#define PCA9685_MODE1            0x00
+#define PCA9685_MODE1_RESTART    0x80
+#define PCA9685_MODE1_AI         0x20    // Register auto-increment
+#define PCA9685_MODE1_SLEEP      0x10    // Oscillator off (needed to change the prescaler)
+#define PCA9685_MODE1_ALLCALL    0x01
+#define PCA9685_PRESCALE         0xFE
+#define PCA9685_LED0_ON_L        0x06    // Channel n starts at LED0_ON_L + 4 * n
+#define PCA9685_CHANNEL_COUNT    16
+#define PCA9685_UNKNOWN_PULSE    0xFFFF  // Shadow of a channel never written (pulses are < 4096)
+
+// Channels per transaction: one register byte, then 4 bytes per channel
+#define PCA9685_BATCH_RUN        ((TWI_QUEUE_MAX_LENGTH - 1) / 4)
+
+
+//----------   B A T C H   ----------
+struct PCA9685Batch {
+  uint8_t  address;
+  uint16_t dirty;                          // Bit per channel waiting to be written
+  uint16_t pulse[PCA9685_CHANNEL_COUNT];   // OFF count of every channel
+  uint16_t shadow[PCA9685_CHANNEL_COUNT];  // OFF count last written to every channel
+};
+
+static inline void pca9685_batch_init(PCA9685Batch * batch, uint8_t address) {
+  batch->address = address;
+  batch->dirty = 0;
+  for (uint8_t channel = 0; channel < PCA9685_CHANNEL_COUNT; channel++) {
+    batch->shadow[channel] = PCA9685_UNKNOWN_PULSE;
+  }
+}
+
+/***** pca9685_batch_write8() ***
+  Queues a one register write, waiting for room (setup only)  */
+static inline void pca9685_batch_write8(PCA9685Batch * batch, uint8_t reg, uint8_t value) {
+  uint8_t data[2] = { reg, value };
+  while (!twi_queue_write(batch->address, data, 2)) {
+  }
+}
+
+/***** pca9685_batch_begin() ***
+  Sets the PWM frequency and turns on register auto-increment, in place of
+    Adafruit_PWMServoDriver::begin() and setPWMFreq().  Call after
+    twi_queue_begin(), from setup() (waits for the chip).
+  The prescaler is worked out like setPWMFreq() does it (including its 0.9
+    overshoot correction), so the pulse calibrations stay the same  */
+static inline void pca9685_batch_begin(PCA9685Batch * batch, float frequency) {
+  float prescale = 25000000.0 / 4096.0 / (frequency * 0.9) - 1.0;
+  uint8_t mode = PCA9685_MODE1_AI | PCA9685_MODE1_ALLCALL;
+
+  pca9685_batch_write8(batch, PCA9685_MODE1, mode | PCA9685_MODE1_SLEEP);
+  pca9685_batch_write8(batch, PCA9685_PRESCALE, (uint8_t) (prescale + 0.5));
+  pca9685_batch_write8(batch, PCA9685_MODE1, mode);
+  twi_queue_flush();
+  delay(5);  // Oscillator start up
+  pca9685_batch_write8(batch, PCA9685_MODE1, mode | PCA9685_MODE1_RESTART);
+  twi_queue_flush();
+}
+
+/***** pca9685_batch_set() ***
+  Queues one pulse until the next pca9685_batch_flush(), unless the
+    channel already has it  */
+static inline void pca9685_batch_set(PCA9685Batch * batch, uint8_t channel, uint16_t pulse) {
+  batch->pulse[channel] = pulse;
+  if (pulse == batch->shadow[channel]) {
+    batch->dirty &= (uint16_t) ~(1u << channel);  // Set back before it was written
+  } else {
+    batch->dirty |= (uint16_t) (1u << channel);
+  }
+}
+
+/***** pwm_channel_write() ***
+  Lets the PwmChannel kinds (Source/Arduino/libraries/PwmChannel) write
+    through a batch: ArmBase::write(pwm_batch, angle) is a pca9685_batch_set()  */
+static inline void pwm_channel_write(PCA9685Batch& batch, uint8_t channel, uint16_t pulse) {
+  pca9685_batch_set(&batch, channel, pulse);
+}
+
+/***** pca9685_batch_refresh() ***
+  Queues every channel that has been written for a rewrite (channels with a
+    new pulse already queued keep it)  */
+static inline void pca9685_batch_refresh(PCA9685Batch * batch) {
+  for (uint8_t channel = 0; channel < PCA9685_CHANNEL_COUNT; channel++) {
+    if (batch->shadow[channel] != PCA9685_UNKNOWN_PULSE && !(batch->dirty & (1u << channel))) {
+      batch->pulse[channel] = batch->shadow[channel];
+      batch->dirty |= (uint16_t) (1u << channel);
+    }
+  }
+}
+
+/***** pca9685_batch_flush() ***
+  Queues every pending pulse on the TwiQueue, one transaction per run of
+    consecutive channels.  Stops at the first run that does not fit.
+  @RETURN the number of I2C transactions queued  */
+static inline uint8_t pca9685_batch_flush(PCA9685Batch * batch) {
+  uint8_t data[1 + 4 * PCA9685_BATCH_RUN];
+  uint8_t transactions = 0;
+  uint8_t channel = 0;
+  while (batch->dirty != 0) {
+    while (!(batch->dirty & (1u << channel))) {
+      channel++;
+    }
+
+    uint8_t first = channel;
+    uint8_t length = 0;
+    data[length++] = (uint8_t) (PCA9685_LED0_ON_L + 4 * channel);
+    while (channel < PCA9685_CHANNEL_COUNT && (batch->dirty & (1u << channel)) && channel - first < PCA9685_BATCH_RUN) {
+      uint16_t pulse = batch->pulse[channel];
+      data[length++] = 0;                       // ON_L
+      data[length++] = 0;                       // ON_H
+      data[length++] = (uint8_t) (pulse & 0xFF); // OFF_L
+      data[length++] = (uint8_t) (pulse >> 8);  // OFF_H
+      channel++;
+    }
+    if (!twi_queue_write(batch->address, data, length)) {
+      break;  // Queue full, the run stays pending
+    }
+
+    for (uint8_t i = first; i < channel; i++) {
+      batch->shadow[i] = batch->pulse[i];
+      batch->dirty &= (uint16_t) ~(1u << i);
+    }
+    transactions++;
+  }
+  return transactions;
+}
+
+/***** pca9685_batch_pending() ***
+  @RETURN true if some pulses did not fit in the queue at the last flush  */
+static inline bool pca9685_batch_pending(const PCA9685Batch * batch) {
+  return batch->dirty != 0;
+}
+
+#endif
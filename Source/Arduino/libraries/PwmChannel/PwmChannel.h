@@ -0,0 +1,146 @@
+#ifndef PWM_CHANNEL_H
+#define PWM_CHANNEL_H
+
+#include <stdint.h>
+
+/*-----------------------------------------------------------------------------------
+//----------------------   P W M   C H A N N E L   K I N D S   ----------------------
+//-----------------------------------------------------------------------------------
+  Servos and DC motors on a PCA9685, with the calibration in the type.
+
+  A channel kind is a type whose template parameters are its pulse range
+  (out of 4096 at 50 Hz) and how a command becomes a pulse:
+    - PulseKind:      the command is a pulse, clamped into the range
+    - AngleServoKind: the command is degrees from neutral, FULL_TURN pulses
+                      per 360 degrees (arm_angle_to_pulse() before this)
+    - MotorKind:      the command is a speed in percent, FULL_SPEED pulses
+                      from neutral at +-100
+  and a channel is a kind on a pin, PwmChannel<PIN, KIND>.
+
+  Everything is static and inline: no objects, no virtual write(), no heap.
+  ArmBase::write(pwm, angle) compiles to the integer conversion and the
+  same setPWM(0, 0, pulse) call a sketch would write by hand.  The range is
+  checked by static_assert, and the conversion is worked out in integers
+  (rounding down, like the double arithmetic it replaces) with the divisor
+  a constant.
+
+  A channel writes through any driver with an overload of
+    pwm_channel_write(driver, pin, pulse)
+  found by argument dependent lookup where the channel is used.  The one
+  here covers drivers with setPWM(pin, on, off) (Adafruit_PWMServoDriver),
+  PCA9685Batch.h has its own, so the header needs neither.
+
+  typedef AngleServoKind<126, 504, 315, 216> ArmServo;  // Hitec HS-785HB
+  typedef PwmChannel<0, ArmServo> ArmBase;
+  ArmBase::home(pwm);                     // setPWM(0, 0, 315)
+  ArmBase::write(pwm, 90);                // setPWM(0, 0, 369)
+  pwm_kind_write<ArmServo>(pwm, pin, 90); // The pin known at run time only
+*/
+
+#define PWM_CHANNEL_RESOLUTION  4096   // PCA9685 counts per period
+
+/***** pwm_channel_write() ***
+  Writes one pulse through a setPWM(pin, on, off) driver, ON at count 0  */
+template<class Driver>
+static inline void pwm_channel_write(Driver& driver, uint8_t pin, uint16_t pulse) {
+  driver.setPWM(pin, 0, pulse);
+}
+
+
+//----------   K I N D S   ----------
+template<uint16_t MIN_PULSE, uint16_t MAX_PULSE, uint16_t NEUTRAL_PULSE>
+struct PulseKind {
+  static_assert(MIN_PULSE <= NEUTRAL_PULSE && NEUTRAL_PULSE <= MAX_PULSE, "neutral pulse out of range");
+  static_assert(MAX_PULSE < PWM_CHANNEL_RESOLUTION, "pulse longer than the period");
+
+  static const uint16_t PULSE_MIN = MIN_PULSE;
+  static const uint16_t PULSE_MAX = MAX_PULSE;
+  static const uint16_t PULSE_NEUTRAL = NEUTRAL_PULSE;
+
+  /***** contains() ***
+    @RETURN true if the pulse is in the range  */
+  static inline bool contains(uint16_t pulse) {
+    return PULSE_MIN <= pulse && pulse <= PULSE_MAX;
+  }
+
+  /***** clamp() ***
+    @RETURN the pulse, or the end of the range it is past  */
+  static inline uint16_t clamp(int32_t pulse) {
+    if (pulse < PULSE_MIN) {
+      return PULSE_MIN;
+    } else if (pulse > PULSE_MAX) {
+      return PULSE_MAX;
+    }
+    return (uint16_t) pulse;
+  }
+
+  static inline uint16_t to_pulse(int16_t value) {
+    return clamp(value);
+  }
+};
+
+/* Commands scaled around neutral: NEUTRAL + value * PER / UNIT pulses,
+    rounded down, then clamped  */
+template<uint16_t MIN_PULSE, uint16_t MAX_PULSE, uint16_t NEUTRAL_PULSE, uint16_t PER, uint16_t UNIT>
+struct ScaledKind : PulseKind<MIN_PULSE, MAX_PULSE, NEUTRAL_PULSE> {
+  static_assert(UNIT > 0, "no unit to scale by");
+
+  static inline uint16_t to_pulse(int16_t value) {
+    // Compared before dividing, so the division only sees positive numbers
+    // (rounding down, where C would round toward zero)
+    int32_t scaled = (int32_t) NEUTRAL_PULSE * UNIT + (int32_t) value * PER;
+    if (scaled < (int32_t) MIN_PULSE * UNIT) {
+      return MIN_PULSE;
+    } else if (scaled > (int32_t) MAX_PULSE * UNIT) {
+      return MAX_PULSE;
+    }
+    return (uint16_t) (scaled / UNIT);
+  }
+};
+
+template<uint16_t MIN_PULSE, uint16_t MAX_PULSE, uint16_t NEUTRAL_PULSE, uint16_t FULL_TURN>
+using AngleServoKind = ScaledKind<MIN_PULSE, MAX_PULSE, NEUTRAL_PULSE, FULL_TURN, 360>;
+
+template<uint16_t MIN_PULSE, uint16_t MAX_PULSE, uint16_t NEUTRAL_PULSE, uint16_t FULL_SPEED>
+using MotorKind = ScaledKind<MIN_PULSE, MAX_PULSE, NEUTRAL_PULSE, FULL_SPEED, 100>;
+
+
+//----------   W R I T E S   ----------
+/***** pwm_kind_write() ***
+  Converts a command with KIND's calibration and writes it, for a pin only
+    known at run time (one call site for every channel of the kind)  */
+template<class Kind, class Driver>
+static inline void pwm_kind_write(Driver& driver, uint8_t pin, int16_t value) {
+  pwm_channel_write(driver, pin, Kind::to_pulse(value));
+}
+
+template<uint8_t PIN, class KIND>
+struct PwmChannel {
+  static_assert(PIN < 16, "the PCA9685 has 16 channels");
+
+  typedef KIND Kind;
+  static const uint8_t PIN_NUMBER = PIN;
+
+  /***** write() ***
+    Converts a command with the channel's kind and writes it  */
+  template<class Driver>
+  static inline void write(Driver& driver, int16_t value) {
+    pwm_channel_write(driver, PIN, Kind::to_pulse(value));
+  }
+
+  /***** write_pulse() ***
+    Writes a pulse, clamped into the channel's range  */
+  template<class Driver>
+  static inline void write_pulse(Driver& driver, uint16_t pulse) {
+    pwm_channel_write(driver, PIN, Kind::clamp(pulse));
+  }
+
+  /***** home() ***
+    Writes the neutral pulse (servo centred, motor stopped)  */
+  template<class Driver>
+  static inline void home(Driver& driver) {
+    pwm_channel_write(driver, PIN, Kind::PULSE_NEUTRAL);
+  }
+};
+
+#endif
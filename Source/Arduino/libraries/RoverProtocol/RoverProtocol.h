@@ -0,0 +1,339 @@
+#ifndef ROVER_PROTOCOL_H
+#define ROVER_PROTOCOL_H
+
+#include <stdint.h>
+
+/*-----------------------------------------------------------------------------------
+//-----------------   R O V E R   S E R I A L   P R O T O C O L   -------------------
+//-----------------------------------------------------------------------------------
+  Binary command frames sent by arduino_command_translator (~transport:=binary)
+  straight to the arduino's serial port, instead of rosserial.
+  Shared by the translator (Linux) and the sketches (AVR), so everything here is
+  plain C/C++ with no allocation.
+
+  # Frame layout (ROVER_FRAME_SIZE bytes, multi-byte fields little endian)
+  +--------+--------+-----+------+------+-------------------------+-------+
+  | SYNC 0 | SYNC 1 | SEQ | TYPE | MASK | PULSES                  | CRC   |
+  |  0xA5  |  0x5A  |  1  |  1   |  2   | 15 x 2                  |   2   |
+  +--------+--------+-----+------+------+-------------------------+-------+
+    SEQ    - frame counter (wraps at 256), lets the arduino count lost frames
+    TYPE   - ROVER_FRAME_COMMAND, ROVER_FRAME_MOTOR_PROFILE or
+             ROVER_FRAME_SERVO_MOVE (translator -> arduino),
+             ROVER_FRAME_ECHO or
+             ROVER_FRAME_TELEMETRY (arduino -> translator)
+    MASK   - bit i set = pulse i changed (all set = keyframe)
+    PULSES - every pulse, in arduino_cmd order
+  An echo frame is sent back once a command has been applied, for the latency
+  tracing in arduino_command_translator: SEQ is the command's SEQ, MASK is 0,
+  PULSES[ROVER_ECHO_APPLY_US] is the time the arduino took to apply it (us) and
+  the other pulses are 0.
+  A telemetry report (see TELEMETRY below) is ROVER_TELEMETRY_PAGES telemetry
+  frames: SEQ is the report's sequence number, MASK the page and PULSES hold
+  the page's ROVER_PAYLOAD_SIZE bytes of the packed report (little endian).
+  A motor profile frame's PULSES start with the words of an
+  arduino_motor_profile message (see MOTOR PROFILES in the sketch); MASK and
+  SEQ are 0, and it does not count in the command sequence.
+  A servo move frame's PULSES start with the moves of an arduino_cmd move
+  frame, without its tag word (see SERVO MOVES in the sketch, at most
+  ROVER_MOVES_PER_FRAME moves); MASK is the number of words, SEQ is 0 and it does not count in
+  the command sequence either.
+    CRC    - CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of SEQ through PULSES
+
+  Decoding is a byte at a time state machine (rover_decoder_push()), so the
+  arduino can feed it straight from Serial.read().  A bad CRC drops the frame
+  and the decoder goes back to looking for the sync bytes.
+*/
+
+//----------   C O N S T A N T S   ----------
+#define ROVER_PROTOCOL_BAUD   115200
+
+#define ROVER_SYNC_0          0xA5
+#define ROVER_SYNC_1          0x5A
+
+#define ROVER_FRAME_COMMAND   0x01
+#define ROVER_FRAME_ECHO      0x02
+#define ROVER_FRAME_TELEMETRY 0x03
+#define ROVER_FRAME_MOTOR_PROFILE 0x04
+#define ROVER_FRAME_SERVO_MOVE    0x05
+
+#define ROVER_ECHO_APPLY_US   0       // Pulse holding the apply time of an echo frame
+
+#define ROVER_CHANNEL_COUNT   15
+#define ROVER_KEYFRAME_MASK   0x7FFF  // Every channel
+#define ROVER_MOVES_PER_FRAME (ROVER_CHANNEL_COUNT / 2)  // Servo moves (2 words each) in one frame
+
+#define ROVER_HEADER_SIZE     6       // Sync, seq, type, mask
+#define ROVER_PAYLOAD_SIZE    (ROVER_CHANNEL_COUNT * 2)
+#define ROVER_FRAME_SIZE      (ROVER_HEADER_SIZE + ROVER_PAYLOAD_SIZE + 2)
+
+
+//----------   F R A M E S   ----------
+struct RoverFrame {
+  uint8_t  seq;
+  uint8_t  type;
+  uint16_t mask;
+  uint16_t pulse[ROVER_CHANNEL_COUNT];
+};
+
+/***** rover_crc16_update() ***
+  Adds one byte to a CRC-16/CCITT-FALSE (check value 0x29B1 for "123456789").
+  Byte at a time shift/xor form: same result as the bit by bit loop,
+    without the 8 iterations or a 512 byte table  */
+static inline uint16_t rover_crc16_update(uint16_t crc, uint8_t byte) {
+  crc = (uint16_t) ((crc >> 8) | (crc << 8));
+  crc ^= byte;
+  crc ^= (crc & 0xFF) >> 4;
+  crc ^= (uint16_t) (crc << 12);
+  crc ^= (uint16_t) ((crc & 0xFF) << 5);
+  return crc;
+}
+
+/***** rover_encode_frame() ***
+  Writes one frame into buffer (at least ROVER_FRAME_SIZE bytes)
+  @RETURN the number of bytes written (ROVER_FRAME_SIZE)  */
+static inline uint8_t rover_encode_frame(uint8_t * buffer, const RoverFrame * frame) {
+  uint8_t length = 0;
+  buffer[length++] = ROVER_SYNC_0;
+  buffer[length++] = ROVER_SYNC_1;
+  buffer[length++] = frame->seq;
+  buffer[length++] = frame->type;
+  buffer[length++] = (uint8_t) (frame->mask & 0xFF);
+  buffer[length++] = (uint8_t) (frame->mask >> 8);
+  for (uint8_t i = 0; i < ROVER_CHANNEL_COUNT; i++) {
+    buffer[length++] = (uint8_t) (frame->pulse[i] & 0xFF);
+    buffer[length++] = (uint8_t) (frame->pulse[i] >> 8);
+  }
+
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 2; i < length; i++) {
+    crc = rover_crc16_update(crc, buffer[i]);
+  }
+  buffer[length++] = (uint8_t) (crc & 0xFF);
+  buffer[length++] = (uint8_t) (crc >> 8);
+  return length;
+}
+
+
+//----------   T E L E M E T R Y   ----------
+/* The firmware's runtime statistics, one report every few seconds (binary
+  telemetry frames, or the bytes of an arduino_telemetry UInt8MultiArray).
+  A report covers the time since the previous one.  Timers are in us and
+  packed as <count>, <min>, <max>, <average> (16 bits each, saturated).
+
+  # Packed report (ROVER_TELEMETRY_SIZE bytes, little endian)
+    version (1), seq (1), period_ms (2), loop, command, i2c (8 each),
+    frames, lost_frames, crc_errors, i2c_errors, i2c_refused, free_ram (2 each),
+    then for each of ROVER_TELEMETRY_TASKS tasks:
+    runs, overruns, jitter_max_us, jitter_avg_us, run_max_us (2 each)
+*/
+#define ROVER_TELEMETRY_VERSION  1
+#define ROVER_TELEMETRY_TASKS    3
+#define ROVER_TELEMETRY_SIZE     (4 + 3 * 8 + 6 * 2 + ROVER_TELEMETRY_TASKS * 10)
+#define ROVER_TELEMETRY_PAGES    ((ROVER_TELEMETRY_SIZE + ROVER_PAYLOAD_SIZE - 1) / ROVER_PAYLOAD_SIZE)
+
+struct RoverTimer {
+  uint16_t count;
+  uint16_t min_us;
+  uint16_t max_us;
+  uint32_t total_us;       // Of the counted samples (average * count once unpacked)
+};
+
+struct RoverTaskTelemetry {
+  uint16_t runs;
+  uint16_t overruns;
+  uint16_t jitter_max_us;
+  uint16_t jitter_avg_us;
+  uint16_t run_max_us;
+};
+
+struct RoverTelemetry {
+  uint8_t    version;
+  uint8_t    seq;
+  uint16_t   period_ms;    // Time the report covers
+  RoverTimer loop;         // Between two loop() calls
+  RoverTimer command;      // Applying one command frame (received to queued for I2C)
+  RoverTimer i2c;          // One I2C transaction, START to STOP
+  uint16_t   frames;       // Command frames received
+  uint16_t   lost_frames;  // Missing from the sequence numbers
+  uint16_t   crc_errors;   // Binary frames dropped by the decoder
+  uint16_t   i2c_errors;   // NACKs and bus errors
+  uint16_t   i2c_refused;  // Transactions that did not fit in the I2C queue (sent later)
+  uint16_t   free_ram;     // Least seen between the heap and the stack (bytes)
+  RoverTaskTelemetry task[ROVER_TELEMETRY_TASKS];
+};
+
+static inline void rover_timer_reset(RoverTimer * timer) {
+  timer->count = 0;
+  timer->min_us = 0xFFFF;
+  timer->max_us = 0;
+  timer->total_us = 0;
+}
+
+/***** rover_timer_add() ***
+  Adds one sample (the count stops at 0xFFFF, the min and max do not)  */
+static inline void rover_timer_add(RoverTimer * timer, uint32_t us) {
+  uint16_t sample = (us > 0xFFFF) ? 0xFFFF : (uint16_t) us;
+  if (sample < timer->min_us) {
+    timer->min_us = sample;
+  }
+  if (sample > timer->max_us) {
+    timer->max_us = sample;
+  }
+  if (timer->count < 0xFFFF) {
+    timer->count++;
+    timer->total_us += sample;
+  }
+}
+
+static inline uint8_t rover_pack16(uint8_t * buffer, uint8_t length, uint16_t value) {
+  buffer[length++] = (uint8_t) (value & 0xFF);
+  buffer[length++] = (uint8_t) (value >> 8);
+  return length;
+}
+
+static inline uint16_t rover_unpack16(const uint8_t * buffer, uint8_t * length) {
+  uint16_t value = (uint16_t) buffer[*length] | ((uint16_t) buffer[*length + 1] << 8);
+  *length += 2;
+  return value;
+}
+
+static inline uint8_t rover_pack_timer(uint8_t * buffer, uint8_t length, const RoverTimer * timer) {
+  length = rover_pack16(buffer, length, timer->count);
+  length = rover_pack16(buffer, length, (timer->count > 0) ? timer->min_us : 0);
+  length = rover_pack16(buffer, length, timer->max_us);
+  return rover_pack16(buffer, length, (timer->count > 0) ? (uint16_t) (timer->total_us / timer->count) : 0);
+}
+
+static inline void rover_unpack_timer(const uint8_t * buffer, uint8_t * length, RoverTimer * timer) {
+  timer->count = rover_unpack16(buffer, length);
+  timer->min_us = rover_unpack16(buffer, length);
+  timer->max_us = rover_unpack16(buffer, length);
+  timer->total_us = (uint32_t) rover_unpack16(buffer, length) * timer->count;
+}
+
+/***** rover_telemetry_pack() ***
+  Packs a report into buffer (at least ROVER_TELEMETRY_PAGES * ROVER_PAYLOAD_SIZE
+    bytes, the padding is zeroed)
+  @RETURN ROVER_TELEMETRY_SIZE  */
+static inline uint8_t rover_telemetry_pack(uint8_t * buffer, const RoverTelemetry * telemetry) {
+  uint8_t length = 0;
+  buffer[length++] = telemetry->version;
+  buffer[length++] = telemetry->seq;
+  length = rover_pack16(buffer, length, telemetry->period_ms);
+  length = rover_pack_timer(buffer, length, &telemetry->loop);
+  length = rover_pack_timer(buffer, length, &telemetry->command);
+  length = rover_pack_timer(buffer, length, &telemetry->i2c);
+  length = rover_pack16(buffer, length, telemetry->frames);
+  length = rover_pack16(buffer, length, telemetry->lost_frames);
+  length = rover_pack16(buffer, length, telemetry->crc_errors);
+  length = rover_pack16(buffer, length, telemetry->i2c_errors);
+  length = rover_pack16(buffer, length, telemetry->i2c_refused);
+  length = rover_pack16(buffer, length, telemetry->free_ram);
+  for (uint8_t i = 0; i < ROVER_TELEMETRY_TASKS; i++) {
+    const RoverTaskTelemetry * task = &telemetry->task[i];
+    length = rover_pack16(buffer, length, task->runs);
+    length = rover_pack16(buffer, length, task->overruns);
+    length = rover_pack16(buffer, length, task->jitter_max_us);
+    length = rover_pack16(buffer, length, task->jitter_avg_us);
+    length = rover_pack16(buffer, length, task->run_max_us);
+  }
+  for (uint8_t i = length; i < ROVER_TELEMETRY_PAGES * ROVER_PAYLOAD_SIZE; i++) {
+    buffer[i] = 0;
+  }
+  return length;
+}
+
+/***** rover_telemetry_unpack() ***
+  @RETURN false if the report is too short or from another version  */
+static inline bool rover_telemetry_unpack(RoverTelemetry * telemetry, const uint8_t * buffer, uint16_t size) {
+  if (size < ROVER_TELEMETRY_SIZE || buffer[0] != ROVER_TELEMETRY_VERSION) {
+    return false;
+  }
+  uint8_t length = 0;
+  telemetry->version = buffer[length++];
+  telemetry->seq = buffer[length++];
+  telemetry->period_ms = rover_unpack16(buffer, &length);
+  rover_unpack_timer(buffer, &length, &telemetry->loop);
+  rover_unpack_timer(buffer, &length, &telemetry->command);
+  rover_unpack_timer(buffer, &length, &telemetry->i2c);
+  telemetry->frames = rover_unpack16(buffer, &length);
+  telemetry->lost_frames = rover_unpack16(buffer, &length);
+  telemetry->crc_errors = rover_unpack16(buffer, &length);
+  telemetry->i2c_errors = rover_unpack16(buffer, &length);
+  telemetry->i2c_refused = rover_unpack16(buffer, &length);
+  telemetry->free_ram = rover_unpack16(buffer, &length);
+  for (uint8_t i = 0; i < ROVER_TELEMETRY_TASKS; i++) {
+    RoverTaskTelemetry * task = &telemetry->task[i];
+    task->runs = rover_unpack16(buffer, &length);
+    task->overruns = rover_unpack16(buffer, &length);
+    task->jitter_max_us = rover_unpack16(buffer, &length);
+    task->jitter_avg_us = rover_unpack16(buffer, &length);
+    task->run_max_us = rover_unpack16(buffer, &length);
+  }
+  return true;
+}
+
+
+//----------   D E C O D E R   ----------
+struct RoverDecoder {
+  uint8_t    buffer[ROVER_FRAME_SIZE];
+  uint8_t    length;       // Bytes of the current frame received so far
+  uint16_t   crc;          // CRC of the current frame so far
+  uint16_t   crc_errors;   // Frames dropped because of a bad CRC
+  RoverFrame frame;        // Last good frame
+};
+
+static inline void rover_decoder_init(RoverDecoder * decoder) {
+  decoder->length = 0;
+  decoder->crc = 0xFFFF;
+  decoder->crc_errors = 0;
+}
+
+/***** rover_decoder_push() ***
+  Feeds one received byte to the decoder
+  @RETURN true when the byte completes a good frame (in decoder->frame)  */
+static inline bool rover_decoder_push(RoverDecoder * decoder, uint8_t byte) {
+  // Looking for the sync bytes
+  if (decoder->length == 0) {
+    if (byte == ROVER_SYNC_0) {
+      decoder->buffer[decoder->length++] = byte;
+    }
+    return false;
+  }
+  if (decoder->length == 1) {
+    if (byte == ROVER_SYNC_1) {
+      decoder->buffer[decoder->length++] = byte;
+      decoder->crc = 0xFFFF;
+    } else if (byte != ROVER_SYNC_0) {
+      decoder->length = 0;
+    }
+    return false;
+  }
+
+  decoder->buffer[decoder->length++] = byte;
+  if (decoder->length <= ROVER_FRAME_SIZE - 2) {
+    decoder->crc = rover_crc16_update(decoder->crc, byte);
+    return false;
+  }
+  if (decoder->length < ROVER_FRAME_SIZE) {
+    return false;
+  }
+
+  // Complete frame
+  decoder->length = 0;
+  const uint8_t * b = decoder->buffer;
+  uint16_t crc = (uint16_t) b[ROVER_FRAME_SIZE - 2] | ((uint16_t) b[ROVER_FRAME_SIZE - 1] << 8);
+  if (crc != decoder->crc) {
+    decoder->crc_errors++;
+    return false;
+  }
+  decoder->frame.seq  = b[2];
+  decoder->frame.type = b[3];
+  decoder->frame.mask = (uint16_t) b[4] | ((uint16_t) b[5] << 8);
+  for (uint8_t i = 0; i < ROVER_CHANNEL_COUNT; i++) {
+    decoder->frame.pulse[i] = (uint16_t) b[ROVER_HEADER_SIZE + 2 * i] | ((uint16_t) b[ROVER_HEADER_SIZE + 2 * i + 1] << 8);
+  }
+  return true;
+}
+
+#endif
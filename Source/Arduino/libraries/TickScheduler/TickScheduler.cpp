@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <avr/interrupt.h>
+#include "TickScheduler.h"
+
+static volatile uint16_t ticks = 0;
+
+ISR(TIMER2_COMPA_vect) {
+  ticks++;
+}
+
+uint16_t scheduler_ticks() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t now = ticks;
+  SREG = sreg;
+  return now;
+}
+
+void scheduler_begin(SchedulerTask * tasks, uint8_t count) {
+  // CTC, clk/64, 250 counts: 16 MHz / 64 / 250 = 1 kHz
+  uint8_t sreg = SREG;
+  cli();
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS22);
+  OCR2A = (uint8_t) (F_CPU / 64 / (1000000UL / SCHEDULER_TICK_US) - 1);
+  TCNT2 = 0;
+  TIMSK2 |= _BV(OCIE2A);
+  ticks = 0;
+  SREG = sreg;
+
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].due = 1;
+    scheduler_reset_stats(&tasks[i]);
+  }
+}
+
+void scheduler_reset_stats(SchedulerTask * task) {
+  task->runs = 0;
+  task->overruns = 0;
+  task->jitter_max = 0;
+  task->jitter_sum = 0;
+  task->run_max = 0;
+}
+
+void scheduler_run(SchedulerTask * tasks, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    SchedulerTask& task = tasks[i];
+    uint16_t now = scheduler_ticks();
+    if ((int16_t) (now - task.due) < 0) {
+      continue;
+    }
+
+    unsigned long start = micros();
+    task.run();
+    unsigned long end = micros();
+
+    // Timing
+    unsigned long period_us = (unsigned long) task.period * SCHEDULER_TICK_US;
+    if (task.runs > 0) {
+      long interval = (long) (start - task.last_start);
+      unsigned long jitter = (unsigned long) labs(interval - (long) period_us);
+      if (jitter > 0xFFFF) {
+        jitter = 0xFFFF;
+      }
+      task.jitter_sum += jitter;
+      if (jitter > task.jitter_max) {
+        task.jitter_max = (uint16_t) jitter;
+      }
+    }
+    task.last_start = start;
+    task.runs++;
+    unsigned long run_us = end - start;
+    if (run_us > task.run_max) {
+      task.run_max = (uint16_t) (run_us > 0xFFFF ? 0xFFFF : run_us);
+    }
+    if (run_us > period_us) {
+      task.overruns++;
+    }
+
+    // Next period (missed ones are skipped, not caught up)
+    task.due += task.period;
+    while ((int16_t) (now - task.due) >= 0) {
+      task.due += task.period;
+      task.overruns++;
+    }
+  }
+}
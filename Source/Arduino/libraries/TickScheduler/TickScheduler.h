@@ -0,0 +1,57 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <stdint.h>
+
+/*-----------------------------------------------------------------------------------
+//-------------------------   T I C K   S C H E D U L E R   -------------------------
+//-----------------------------------------------------------------------------------
+  A 1 kHz timer interrupt (Timer2, compare match A) counts ticks, and
+  scheduler_run(), called from loop(), runs every task whose period is up.
+  Tasks are plain functions that return quickly (cooperative, nothing is
+  preempted), each with a fixed period in ticks (ms).
+
+  Every task keeps its own timing:
+    jitter   - how far the time between two runs was from the period (us)
+    overruns - periods that went by without a run (the loop was busy) plus
+               runs that took longer than the period
+  Tasks are run at a fixed rate: a late task keeps its schedule (it is not
+  run twice to catch up, the missed periods count as overruns).
+
+  Uses Timer2, so tone() and analogWrite() on pins 3 and 11 are not available.
+*/
+
+#define SCHEDULER_TICK_US  1000
+
+struct SchedulerTask {
+  void (*run)();
+  uint16_t period;          // Ticks between runs
+  // # Filled in by the scheduler
+  uint16_t due;             // Tick of the next run
+  unsigned long last_start; // micros() at the last run
+  uint16_t runs;
+  uint16_t overruns;
+  uint16_t jitter_max;      // us
+  uint32_t jitter_sum;      // us, over runs - 1 intervals
+  uint16_t run_max;         // Longest run (us)
+};
+
+#define SCHEDULER_TASK(function, period)  { function, period, 0, 0, 0, 0, 0, 0, 0 }
+
+/***** scheduler_begin() ***
+  Starts the tick interrupt and schedules every task's first run on the next tick  */
+void scheduler_begin(SchedulerTask * tasks, uint8_t count);
+
+/***** scheduler_ticks() ***
+  @RETURN ticks since scheduler_begin() (wraps every 65.5 s)  */
+uint16_t scheduler_ticks();
+
+/***** scheduler_run() ***
+  Runs every task that is due, in table order (call from loop())  */
+void scheduler_run(SchedulerTask * tasks, uint8_t count);
+
+/***** scheduler_reset_stats() ***
+  Starts new timing statistics for one task  */
+void scheduler_reset_stats(SchedulerTask * task);
+
+#endif
@@ -0,0 +1,175 @@
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <util/twi.h>
+#include "TwiQueue.h"
+
+/* Queue layout: each transaction is [address, length, data...] in the ring.
+  The caller only moves head (with interrupts off), the interrupt only moves
+  tail.  While a transaction is sent, tail stays on its first data byte
+  still to go and remaining counts the bytes left. */
+
+static volatile uint8_t ring[TWI_QUEUE_SIZE];
+static volatile uint8_t head = 0;        // Next free byte
+static volatile uint8_t tail = 0;        // Next byte to send
+static volatile uint8_t used = 0;        // Bytes in the ring
+static volatile uint8_t address = 0;     // Of the transaction being sent
+static volatile uint8_t remaining = 0;   // Its data bytes left
+static volatile bool busy = false;       // The interrupt is working through the queue
+
+volatile uint16_t twi_queue_errors = 0;
+volatile uint16_t twi_queue_refused = 0;
+
+static unsigned long started = 0;        // micros() at the START of the current transaction
+static TwiQueueTiming timing = { 0, 0xFFFF, 0, 0 };
+
+#define TWCR_SEND   (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
+static inline uint8_t next(uint8_t index) {
+  return (index + 1 == TWI_QUEUE_SIZE) ? 0 : index + 1;
+}
+
+/***** load_transaction() ***
+  Takes the header of the transaction at tail (interrupts off)  */
+static inline void load_transaction() {
+  address = ring[tail];
+  tail = next(tail);
+  remaining = ring[tail];
+  tail = next(tail);
+  used -= 2;
+}
+
+/***** finish_transaction() ***
+  Drops what is left of the current transaction, then STOP and either
+    START the next one or go idle  */
+static inline void finish_transaction() {
+  unsigned long elapsed = micros() - started;
+  uint16_t us = (elapsed > 0xFFFF) ? 0xFFFF : (uint16_t) elapsed;
+  if (us < timing.min_us) {
+    timing.min_us = us;
+  }
+  if (us > timing.max_us) {
+    timing.max_us = us;
+  }
+  if (timing.count < 0xFFFF) {
+    timing.count++;
+    timing.total_us += us;
+  }
+
+  while (remaining > 0) {
+    tail = next(tail);
+    remaining--;
+    used--;
+  }
+  if (used > 0) {
+    load_transaction();
+    TWCR = TWCR_SEND | _BV(TWSTO) | _BV(TWSTA);
+  } else {
+    busy = false;
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+  }
+}
+
+ISR(TWI_vect) {
+  switch (TW_STATUS) {
+    case TW_START:
+    case TW_REP_START:
+      started = micros();
+      TWDR = (uint8_t) (address << 1) | TW_WRITE;
+      TWCR = TWCR_SEND;
+      break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (remaining > 0) {
+        TWDR = ring[tail];
+        tail = next(tail);
+        remaining--;
+        used--;
+        TWCR = TWCR_SEND;
+      } else {
+        finish_transaction();
+      }
+      break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MT_DATA_NACK:
+    case TW_MT_ARB_LOST:
+    default:  // Bus error
+      twi_queue_errors++;
+      finish_transaction();
+      break;
+  }
+}
+
+void twi_queue_begin(uint32_t frequency) {
+  digitalWrite(SDA, HIGH);   // Internal pull ups (like Wire)
+  digitalWrite(SCL, HIGH);
+  TWSR &= ~(_BV(TWPS0) | _BV(TWPS1));
+  TWBR = (uint8_t) (((F_CPU / frequency) - 16) / 2);
+  TWCR = _BV(TWEN);
+}
+
+bool twi_queue_write(uint8_t slave, const uint8_t * data, uint8_t length) {
+  if (length > TWI_QUEUE_MAX_LENGTH) {
+    return false;
+  }
+  uint8_t sreg = SREG;
+  cli();
+  if (used + length + 2 > TWI_QUEUE_SIZE) {
+    twi_queue_refused++;
+    SREG = sreg;
+    return false;
+  }
+  ring[head] = slave;
+  head = next(head);
+  ring[head] = length;
+  head = next(head);
+  for (uint8_t i = 0; i < length; i++) {
+    ring[head] = data[i];
+    head = next(head);
+  }
+  used += length + 2;
+
+  if (!busy) {
+    busy = true;
+    load_transaction();
+    TWCR = TWCR_SEND | _BV(TWSTA);
+  }
+  SREG = sreg;
+  return true;
+}
+
+uint8_t twi_queue_free() {
+  uint8_t sreg = SREG;
+  cli();
+  uint8_t free_bytes = TWI_QUEUE_SIZE - used;
+  SREG = sreg;
+  if (free_bytes < 2) {
+    return 0;
+  }
+  free_bytes -= 2;
+  return free_bytes > TWI_QUEUE_MAX_LENGTH ? TWI_QUEUE_MAX_LENGTH : free_bytes;
+}
+
+void twi_queue_take_timing(TwiQueueTiming * copy) {
+  uint8_t sreg = SREG;
+  cli();
+  *copy = timing;
+  timing.count = 0;
+  timing.min_us = 0xFFFF;
+  timing.max_us = 0;
+  timing.total_us = 0;
+  SREG = sreg;
+}
+
+bool twi_queue_idle() {
+  return !busy;
+}
+
+void twi_queue_flush() {
+  while (busy) {
+  }
+  while (TWCR & _BV(TWSTO)) {
+    // Last STOP still going out
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef TWI_QUEUE_H
+#define TWI_QUEUE_H
+
+#include <stdint.h>
+
+/*-----------------------------------------------------------------------------------
+//--------------------   T W I   T R A N S M I T   Q U E U E   ----------------------
+//-----------------------------------------------------------------------------------
+  Interrupt driven I2C writes for the AVR TWI, instead of Wire.
+
+  Wire's endTransmission() spins until the last byte is on the bus, ~0.6 ms
+  for one setPWM() at 100 kHz, and loop() (serial, the motor ramp) waits with
+  it.  twi_queue_write() copies a whole transaction into a ring buffer and
+  returns; the TWI interrupt sends the queued transactions back to back
+  (STOP and START of the next in one step) while loop() carries on.
+
+  Write only: every transaction is an address and up to TWI_QUEUE_MAX_LENGTH
+  data bytes.  A transaction that does not fit in the free space is refused
+  (false), so the caller can keep its data and try again later instead of
+  waiting for the bus.  A NACK or bus error drops the rest of the transaction
+  and is counted in twi_queue_errors.
+
+  The interrupt also times every transaction (START to STOP) for the
+  firmware telemetry, see twi_queue_take_timing().
+
+  Cannot be linked with Wire (both own the TWI interrupt).
+*/
+
+// Ring buffer bytes (each transaction takes length + 2), at most 255 (the
+// indexes are 8 bit).  A command changing every pin takes 65 bytes and a
+// shadow refresh 66: 192 holds both, with room for the next command's
+// motor run, so a burst queues instead of being refused.  TwiQueue.cpp
+// is compiled on its own, so a different size has to come from the build
+// flags, not a #define in the sketch.
+#ifndef TWI_QUEUE_SIZE
+#define TWI_QUEUE_SIZE        192
+#endif
+#define TWI_QUEUE_MAX_LENGTH  40    // Most data bytes in one transaction
+
+extern volatile uint16_t twi_queue_errors;   // NACKs, bus errors and lost arbitrations
+extern volatile uint16_t twi_queue_refused;  // Transactions that did not fit (twi_queue_write() false)
+
+struct TwiQueueTiming {
+  uint16_t count;      // Transactions finished
+  uint16_t min_us;
+  uint16_t max_us;
+  uint32_t total_us;
+};
+
+/***** twi_queue_begin() ***
+  Enables the TWI (and the SDA/SCL pull ups) at frequency Hz  */
+void twi_queue_begin(uint32_t frequency);
+
+/***** twi_queue_write() ***
+  Queues one transaction
+  @RETURN false if it does not fit (nothing is queued)  */
+bool twi_queue_write(uint8_t address, const uint8_t * data, uint8_t length);
+
+/***** twi_queue_free() ***
+  @RETURN the data bytes the largest transaction that fits right now could have  */
+uint8_t twi_queue_free();
+
+/***** twi_queue_idle() ***
+  @RETURN true once every queued transaction is on the bus  */
+bool twi_queue_idle();
+
+/***** twi_queue_take_timing() ***
+  Copies the transaction timing since the last call, and starts over  */
+void twi_queue_take_timing(TwiQueueTiming * timing);
+
+/***** twi_queue_flush() ***
+  Waits until the queue is empty (for setup(), never from loop())  */
+void twi_queue_flush();
+
+#endif
@@ -0,0 +1,756 @@
+/* arduino_manual_keyboard_control on the host simulator (see sim.h)
+
+  Soak test, as fast as the host goes:
+    $ ./arduino_manual_keyboard_control_sim --soak 3600 [--rate 50] [--seed 1] [--burst 8]
+  Sends the sketch what arduino_command_translator would (delta frames, a
+  keyframe every 20 frames, a new motor profile every 10 s, a few pulses out
+  of range, a servo move now and then), checks every pulse the PCA9685 gets
+  against the servo ranges, the motor ramp limits and the servo move steps,
+  and that every channel ends on its last command.
+  Prints the counters and the sketch's last telemetry report; exits 1 on
+  any violation.
+
+  Benchmarks of the command and motor code, host ns and cycles a call:
+    $ ./arduino_manual_keyboard_control_sim --bench 100000
+
+  The _binary_sim build is the same sketch with USE_BINARY_PROTOCOL.  */
+
+#include <Arduino.h>
+#include "../arduino_manual_keyboard_control/arduino_manual_keyboard_control.ino"
+#include "sim.h"
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#else
+#define HAVE_RDTSC 0
+#endif
+
+//----------   C H A N N E L S   ----------
+// Range and PCA9685 pin of every message index, from the sketch's CHANNEL
+// TABLE (pin -1 for a channel it does not drive)
+struct Channel {
+  int pin;
+  int min;
+  int max;
+  bool motor;
+};
+
+static Channel channels[MSG_CHANNEL_COUNT];
+
+/***** load_channels() ***
+  Reads the channel table through the sketch's accessors
+  @RETURN false if an entry is not at its own message index  */
+static bool load_channels() {
+  bool ordered = true;
+  for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+    Channel& channel = channels[index];
+    channel.pin = (channel_kind(index) == CHANNEL_NONE) ? -1 : channel_pin(index);
+    channel.min = channel_min(index);
+    channel.max = channel_max(index);
+    channel.motor = (channel_kind(index) == CHANNEL_MOTOR);
+    if (channel_msg_index(index) != index) {
+      fprintf(stderr, "CHANNELS[%u] is message index %u\n", index, channel_msg_index(index));
+      ordered = false;
+    }
+  }
+  return ordered;
+}
+
+// Motor commands stay this far from neutral (the translator's speed range)
+#define MOTOR_SPAN  200
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next() {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+static int random_between(int low, int high) {
+  return low + (int) (random_next() % (uint32_t) (high - low + 1));
+}
+
+
+//----------   H O S T   S I D E   ----------
+static uint8_t host_seq = 0;
+static uint32_t frames_sent = 0;
+static uint32_t moves_sent = 0;
+
+#if USE_BINARY_PROTOCOL
+static void send_frame(uint8_t type, uint16_t mask, const uint16_t * pulse) {
+  RoverFrame frame;
+  frame.seq = host_seq;
+  frame.type = type;
+  frame.mask = mask;
+  for (uint8_t i = 0; i < ROVER_CHANNEL_COUNT; i++) {
+    frame.pulse[i] = (mask & (1 << i)) ? pulse[i] : 0;
+  }
+  if (type == ROVER_FRAME_MOTOR_PROFILE) {
+    for (uint8_t i = 0; i < PROFILE_WORDS; i++) {
+      frame.pulse[i] = pulse[i];
+    }
+  }
+  uint8_t buffer[ROVER_FRAME_SIZE];
+  sim_serial_send(buffer, rover_encode_frame(buffer, &frame));
+}
+
+/***** send_command() ***
+  Sends the channels in mask (every one for a keyframe)  */
+static void send_command(const uint16_t * command, uint16_t mask) {
+  send_frame(ROVER_FRAME_COMMAND, mask, command);
+  host_seq++;
+  frames_sent++;
+}
+
+static void send_profile(const uint16_t * words) {
+  send_frame(ROVER_FRAME_MOTOR_PROFILE, 0, words);
+}
+
+static void send_moves(const uint16_t * words, uint8_t length) {
+  RoverFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.type = ROVER_FRAME_SERVO_MOVE;
+  frame.mask = length;
+  memcpy(frame.pulse, words, length * sizeof(uint16_t));
+  uint8_t buffer[ROVER_FRAME_SIZE];
+  sim_serial_send(buffer, rover_encode_frame(buffer, &frame));
+  moves_sent++;
+}
+
+#else
+static void send_message(const char * topic, uint16_t * words, uint32_t length) {
+  std_msgs::UInt16MultiArray msg;
+  msg.data_length = length;
+  msg.data = words;
+  uint8_t buffer[256];
+  sim_ros_send(topic, buffer, msg.serialize(buffer));
+  msg.data = NULL;
+}
+
+static void send_command(const uint16_t * command, uint16_t mask) {
+  uint16_t words[MSG_CHANNEL_COUNT + 2];
+  uint32_t length = 0;
+  if (mask == ROVER_KEYFRAME_MASK) {
+    for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+      words[length++] = command[index];
+    }
+  } else {
+    words[length++] = 0;
+    for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+      if (mask & (1 << index)) {
+        words[length++] = (uint16_t) ((index << DELTA_CHANNEL_SHIFT) | (command[index] & DELTA_PULSE_MASK));
+      }
+    }
+    words[0] = (uint16_t) (DELTA_FRAME_TAG | (length - 1));
+  }
+  words[length++] = host_seq;
+  send_message("arduino_cmd", words, length);
+  host_seq++;
+  frames_sent++;
+}
+
+static void send_profile(const uint16_t * words) {
+  uint16_t copy[PROFILE_WORDS];
+  memcpy(copy, words, sizeof(copy));
+  send_message("arduino_motor_profile", copy, PROFILE_WORDS);
+}
+
+static void send_moves(const uint16_t * words, uint8_t length) {
+  uint16_t copy[1 + 2 * MSG_CHANNEL_COUNT];
+  copy[0] = MOVE_FRAME_TAG | (length / MOVE_WORDS);
+  memcpy(copy + 1, words, length * sizeof(uint16_t));
+  send_message("arduino_cmd", copy, length + 1);
+  moves_sent++;
+}
+#endif
+
+
+//----------   R E P L I E S   ----------
+// Echoes and telemetry total_reports the sketch sent back
+static uint32_t echoes = 0;
+static RoverTelemetry busiest_report;    // The one with the most frames
+static uint32_t total_reports = 0;
+static uint32_t total_frames = 0, total_lost = 0, total_crc_errors = 0;
+static uint32_t total_overruns[TASK_COUNT];
+static uint16_t least_free_ram = 0xFFFF;
+
+/***** take_report() ***
+  Adds one packed telemetry report to the totals  */
+static void take_report(const uint8_t * bytes, uint16_t size) {
+  RoverTelemetry report;
+  if (!rover_telemetry_unpack(&report, bytes, size)) {
+    return;
+  }
+  if (total_reports == 0 || report.frames >= busiest_report.frames) {
+    busiest_report = report;
+  }
+  total_reports++;
+  total_frames += report.frames;
+  total_lost += report.lost_frames;
+  total_crc_errors += report.crc_errors;
+  least_free_ram = min(least_free_ram, report.free_ram);
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    total_overruns[i] += report.task[i].overruns;
+  }
+}
+
+#if USE_BINARY_PROTOCOL
+static RoverDecoder reply_decoder;
+static size_t reply_read = 0;
+static uint8_t report_pages[ROVER_TELEMETRY_PAGES * ROVER_PAYLOAD_SIZE];
+static uint8_t report_pages_seen = 0;
+
+static void read_replies() {
+  for (; reply_read < sim_serial_output.size(); reply_read++) {
+    if (!rover_decoder_push(&reply_decoder, sim_serial_output[reply_read])) {
+      continue;
+    }
+    const RoverFrame& frame = reply_decoder.frame;
+    if (frame.type == ROVER_FRAME_ECHO) {
+      echoes++;
+    } else if (frame.type == ROVER_FRAME_TELEMETRY && frame.mask < ROVER_TELEMETRY_PAGES) {
+      if (frame.mask == 0) {
+        report_pages_seen = 0;
+      }
+      for (uint8_t i = 0; i < ROVER_CHANNEL_COUNT; i++) {
+        report_pages[frame.mask * ROVER_PAYLOAD_SIZE + 2 * i] = (uint8_t) (frame.pulse[i] & 0xFF);
+        report_pages[frame.mask * ROVER_PAYLOAD_SIZE + 2 * i + 1] = (uint8_t) (frame.pulse[i] >> 8);
+      }
+      if (++report_pages_seen == ROVER_TELEMETRY_PAGES) {
+        take_report(report_pages, sizeof(report_pages));
+      }
+    }
+  }
+  sim_serial_output.clear();
+  reply_read = 0;
+}
+
+#else
+static void read_replies() {
+  for (size_t i = 0; i < sim_ros_published.size(); i++) {
+    const SimRosMessage& message = sim_ros_published[i];
+    if (message.topic == "arduino_echo") {
+      echoes++;
+    } else if (message.topic == "arduino_telemetry" && message.payload.size() > 12) {
+      // Layout (no dimensions, data_offset) and data_length come first
+      take_report(message.payload.data() + 12, (uint16_t) (message.payload.size() - 12));
+    }
+  }
+  sim_ros_published.clear();
+  sim_serial_output.clear();
+}
+#endif
+
+
+//----------   C H E C K S   ----------
+static uint32_t violations = 0;
+static uint16_t expected[MSG_CHANNEL_COUNT];   // Last in range command of every channel
+static int max_motor_step = 0;                 // Most a motor pulse may move in one period
+static uint16_t last_pulse[16];
+// Servo moves: most a pulse may change in one step, from when the move is
+// in until another command for the servo is sent
+static int move_step[16];
+static uint64_t move_from_us[16], move_until_us[16];
+
+static void violation(const char * what, int pin, int value) {
+  if (violations < 20) {
+    printf("  VIOLATION at %.3f s: %s (pin %d, %d)\n", sim_now_us / 1e6, what, pin, value);
+  }
+  violations++;
+}
+
+/***** allow_profile() ***
+  Widens the motor step check to a profile's limits  */
+static void allow_profile(const uint16_t * words) {
+  int fastest = max(words[PROFILE_WORD_ACCELERATION], words[PROFILE_WORD_EMERGENCY]);
+  int step = (fastest * MOTOR_TASK_PERIOD + 999) / 1000 + 1;
+  max_motor_step = max(max_motor_step, step);
+}
+
+/***** check_pulses() ***
+  Every pulse the PCA9685 got since the last call must be in its channel's
+    range, and no motor may move faster than its profile lets it  */
+static void check_pulses() {
+  for (size_t i = 0; i < sim_pulse_log.size(); i++) {
+    const SimPulseChange& change = sim_pulse_log[i];
+    const Channel * channel = NULL;
+    for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+      if (channels[index].pin == change.channel) {
+        channel = &channels[index];
+      }
+    }
+    if (channel == NULL) {
+      violation("pulse on an unused channel", change.channel, change.pulse);
+      continue;
+    }
+    if (change.pulse < channel->min || change.pulse > channel->max) {
+      violation("pulse out of range", change.channel, change.pulse);
+    }
+    int step = abs((int) change.pulse - (int) last_pulse[change.channel]);
+    if (channel->motor && step > max_motor_step) {
+      violation("motor stepped faster than its profile", change.channel, step);
+    }
+    if (!channel->motor && move_from_us[change.channel] <= change.time_us &&
+        change.time_us < move_until_us[change.channel] && step > move_step[change.channel]) {
+      violation("servo move stepped further than its duration allows", change.channel, step);
+    }
+    last_pulse[change.channel] = change.pulse;
+  }
+  sim_pulse_log.clear();
+  sim_register_log.clear();
+}
+
+
+//----------   S O A K   ----------
+static unsigned long loop_us = 50;  // Time one loop() stands for
+
+static void run_for(uint64_t us) {
+  uint64_t end = sim_now_us + us;
+  while (sim_now_us < end) {
+    loop();
+    sim_advance(loop_us);
+  }
+}
+
+static void random_profile(uint16_t * words) {
+  words[PROFILE_WORD_MOTORS] = (uint16_t) random_between(1, 0x1F);
+  words[PROFILE_WORD_PROFILE] = (uint16_t) random_between(PROFILE_TRAPEZOIDAL, PROFILE_S_CURVE);
+  words[PROFILE_WORD_ACCELERATION] = (uint16_t) random_between(200, 2000);
+  words[PROFILE_WORD_JERK] = (uint16_t) random_between(1000, 20000);
+  words[PROFILE_WORD_EMERGENCY] = (uint16_t) random_between(1000, 4000);
+}
+
+/***** random_move() ***
+  Moves one servo to a random pulse over up to 3 s, and lets its steps be
+    checked while it moves  */
+static void random_move(uint16_t * command) {
+  uint8_t index;
+  do {
+    index = (uint8_t) random_between(0, MSG_CHANNEL_COUNT - 2);
+  } while (channels[index].motor);
+  const Channel& channel = channels[index];
+  uint16_t target = (uint16_t) random_between(channel.min, channel.max);
+  uint16_t duration = (uint16_t) random_between(0, 3000);
+  uint16_t words[2] = { (uint16_t) ((index << DELTA_CHANNEL_SHIFT) | target), duration };
+
+  check_pulses();  // Against the steps of the last move
+  int periods = (duration + MOTOR_TASK_PERIOD / 2) / MOTOR_TASK_PERIOD;
+  int range = channel.max - channel.min;
+  move_step[channel.pin] = (periods == 0) ? range : (range + periods - 1) / periods + 1;
+  move_from_us[channel.pin] = sim_now_us + 50000;  // Once the last command's pulses are out
+  move_until_us[channel.pin] = UINT64_MAX;
+  send_moves(words, 2);
+  command[index] = target;
+  expected[index] = target;
+}
+
+static void print_timer(const char * name, const RoverTimer& timer) {
+  printf("    %-8s %6u samples, min %5u us, avg %5u us, max %5u us\n", name, timer.count,
+         timer.count ? timer.min_us : 0, timer.count ? (unsigned) (timer.total_us / timer.count) : 0,
+         timer.max_us);
+}
+
+static int soak(double seconds, double rate, int burst) {
+  static const char * task_names[TASK_COUNT] = { "serial", "motors", "telemetry" };
+  struct timespec wall_start, wall_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+  sim_reset();
+  setup();
+  run_for(100000);  // The home positions go out
+  uint16_t defaults[PROFILE_WORDS] = { 0x1F, PROFILE_TRAPEZOIDAL, DEFAULT_ACCELERATION, DEFAULT_JERK, DEFAULT_EMERGENCY };
+  allow_profile(defaults);
+  for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+    const Channel& channel = channels[index];
+    if (channel.pin < 0) {
+      expected[index] = 0;
+    } else if (channel.motor) {
+      expected[index] = NEUTRAL_SPEED_PWM;
+      last_pulse[channel.pin] = NEUTRAL_SPEED_PWM;
+    } else {
+      expected[index] = sim_pca9685_pulse(PCA9685_DEFAULT_ADDRESS, channel.pin);
+      last_pulse[channel.pin] = expected[index];
+    }
+  }
+  check_pulses();
+  read_replies();
+
+  uint16_t command[MSG_CHANNEL_COUNT];
+  memcpy(command, expected, sizeof(command));
+  uint64_t frame_period = (uint64_t) (1000000 / rate);
+  uint64_t end = (uint64_t) (seconds * 1000000);
+  uint64_t next_frame = sim_now_us;
+  uint64_t next_profile = sim_now_us + 10000000;
+  uint64_t next_burst = sim_now_us + 1000000;
+  int since_keyframe = 0;
+
+  while (sim_now_us < end) {
+    if (sim_now_us >= next_profile) {
+      next_profile += 10000000;
+      uint16_t words[PROFILE_WORDS];
+      random_profile(words);
+      allow_profile(words);
+      send_profile(words);
+    }
+    if (sim_now_us >= next_frame) {
+      next_frame += frame_period;
+      int frames = 1;
+      if (burst > 0 && sim_now_us >= next_burst) {
+        next_burst += 1000000;
+        frames = burst;
+      }
+      // Not while a burst is still on the link (its pulses would land in the move)
+      if (frames == 1 && sim_now_us + 500000 >= next_burst && random_between(0, 9) == 0) {
+        random_move(command);
+        frames = 0;
+      }
+      for (int f = 0; f < frames; f++) {
+        uint16_t mask = 0;
+        int changes = random_between(1, 3);
+        for (int c = 0; c < changes; c++) {
+          uint8_t index = (uint8_t) random_between(0, MSG_CHANNEL_COUNT - 2);
+          const Channel& channel = channels[index];
+          int low = channel.motor ? NEUTRAL_SPEED_PWM - MOTOR_SPAN : channel.min;
+          int high = channel.motor ? NEUTRAL_SPEED_PWM + MOTOR_SPAN : channel.max;
+          if (random_between(0, 49) == 0) {
+            // Out of range, must be ignored (12 bits, for the delta frames)
+            command[index] = (uint16_t) (channel.max + random_between(1, min(100, 4095 - channel.max)));
+          } else {
+            command[index] = (uint16_t) random_between(low, high);
+            expected[index] = command[index];
+            if (channel.pin >= 0) {
+              move_until_us[channel.pin] = min(move_until_us[channel.pin], sim_now_us);  // Stops a move
+            }
+          }
+          mask |= (uint16_t) (1 << index);
+        }
+        if (++since_keyframe >= 20) {
+          since_keyframe = 0;
+          mask = ROVER_KEYFRAME_MASK;
+          // A keyframe carries every channel: resend the kept values
+          memcpy(command, expected, sizeof(command));
+        }
+        send_command(command, mask);
+      }
+    }
+    loop();
+    sim_advance(loop_us);
+    if (sim_pulse_log.size() > 4096) {
+      check_pulses();
+      read_replies();
+    }
+  }
+
+  // Last keyframe, then long enough for the slowest ramp
+  sim_record = true;
+  memcpy(command, expected, sizeof(command));
+  send_command(command, ROVER_KEYFRAME_MASK);
+  run_for(10000000);
+  check_pulses();
+  read_replies();
+  for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+    const Channel& channel = channels[index];
+    if (channel.pin < 0) {
+      continue;
+    }
+    uint16_t pulse = sim_pca9685_pulse(PCA9685_DEFAULT_ADDRESS, channel.pin);
+    bool never_driven = channel.motor && pulse == 0 && expected[index] == NEUTRAL_SPEED_PWM;
+    if (pulse != expected[index] && !never_driven) {
+      violation("channel did not end on its last command", channel.pin, pulse);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+  double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+  double simulated = sim_now_us / 1e6;
+  printf("soak (%s): %.0f s simulated in %.2f s (%.0fx real time), %u frames sent\n",
+         USE_BINARY_PROTOCOL ? "binary" : "rosserial", simulated, wall, simulated / wall, frames_sent);
+  printf("  serial: %u bytes in, %u lost to overruns, %u bad frames, %u dropped; %u bytes out (waited %.3f s)\n",
+         sim_counters.serial_rx_bytes, sim_counters.serial_rx_overruns, sim_counters.ros_bad_frames,
+         sim_counters.ros_dropped, sim_counters.serial_tx_bytes, sim_counters.serial_tx_wait_us / 1e6);
+  printf("  i2c: %u transactions, %u bytes, %u register writes, %u refused, %u errors\n",
+         sim_counters.i2c_transactions, sim_counters.i2c_bytes, sim_counters.register_writes,
+         twi_queue_refused, twi_queue_errors);
+  printf("  echoes: %u, servo moves: %u\n", echoes, moves_sent);
+  if (total_reports > 0) {
+    printf("  telemetry: %u reports, %u frames, %u lost, %u crc errors, least free ram %u B\n",
+           total_reports, total_frames, total_lost, total_crc_errors, least_free_ram);
+    const RoverTelemetry& report = busiest_report;
+    printf("  busiest report (#%u, %u ms):\n", report.seq, report.period_ms);
+    print_timer("loop", report.loop);
+    print_timer("command", report.command);
+    print_timer("i2c", report.i2c);
+    printf("    frames %u, lost %u, crc errors %u, i2c errors %u, i2c refused %u, free ram %u B\n",
+           report.frames, report.lost_frames, report.crc_errors, report.i2c_errors,
+           report.i2c_refused, report.free_ram);
+    for (uint8_t i = 0; i < TASK_COUNT; i++) {
+      const RoverTaskTelemetry& task = report.task[i];
+      printf("    %-9s %5u runs, %u overruns (%u in all), jitter avg %u us max %u us, run max %u us\n",
+             task_names[i], task.runs, task.overruns, total_overruns[i], task.jitter_avg_us,
+             task.jitter_max_us, task.run_max_us);
+    }
+    if (total_frames != frames_sent && sim_counters.serial_rx_overruns == 0 && sim_counters.ros_dropped == 0) {
+      violation("telemetry frame count is not the frames sent", -1, (int) total_frames);
+    }
+  } else {
+    violation("no telemetry report", -1, 0);
+  }
+  printf("%u violations\n", violations);
+  return violations > 0 ? 1 : 0;
+}
+
+
+//----------   B E N C H M A R K S   ----------
+/* Every call is timed on its own (the simulated I2C and serial are drained
+  in between, untimed) with the cycle counter where there is one, else the
+  monotonic clock.  The cost of reading the counter is taken off.  */
+static inline uint64_t nanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline uint64_t ticks() {
+#if HAVE_RDTSC
+  return __rdtsc();
+#else
+  return nanoseconds();
+#endif
+}
+
+static double ticks_per_ns = 1.0;
+static double overhead_ticks = 0;
+
+static std::vector<uint64_t> samples;
+
+static void calibrate() {
+  uint64_t start_ns = nanoseconds();
+  uint64_t start = ticks();
+  while (nanoseconds() - start_ns < 50000000) {
+  }
+  ticks_per_ns = (double) (ticks() - start) / (nanoseconds() - start_ns);
+
+  samples.clear();
+  for (int i = 0; i < 100000; i++) {
+    uint64_t before = ticks();
+    samples.push_back(ticks() - before);
+  }
+  std::sort(samples.begin(), samples.end());
+  overhead_ticks = (double) samples[samples.size() / 2];
+  samples.clear();  // Not the first bench's
+}
+
+/***** report_bench() ***
+  Prints the median and mean of the samples (less the timing overhead)  */
+static void report_bench(const char * name) {
+  std::sort(samples.begin(), samples.end());
+  double total = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    total += samples[i];
+  }
+  double median = max((double) samples[samples.size() / 2] - overhead_ticks, 0.0);
+  double mean = max(total / samples.size() - overhead_ticks, 0.0);
+  printf("  %-28s median %7.1f ns (%6.0f cycles), mean %7.1f ns\n", name, median / ticks_per_ns,
+         HAVE_RDTSC ? median : median * ticks_per_ns, mean / ticks_per_ns);
+  samples.clear();
+}
+
+// One command a call of apply_command(), as the sketch receives it
+#if USE_BINARY_PROTOCOL
+static uint8_t bench_frames[2][ROVER_FRAME_SIZE];
+static uint8_t bench_lengths[2];
+
+static void prepare_command(int which, const uint16_t * command, uint16_t mask) {
+  RoverFrame frame;
+  frame.seq = (uint8_t) which;
+  frame.type = ROVER_FRAME_COMMAND;
+  frame.mask = mask;
+  memcpy(frame.pulse, command, sizeof(frame.pulse));
+  bench_lengths[which] = rover_encode_frame(bench_frames[which], &frame);
+}
+
+static inline void apply_command(int which) {
+  sim_serial_inject(bench_frames[which], bench_lengths[which]);
+  read_binary_frames();
+}
+
+#else
+static std_msgs::UInt16MultiArray bench_msgs[2];
+static uint16_t bench_words[2][MSG_CHANNEL_COUNT + 2];
+
+static void prepare_command(int which, const uint16_t * command, uint16_t mask) {
+  uint32_t length = 0;
+  if (mask == ROVER_KEYFRAME_MASK) {
+    for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+      bench_words[which][length++] = command[index];
+    }
+  } else {
+    bench_words[which][length++] = 0;
+    for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+      if (mask & (1 << index)) {
+        bench_words[which][length++] = (uint16_t) ((index << DELTA_CHANNEL_SHIFT) | command[index]);
+      }
+    }
+    bench_words[which][0] = (uint16_t) (DELTA_FRAME_TAG | (length - 1));
+  }
+  bench_words[which][length++] = (uint16_t) which;
+  bench_msgs[which].data_length = length;
+  bench_msgs[which].data = bench_words[which];
+}
+
+static inline void apply_command(int which) {
+  arduino_cmd_callback(bench_msgs[which]);
+}
+#endif
+
+/***** bench_commands() ***
+  Alternates between two commands so every call changes the pulses  */
+static void bench_commands(const char * name, const uint16_t * a, const uint16_t * b, uint16_t mask, long count) {
+  prepare_command(0, a, mask);
+  prepare_command(1, b, mask);
+  for (long i = 0; i < count; i++) {
+    uint64_t start = ticks();
+    apply_command((int) (i & 1));
+    samples.push_back(ticks() - start);
+    sim_drain();
+    sim_ros_published.clear();
+    sim_serial_output.clear();
+  }
+  report_bench(name);
+}
+
+static void bench_motors(const char * name, uint8_t profile, long count) {
+  uint16_t words[PROFILE_WORDS] = { 0x1F, profile, DEFAULT_ACCELERATION, DEFAULT_JERK, DEFAULT_EMERGENCY };
+  set_motor_profile(words);
+  for (long i = 0; i < count; i++) {
+    // A new target every 50 periods (a ramp takes ~40), so most calls are mid ramp
+    if (i % 50 == 0) {
+      uint16_t target = (i % 100 == 0) ? NEUTRAL_SPEED_PWM + MOTOR_SPAN : NEUTRAL_SPEED_PWM - MOTOR_SPAN;
+      for (uint8_t motor = 0; motor < 5; motor++) {
+        target_motor_pwm[motor] = target;
+      }
+    }
+    uint64_t start = ticks();
+    task_update_DC_motors();
+    samples.push_back(ticks() - start);
+    sim_drain();
+  }
+  report_bench(name);
+}
+
+/***** bench_servo_moves() ***
+  Every servo moving (new moves of 100 periods every 100 calls, between a
+    and b), the motors at their targets  */
+static void bench_servo_moves(const char * name, const uint16_t * a, const uint16_t * b, long count) {
+  for (uint8_t motor = 0; motor < MOTOR_COUNT; motor++) {
+    target_motor_pwm[motor] = current_motor_pwm[motor];
+    motor_profile[motor].pulse = (int32_t) current_motor_pwm[motor] << MOTOR_FRACTION_BITS;
+  }
+  for (long i = 0; i < count; i++) {
+    if (i % 100 == 0) {
+      const uint16_t * target = (i % 200 == 0) ? b : a;
+      uint16_t words[2 * MSG_CHANNEL_COUNT];
+      uint8_t length = 0;
+      for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+        if (channels[index].pin >= 0 && !channels[index].motor) {
+          words[length++] = (uint16_t) ((index << DELTA_CHANNEL_SHIFT) | target[index]);
+          words[length++] = 100 * MOTOR_TASK_PERIOD;
+        }
+      }
+      set_servo_moves(words, length);
+    }
+    uint64_t start = ticks();
+    task_update_DC_motors();
+    samples.push_back(ticks() - start);
+    sim_drain();
+  }
+  report_bench(name);
+}
+
+static int bench(long count) {
+  sim_reset();
+  setup();
+  sim_record = false;  // Logging is not what is measured
+  sim_drain();
+
+  uint16_t a[MSG_CHANNEL_COUNT], b[MSG_CHANNEL_COUNT];
+  for (uint8_t index = 0; index < MSG_CHANNEL_COUNT; index++) {
+    const Channel& channel = channels[index];
+    int low = channel.motor ? NEUTRAL_SPEED_PWM - MOTOR_SPAN : channel.min;
+    int high = channel.motor ? NEUTRAL_SPEED_PWM + MOTOR_SPAN : channel.max;
+    a[index] = (uint16_t) (channel.pin < 0 ? 0 : low + (high - low) / 3);
+    b[index] = (uint16_t) (channel.pin < 0 ? 0 : low + 2 * (high - low) / 3);
+  }
+
+  calibrate();
+  printf("benchmarks (%s, %ld calls each, host time%s):\n", USE_BINARY_PROTOCOL ? "binary" : "rosserial",
+         count, HAVE_RDTSC ? "" : ", no cycle counter");
+  bench_commands("keyframe, every channel", a, b, ROVER_KEYFRAME_MASK, count);
+  bench_commands("delta frame, 3 channels", a, b, (1 << 0) | (1 << 4) | (1 << 8), count);
+  bench_commands("keyframe, nothing changed", a, a, ROVER_KEYFRAME_MASK, count);
+  bench_motors("motor task, trapezoidal", PROFILE_TRAPEZOIDAL, count);
+  bench_motors("motor task, S-curve", PROFILE_S_CURVE, count);
+  bench_servo_moves("motor task, 9 servos moving", a, b, count);
+  return 0;
+}
+
+
+int main(int argc, char ** argv) {
+  double soak_seconds = 0;
+  long bench_count = 0;
+  double rate = 50;
+  int burst = 0;
+  for (int i = 1; i < argc; i++) {
+    const char * arg = argv[i];
+    const char * value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (value == NULL) {
+      fprintf(stderr, "%s needs a value\n", arg);
+      return 2;
+    }
+    if (strcmp(arg, "--soak") == 0) {
+      soak_seconds = atof(value);
+    } else if (strcmp(arg, "--bench") == 0) {
+      bench_count = atol(value);
+    } else if (strcmp(arg, "--rate") == 0) {
+      rate = atof(value);
+    } else if (strcmp(arg, "--seed") == 0) {
+      random_state = (uint32_t) strtoul(value, NULL, 0);
+    } else if (strcmp(arg, "--loop-us") == 0) {
+      loop_us = strtoul(value, NULL, 0);
+    } else if (strcmp(arg, "--burst") == 0) {
+      burst = atoi(value);
+    } else {
+      fprintf(stderr, "usage: %s [--soak SECONDS] [--bench CALLS] [--rate HZ] [--seed N] [--loop-us US] [--burst FRAMES]\n",
+              argv[0]);
+      return 2;
+    }
+    i++;
+  }
+  if (random_state == 0) {
+    random_state = 1;
+  }
+  if (rate <= 0 || loop_us == 0) {
+    fprintf(stderr, "--rate and --loop-us must be positive\n");
+    return 2;
+  }
+  if (soak_seconds <= 0 && bench_count <= 0) {
+    soak_seconds = 60;
+  }
+
+  if (!load_channels()) {
+    return 1;
+  }
+
+  int result = 0;
+  if (soak_seconds > 0) {
+    result = soak(soak_seconds, rate, burst);
+  }
+  if (bench_count > 0) {
+    result |= bench(bench_count);
+  }
+  return result;
+}
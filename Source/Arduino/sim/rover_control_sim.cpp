@@ -0,0 +1,91 @@
+/* I2C_PWM_rover_control on the host simulator (see sim.h)
+
+    $ ./I2C_PWM_rover_control_sim [--log]
+  Sweeps every arm servo through arm_cmd_manual angles, toggles the vacuum
+  pump, and checks what the PCA9685 and the pump pin end up with.  --log
+  prints every register write with its virtual timestamp.  Exits 1 on any
+  mismatch.  */
+
+#include <Arduino.h>
+#include "../I2C_PWM_rover_control/I2C_PWM_rover_control.ino"
+#include "sim.h"
+#include <stdio.h>
+
+static uint32_t failures = 0;
+
+static void send_arm_cmd(int16_t servo, int16_t angle) {
+  int16_t words[2] = { servo, angle };
+  std_msgs::Int16MultiArray msg;
+  msg.data_length = 2;
+  msg.data = words;
+  uint8_t buffer[64];
+  sim_ros_send("arm_cmd_manual", buffer, msg.serialize(buffer));
+  msg.data = NULL;
+}
+
+/***** run_for() ***
+  Runs loop() (and its delay(1)) for us of virtual time  */
+static void run_for(uint64_t us) {
+  uint64_t end = sim_now_us + us;
+  while (sim_now_us < end) {
+    loop();
+  }
+}
+
+/***** reference_pulse() ***
+  The arm servo pulse for an angle, worked out in doubles like the sketch's
+    arm_angle_to_pulse() did before PwmChannel  */
+static int reference_pulse(int angle) {
+  double pulse = ARM_SERVO_NEUTRAL + (angle * 1.0 * ARM_SERVO_FULL_TURN) / 360;
+  return (int) max(min(floor(pulse), (double) ARM_SERVO_MAX), (double) ARM_SERVO_MIN);
+}
+
+static void expect(const char * what, int got, int wanted) {
+  if (got != wanted) {
+    printf("  MISMATCH: %s is %d, expected %d\n", what, got, wanted);
+    failures++;
+  }
+}
+
+int main(int argc, char ** argv) {
+  bool log = (argc > 1 && strcmp(argv[1], "--log") == 0);
+
+  sim_reset();
+  setup();
+  run_for(10000);
+  expect("MODE1 after setPWMFreq()", sim_pca9685_register(0x40, PCA9685_MODE1) & 0xA1, 0xA1);
+  expect("prescale for 50 Hz", sim_pca9685_register(0x40, PCA9685_PRESCALE), 135);
+  for (uint8_t servo = 0; servo < 4; servo++) {
+    expect("arm servo home pulse", sim_pca9685_pulse(0x40, servo), ARM_SERVO_NEUTRAL);
+  }
+  expect("vacuum pin mode", sim_pin_mode[VACUUM_PIN], OUTPUT);
+
+  uint32_t commands = 0;
+  for (int16_t servo = 0; servo < 4; servo++) {
+    for (int16_t angle = -360; angle <= 360; angle += 5) {
+      send_arm_cmd(servo, angle);
+      run_for(20000);
+      commands++;
+      expect("arm servo pulse", sim_pca9685_pulse(0x40, servo), reference_pulse(angle));
+    }
+  }
+  send_arm_cmd(4, 1);
+  run_for(20000);
+  expect("vacuum pump on", sim_pin_level[VACUUM_PIN], HIGH);
+  send_arm_cmd(4, 0);
+  run_for(20000);
+  expect("vacuum pump off", sim_pin_level[VACUUM_PIN], LOW);
+
+  if (log) {
+    for (size_t i = 0; i < sim_register_log.size(); i++) {
+      const SimRegisterWrite& write = sim_register_log[i];
+      printf("%10.6f s  0x%02X  reg 0x%02X = 0x%02X\n", write.time_us / 1e6, write.address, write.reg, write.value);
+    }
+  }
+  printf("I2C_PWM_rover_control: %u commands in %.2f s simulated, %u I2C transactions, "
+         "%u register writes, %u pulse changes, %u bad frames\n",
+         commands + 2, sim_now_us / 1e6, sim_counters.i2c_transactions, sim_counters.register_writes,
+         (unsigned) sim_pulse_log.size(), sim_counters.ros_bad_frames);
+  printf("%u mismatches\n", failures);
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,72 @@
+#ifndef ARDUINO_SIM_ADAFRUIT_PWM_SERVO_DRIVER_H
+#define ARDUINO_SIM_ADAFRUIT_PWM_SERVO_DRIVER_H
+
+// Stand-in for Adafruit_PWMServoDriver: the library's own register writes,
+// through the Wire stand-in, so the simulated PCA9685 sees what the real one would
+#include <Arduino.h>
+#include <Wire.h>
+
+#define PCA9685_MODE1     0x00
+#define PCA9685_PRESCALE  0xFE
+#define LED0_ON_L         0x06
+
+class Adafruit_PWMServoDriver {
+ public:
+  Adafruit_PWMServoDriver(uint8_t address = 0x40) : i2caddr(address) {}
+
+  void begin() {
+    Wire.begin();
+    reset();
+  }
+
+  void reset() {
+    write8(PCA9685_MODE1, 0x00);
+  }
+
+  void setPWMFreq(float freq) {
+    freq *= 0.9;  // Correct for overshoot in the frequency setting
+    float prescaleval = 25000000;
+    prescaleval /= 4096;
+    prescaleval /= freq;
+    prescaleval -= 1;
+    uint8_t prescale = (uint8_t) floor(prescaleval + 0.5);
+
+    uint8_t oldmode = read8(PCA9685_MODE1);
+    uint8_t newmode = (oldmode & 0x7F) | 0x10;  // sleep
+    write8(PCA9685_MODE1, newmode);
+    write8(PCA9685_PRESCALE, prescale);
+    write8(PCA9685_MODE1, oldmode);
+    delay(5);
+    write8(PCA9685_MODE1, oldmode | 0xa1);      // Restart, auto-increment
+  }
+
+  void setPWM(uint8_t num, uint16_t on, uint16_t off) {
+    Wire.beginTransmission(i2caddr);
+    Wire.write(LED0_ON_L + 4 * num);
+    Wire.write(on);
+    Wire.write(on >> 8);
+    Wire.write(off);
+    Wire.write(off >> 8);
+    Wire.endTransmission();
+  }
+
+ private:
+  uint8_t i2caddr;
+
+  uint8_t read8(uint8_t addr) {
+    Wire.beginTransmission(i2caddr);
+    Wire.write(addr);
+    Wire.endTransmission();
+    Wire.requestFrom(i2caddr, (uint8_t) 1);
+    return Wire.read();
+  }
+
+  void write8(uint8_t addr, uint8_t d) {
+    Wire.beginTransmission(i2caddr);
+    Wire.write(addr);
+    Wire.write(d);
+    Wire.endTransmission();
+  }
+};
+
+#endif
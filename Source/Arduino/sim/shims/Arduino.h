@@ -0,0 +1,76 @@
+#ifndef ARDUINO_SIM_ARDUINO_H
+#define ARDUINO_SIM_ARDUINO_H
+
+// Stand-in for the AVR Arduino core (see sim.h).  The C++ headers the
+// simulator needs come first: the min/max macros below would break them.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+
+#define ARDUINO  10805
+#define F_CPU    16000000UL
+
+#define HIGH     1
+#define LOW      0
+#define INPUT    0
+#define OUTPUT   1
+#define SDA      18
+#define SCL      19
+
+typedef uint8_t  byte;
+typedef bool     boolean;
+typedef uint16_t word;
+
+#define min(a, b)                ((a) < (b) ? (a) : (b))
+#define max(a, b)                ((a) > (b) ? (a) : (b))
+#define constrain(x, low, high)  ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+#define lowByte(w)               ((uint8_t) ((w) & 0xFF))
+#define highByte(w)              ((uint8_t) ((w) >> 8))
+
+//----------   T I M E   ----------
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+//----------   P I N S   ----------
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+//----------   R E G I S T E R S   ----------
+// Timer2 (TickScheduler); the simulator fires TIMER2_COMPA_vect from these
+extern volatile uint8_t SREG;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, TCNT2, TIMSK2;
+#define WGM21   1
+#define CS20    0
+#define CS21    1
+#define CS22    2
+#define OCIE2A  1
+
+//----------   S E R I A L   ----------
+class HardwareSerial {
+ public:
+  void begin(unsigned long baud);
+  void end() {}
+  int available();
+  int read();
+  int peek();
+  int availableForWrite();
+  size_t write(uint8_t byte);
+  size_t write(const uint8_t * buffer, size_t length);
+  size_t write(const char * text) { return write((const uint8_t *) text, strlen(text)); }
+  void flush();
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef ARDUINO_SIM_WIRE_H
+#define ARDUINO_SIM_WIRE_H
+
+// Stand-in for Wire (see sim.h): endTransmission() waits the transaction's
+// time on the virtual clock, then applies it to the simulated device
+#include <Arduino.h>
+
+#define WIRE_BUFFER_LENGTH  32   // Like Wire, longer writes are cut short
+
+class TwoWire {
+ public:
+  TwoWire() : frequency(100000), address(0), length(0), transmitting(false), available_bytes(0), read_address(0) {}
+  void begin() {}
+  void setClock(uint32_t clock) { frequency = clock; }
+  void beginTransmission(uint8_t slave);
+  void beginTransmission(int slave) { beginTransmission((uint8_t) slave); }
+  size_t write(uint8_t byte);
+  size_t write(const uint8_t * data, size_t count);
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t slave, uint8_t count);
+  uint8_t requestFrom(int slave, int count) { return requestFrom((uint8_t) slave, (uint8_t) count); }
+  int available() { return available_bytes; }
+  int read();
+
+ private:
+  uint32_t frequency;
+  uint8_t address;
+  uint8_t buffer[WIRE_BUFFER_LENGTH];
+  uint8_t length;
+  bool transmitting;
+  uint8_t available_bytes;
+  uint8_t read_address;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef ARDUINO_SIM_INTERRUPT_H
+#define ARDUINO_SIM_INTERRUPT_H
+
+// Interrupt handlers are plain functions, called by sim_advance() (see sim.h).
+// Nothing runs between two statements of the sketch, so cli()/sei() only
+// keep SREG's I bit up to date.
+#include <stdint.h>
+
+#define ISR(vector, ...)  extern "C" void vector(void)
+#define _BV(bit)          (1 << (bit))
+
+extern volatile uint8_t SREG;
+
+static inline void cli() { SREG &= (uint8_t) ~0x80; }
+static inline void sei() { SREG |= 0x80; }
+#define noInterrupts()  cli()
+#define interrupts()    sei()
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef ARDUINO_SIM_PGMSPACE_H
+#define ARDUINO_SIM_PGMSPACE_H
+
+// Flash is ordinary memory on the host
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(text)               (text)
+#define pgm_read_byte(address)   (*(const uint8_t *) (address))
+#define pgm_read_word(address)   (*(const uint16_t *) (address))
+#define pgm_read_dword(address)  (*(const uint32_t *) (address))
+#define pgm_read_ptr(address)    (*(void * const *) (address))
+#define memcpy_P                 memcpy
+#define strlen_P                 strlen
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef ARDUINO_SIM_ROS_H
+#define ARDUINO_SIM_ROS_H
+
+/* Stand-in for rosserial_arduino's ros_lib (see sim.h).  Messages go over
+  the simulated Serial in rosserial's framing:
+    0xFF, 0xFE, <length L, H>, <length checksum>, <topic id L, H>, <message>, <checksum>
+  and NodeHandle_ decodes them a byte at a time like the real one: a message
+  longer than INPUT_SIZE is dropped, so are frames with bad checksums (bytes
+  lost to receive buffer overruns) and frames not finished within 20 ms.
+  Published messages are framed and written to Serial (taking their time on
+  the link) and also logged whole in sim_ros_published.  There is no topic
+  negotiation or time sync: the sketch is connected from initNode(). */
+
+#include <Arduino.h>
+#include "../sim.h"
+
+// Global, like rosserial's ArduinoHardware.h
+class ArduinoHardware {
+ public:
+  void init() { Serial.begin(57600); }
+  int read() { return Serial.read(); }
+  void write(uint8_t * data, int length) { Serial.write(data, length); }
+  unsigned long time() { return millis(); }
+};
+
+namespace ros {
+
+class Msg {
+ public:
+  virtual ~Msg() {}
+  virtual int serialize(unsigned char * outbuffer) const = 0;
+  virtual int deserialize(unsigned char * inbuffer) = 0;
+};
+
+class NodeHandleBase_ {
+ public:
+  virtual ~NodeHandleBase_() {}
+  virtual int publish(int id, const Msg * msg) = 0;
+};
+
+class Publisher {
+ public:
+  Publisher(const char * topic_name, Msg * msg, int endpoint = 0)
+    : topic_(topic_name), msg_(msg), id_(-1), nh_(NULL) { (void) endpoint; }
+  int publish(const Msg * msg) { return (nh_ != NULL) ? nh_->publish(id_, msg) : -1; }
+
+  const char * topic_;
+  Msg * msg_;
+  int id_;
+  NodeHandleBase_ * nh_;
+};
+
+class Subscriber_ {
+ public:
+  virtual ~Subscriber_() {}
+  virtual void callback(unsigned char * data) = 0;
+  const char * topic_;
+  int id_;
+};
+
+template<typename MsgT>
+class Subscriber : public Subscriber_ {
+ public:
+  typedef void (*CallbackT)(const MsgT&);
+  Subscriber(const char * topic_name, CallbackT callback, int endpoint = 0) : cb_(callback) {
+    (void) endpoint;
+    topic_ = topic_name;
+    id_ = -1;
+  }
+  virtual void callback(unsigned char * data) {
+    msg.deserialize(data);
+    cb_(msg);
+  }
+  MsgT msg;
+
+ private:
+  CallbackT cb_;
+};
+
+#define SIM_ROS_FIRST_TOPIC_ID  100   // Like rosserial's user topics
+#define SIM_ROS_MESSAGE_TIMEOUT 20    // ms to finish a frame
+
+template<class Hardware, int MAX_SUBSCRIBERS = 25, int MAX_PUBLISHERS = 25, int INPUT_SIZE = 512, int OUTPUT_SIZE = 512>
+class NodeHandle_ : public NodeHandleBase_ {
+ public:
+  NodeHandle_() : subscriber_count(0), publisher_count(0), mode(MODE_FIRST_FF) {}
+
+  void initNode() {
+    hardware.init();
+    subscriber_count = 0;
+    publisher_count = 0;
+    mode = MODE_FIRST_FF;
+    sim_ros_clear_subscribers();
+  }
+
+  bool connected() { return true; }
+
+  bool advertise(Publisher& publisher) {
+    if (publisher_count >= MAX_PUBLISHERS) {
+      return false;
+    }
+    publisher.id_ = SIM_ROS_FIRST_TOPIC_ID + MAX_SUBSCRIBERS + publisher_count;
+    publisher.nh_ = this;
+    publishers[publisher_count++] = &publisher;
+    return true;
+  }
+
+  template<typename SubscriberT>
+  bool subscribe(SubscriberT& subscriber) {
+    if (subscriber_count >= MAX_SUBSCRIBERS) {
+      return false;
+    }
+    subscriber.id_ = SIM_ROS_FIRST_TOPIC_ID + subscriber_count;
+    subscribers[subscriber_count++] = &subscriber;
+    sim_ros_register_subscriber(subscriber.topic_, subscriber.id_);
+    return true;
+  }
+
+  int spinOnce() {
+    unsigned long now = hardware.time();
+    if (mode != MODE_FIRST_FF && now > last_byte_time + SIM_ROS_MESSAGE_TIMEOUT) {
+      mode = MODE_FIRST_FF;  // Frame never finished
+    }
+    while (true) {
+      int data = hardware.read();
+      if (data < 0) {
+        break;
+      }
+      last_byte_time = now;
+      switch (mode) {
+        case MODE_FIRST_FF:
+          if (data == 0xFF) {
+            mode = MODE_PROTOCOL_VER;
+          }
+          break;
+        case MODE_PROTOCOL_VER:
+          mode = (data == 0xFE) ? MODE_SIZE_L : MODE_FIRST_FF;
+          break;
+        case MODE_SIZE_L:
+          bytes = data;
+          checksum = data;
+          mode = MODE_SIZE_H;
+          break;
+        case MODE_SIZE_H:
+          bytes += data << 8;
+          checksum += data;
+          mode = MODE_SIZE_CHECKSUM;
+          break;
+        case MODE_SIZE_CHECKSUM:
+          checksum += data;
+          if ((checksum % 256) != 255) {
+            sim_counters.ros_bad_frames++;
+            mode = MODE_FIRST_FF;
+          } else if (bytes > INPUT_SIZE) {
+            sim_counters.ros_dropped++;  // rosserial: "message larger than buffer"
+            mode = MODE_FIRST_FF;
+          } else {
+            mode = MODE_TOPIC_L;
+          }
+          break;
+        case MODE_TOPIC_L:
+          topic = data;
+          checksum = data;
+          mode = MODE_TOPIC_H;
+          break;
+        case MODE_TOPIC_H:
+          topic += data << 8;
+          checksum += data;
+          index = 0;
+          mode = (bytes == 0) ? MODE_MSG_CHECKSUM : MODE_MESSAGE;
+          break;
+        case MODE_MESSAGE:
+          message_in[index++] = (unsigned char) data;
+          checksum += data;
+          if (index == bytes) {
+            mode = MODE_MSG_CHECKSUM;
+          }
+          break;
+        case MODE_MSG_CHECKSUM:
+          mode = MODE_FIRST_FF;
+          if (((checksum + data) % 256) != 255) {
+            sim_counters.ros_bad_frames++;
+            break;
+          }
+          for (int i = 0; i < subscriber_count; i++) {
+            if (subscribers[i]->id_ == topic) {
+              subscribers[i]->callback(message_in);
+            }
+          }
+          break;
+      }
+    }
+    return 0;
+  }
+
+  virtual int publish(int id, const Msg * msg) {
+    int length = msg->serialize(message_out + 7);
+    if (length + 8 > OUTPUT_SIZE) {
+      sim_counters.ros_dropped++;
+      return -1;
+    }
+    message_out[0] = 0xFF;
+    message_out[1] = 0xFE;
+    message_out[2] = (unsigned char) (length & 0xFF);
+    message_out[3] = (unsigned char) (length >> 8);
+    message_out[4] = (unsigned char) (255 - ((message_out[2] + message_out[3]) % 256));
+    message_out[5] = (unsigned char) (id & 0xFF);
+    message_out[6] = (unsigned char) (id >> 8);
+    int sum = 0;
+    for (int i = 5; i < length + 7; i++) {
+      sum += message_out[i];
+    }
+    message_out[length + 7] = (unsigned char) (255 - (sum % 256));
+
+    for (int i = 0; i < publisher_count; i++) {
+      if (publishers[i]->id_ == id) {
+        SimRosMessage logged;
+        logged.time_us = sim_now_us;
+        logged.topic = publishers[i]->topic_;
+        logged.payload.assign(message_out + 7, message_out + 7 + length);
+        sim_ros_published.push_back(logged);
+      }
+    }
+    hardware.write(message_out, length + 8);
+    return length + 8;
+  }
+
+  void loginfo(const char *) {}
+  void logwarn(const char *) {}
+  void logerror(const char *) {}
+
+ private:
+  enum {
+    MODE_FIRST_FF, MODE_PROTOCOL_VER, MODE_SIZE_L, MODE_SIZE_H, MODE_SIZE_CHECKSUM,
+    MODE_TOPIC_L, MODE_TOPIC_H, MODE_MESSAGE, MODE_MSG_CHECKSUM
+  };
+
+  Hardware hardware;
+  Subscriber_ * subscribers[MAX_SUBSCRIBERS];
+  Publisher * publishers[MAX_PUBLISHERS];
+  int subscriber_count;
+  int publisher_count;
+  unsigned char message_in[INPUT_SIZE];
+  unsigned char message_out[OUTPUT_SIZE + 1024];  // Checked after serializing (like rosserial), so with slack
+  int mode;
+  int bytes;
+  int topic;
+  int index;
+  int checksum;
+  unsigned long last_byte_time;
+};
+
+// rosserial_arduino's default for an ATmega328P (6, 6, 150, 150 on an ATmega168)
+typedef NodeHandle_<ArduinoHardware, 25, 25, 280, 280> NodeHandle;
+
+}  // namespace ros
+
+#endif
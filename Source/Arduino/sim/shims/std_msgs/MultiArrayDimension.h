@@ -0,0 +1,19 @@
+#ifndef ARDUINO_SIM_STD_MSGS_MULTIARRAYDIMENSION_H
+#define ARDUINO_SIM_STD_MSGS_MULTIARRAYDIMENSION_H
+
+#include <ros.h>
+
+namespace std_msgs {
+
+// Not serialized: the simulator's layouts never have dimensions
+class MultiArrayDimension {
+ public:
+  const char * label;
+  uint32_t size;
+  uint32_t stride;
+  MultiArrayDimension() : label(""), size(0), stride(0) {}
+};
+
+}
+
+#endif
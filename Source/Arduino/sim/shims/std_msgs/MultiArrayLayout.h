@@ -0,0 +1,52 @@
+#ifndef ARDUINO_SIM_STD_MSGS_MULTIARRAYLAYOUT_H
+#define ARDUINO_SIM_STD_MSGS_MULTIARRAYLAYOUT_H
+
+#include <ros.h>
+#include "std_msgs/MultiArrayDimension.h"
+
+namespace std_msgs {
+
+class MultiArrayLayout {
+ public:
+  uint32_t dim_length;
+  MultiArrayDimension * dim;
+  uint32_t data_offset;
+
+  MultiArrayLayout() : dim_length(0), dim(NULL), data_offset(0) {}
+
+  int serialize(unsigned char * outbuffer) const {
+    int offset = 0;
+    offset += sim_serialize32(outbuffer + offset, 0);  // No dimensions
+    offset += sim_serialize32(outbuffer + offset, data_offset);
+    return offset;
+  }
+
+  int deserialize(unsigned char * inbuffer) {
+    int offset = 0;
+    dim_length = 0;
+    offset += sim_deserialize32(inbuffer + offset, &dim_length);
+    offset += dim_length * 12;  // Skipped (see MultiArrayDimension)
+    dim_length = 0;
+    offset += sim_deserialize32(inbuffer + offset, &data_offset);
+    return offset;
+  }
+
+  static int sim_serialize32(unsigned char * buffer, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      buffer[i] = (unsigned char) (value >> (8 * i));
+    }
+    return 4;
+  }
+
+  static int sim_deserialize32(const unsigned char * buffer, uint32_t * value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+      *value |= (uint32_t) buffer[i] << (8 * i);
+    }
+    return 4;
+  }
+};
+
+}
+
+#endif
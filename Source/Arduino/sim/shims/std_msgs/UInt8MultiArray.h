@@ -0,0 +1,53 @@
+#ifndef ARDUINO_SIM_STD_MSGS_UINT8MULTIARRAY_H
+#define ARDUINO_SIM_STD_MSGS_UINT8MULTIARRAY_H
+
+#include <ros.h>
+#include "std_msgs/MultiArrayLayout.h"
+
+namespace std_msgs {
+
+// rosserial's layout: data_length, then data reallocated as it grows
+class UInt8MultiArray : public ros::Msg {
+ public:
+  MultiArrayLayout layout;
+  uint32_t data_length;
+  uint8_t st_data;
+  uint8_t * data;
+
+  UInt8MultiArray() : data_length(0), st_data(0), data(NULL) {}
+
+  virtual int serialize(unsigned char * outbuffer) const {
+    int offset = layout.serialize(outbuffer);
+    offset += MultiArrayLayout::sim_serialize32(outbuffer + offset, data_length);
+    for (uint32_t i = 0; i < data_length; i++) {
+      for (size_t b = 0; b < sizeof(uint8_t); b++) {
+        outbuffer[offset++] = (unsigned char) ((uint16_t) data[i] >> (8 * b));
+      }
+    }
+    return offset;
+  }
+
+  virtual int deserialize(unsigned char * inbuffer) {
+    int offset = layout.deserialize(inbuffer);
+    uint32_t length;
+    offset += MultiArrayLayout::sim_deserialize32(inbuffer + offset, &length);
+    if (length > data_length) {
+      data = (uint8_t *) realloc(data, length * sizeof(uint8_t));
+    }
+    data_length = length;
+    for (uint32_t i = 0; i < data_length; i++) {
+      uint16_t value = 0;
+      for (size_t b = 0; b < sizeof(uint8_t); b++) {
+        value |= (uint16_t) inbuffer[offset++] << (8 * b);
+      }
+      data[i] = (uint8_t) value;
+    }
+    return offset;
+  }
+
+  const char * getType() { return "std_msgs/UInt8MultiArray"; }
+};
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+#include <Arduino.h>
+#include <deque>
+#include <utility>
+#include "sim.h"
+
+//----------   C L O C K   ----------
+uint64_t sim_now_us = 0;
+
+//----------   R E G I S T E R S   ----------
+volatile uint8_t SREG = 0x80;  // Interrupts on, like after the core's init()
+volatile uint8_t TCCR2A = 0, TCCR2B = 0, OCR2A = 0, TCNT2 = 0, TIMSK2 = 0;
+
+// Timer2 compare match A (TickScheduler), if it is linked in
+extern "C" void TIMER2_COMPA_vect(void) __attribute__((weak));
+
+#define SREG_I  0x80
+
+static uint64_t timer_period_us = 0;   // 0 while the interrupt is off
+static uint64_t timer_next_us = 0;
+static uint8_t timer_config[3] = { 0, 0, 0 };
+static bool timer_pending = false;     // Matched while interrupts were off
+
+/***** timer_period() ***
+  @RETURN the compare match A period the Timer2 registers ask for (us)  */
+static uint64_t timer_period() {
+  static const uint16_t prescalers[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+  uint16_t prescaler = prescalers[TCCR2B & 0x07];
+  if (prescaler == 0 || !(TIMSK2 & _BV(OCIE2A)) || !(TCCR2A & _BV(WGM21))) {
+    return 0;
+  }
+  uint64_t period = (uint64_t) prescaler * (OCR2A + 1) * 1000000ULL / F_CPU;
+  return (period == 0) ? 1 : period;
+}
+
+/***** check_timer() ***
+  Restarts the tick if the sketch reprogrammed Timer2  */
+static void check_timer() {
+  uint8_t config[3] = { TCCR2B, OCR2A, TIMSK2 };
+  if (memcmp(config, timer_config, sizeof(config)) != 0) {
+    memcpy(timer_config, config, sizeof(config));
+    timer_period_us = timer_period();
+    timer_next_us = sim_now_us + timer_period_us;
+  }
+}
+
+static void fire_timer() {
+  if (!(SREG & SREG_I)) {
+    timer_pending = true;
+    return;
+  }
+  timer_pending = false;
+  if (TIMER2_COMPA_vect) {
+    SREG &= ~SREG_I;
+    TIMER2_COMPA_vect();
+    SREG |= SREG_I;
+  }
+}
+
+
+//----------   S E R I A L   ----------
+#define SIM_SERIAL_BUFFER  64   // Both ways, like the ATmega328 core
+
+HardwareSerial Serial;
+std::vector<uint8_t> sim_serial_output;
+
+static uint64_t byte_ns = 1000000000ULL * 10 / 57600;  // Start, 8 data and stop bits
+static std::deque<uint8_t> rx_buffer;     // Arrived, not read yet
+static std::deque<uint8_t> rx_link;       // Sent by the host, still on the wire
+static uint64_t rx_next_ns = 0;           // When the first byte on the wire arrives
+static uint64_t tx_free_ns = 0;           // When the last byte written is out
+
+void HardwareSerial::begin(unsigned long baud) {
+  byte_ns = 1000000000ULL * 10 / baud;
+}
+
+int HardwareSerial::available() {
+  return (int) rx_buffer.size();
+}
+
+int HardwareSerial::read() {
+  if (rx_buffer.empty()) {
+    return -1;
+  }
+  uint8_t data = rx_buffer.front();
+  rx_buffer.pop_front();
+  return data;
+}
+
+int HardwareSerial::peek() {
+  return rx_buffer.empty() ? -1 : rx_buffer.front();
+}
+
+int HardwareSerial::availableForWrite() {
+  // Bytes not out yet (the one being shifted out included), see write()
+  uint64_t now_ns = sim_now_us * 1000;
+  uint64_t pending = (tx_free_ns > now_ns) ? (tx_free_ns - now_ns + byte_ns - 1) / byte_ns : 0;
+  return (int) min((uint64_t) SIM_SERIAL_BUFFER - 1, SIM_SERIAL_BUFFER - min(pending, (uint64_t) SIM_SERIAL_BUFFER));
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  // Bytes not out yet (the one being shifted out included)
+  uint64_t now_ns = sim_now_us * 1000;
+  if (tx_free_ns > now_ns + (SIM_SERIAL_BUFFER - 1) * byte_ns) {
+    uint64_t wait_ns = tx_free_ns - (SIM_SERIAL_BUFFER - 1) * byte_ns - now_ns;
+    uint64_t wait_us = (wait_ns + 999) / 1000;
+    sim_counters.serial_tx_wait_us += wait_us;
+    sim_advance(wait_us);
+    now_ns = sim_now_us * 1000;
+  }
+  tx_free_ns = max(tx_free_ns, now_ns) + byte_ns;
+  sim_serial_output.push_back(data);
+  sim_counters.serial_tx_bytes++;
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t * buffer, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    write(buffer[i]);
+  }
+  return length;
+}
+
+void HardwareSerial::flush() {
+  uint64_t now_ns = sim_now_us * 1000;
+  if (tx_free_ns > now_ns) {
+    sim_advance((tx_free_ns - now_ns + 999) / 1000);
+  }
+}
+
+void sim_serial_send(const uint8_t * bytes, size_t length) {
+  if (length == 0) {
+    return;
+  }
+  if (rx_link.empty()) {
+    rx_next_ns = sim_now_us * 1000 + byte_ns;
+  }
+  rx_link.insert(rx_link.end(), bytes, bytes + length);
+}
+
+void sim_serial_inject(const uint8_t * bytes, size_t length) {
+  rx_buffer.insert(rx_buffer.end(), bytes, bytes + length);
+}
+
+bool sim_serial_idle() {
+  return rx_link.empty();
+}
+
+static void receive_byte() {
+  if (rx_buffer.size() < SIM_SERIAL_BUFFER - 1) {  // The core keeps one slot free
+    rx_buffer.push_back(rx_link.front());
+    sim_counters.serial_rx_bytes++;
+  } else {
+    sim_counters.serial_rx_overruns++;
+  }
+  rx_link.pop_front();
+  rx_next_ns += byte_ns;
+}
+
+
+//----------   E V E N T S   ----------
+void sim_advance(uint64_t us) {
+  uint64_t end = sim_now_us + us;
+  while (true) {
+    check_timer();
+    if (timer_pending && (SREG & SREG_I)) {
+      fire_timer();
+    }
+
+    // The next event up to the end, timer first on a tie (it is the
+    // higher priority vector)
+    uint64_t next = end + 1;
+    int event = 0;
+    if (timer_period_us > 0 && timer_next_us < next) {
+      next = timer_next_us;
+      event = 1;
+    }
+    uint64_t rx_us = (rx_next_ns + 999) / 1000;
+    if (!rx_link.empty() && rx_us < next) {
+      next = rx_us;
+      event = 2;
+    }
+    uint64_t i2c_us;
+    if (sim_i2c_next_event(&i2c_us) && i2c_us < next) {
+      next = i2c_us;
+      event = 3;
+    }
+    if (event == 0) {
+      next = end;
+    }
+
+    sim_now_us = max(sim_now_us, next);
+    switch (event) {
+      case 0:
+        return;
+      case 1:
+        timer_next_us += timer_period_us;
+        fire_timer();
+        break;
+      case 2:
+        receive_byte();
+        break;
+      case 3:
+        sim_i2c_event();
+        break;
+    }
+  }
+}
+
+void sim_drain() {
+  sim_i2c_drain();
+  tx_free_ns = sim_now_us * 1000;
+}
+
+//----------   S T A C K   ----------
+// Checked by the sketches' free_ram()
+int __heap_start;
+int * __brkval = 0;
+
+#define SIM_RAM_GAP  2048
+
+void sim_reset() {
+  sim_now_us = 0;
+  SREG = SREG_I;
+  memset(timer_config, 0, sizeof(timer_config));
+  timer_period_us = 0;
+  timer_pending = false;
+  rx_buffer.clear();
+  rx_link.clear();
+  tx_free_ns = 0;
+  sim_serial_output.clear();
+  sim_i2c_reset();
+  sim_register_log.clear();
+  sim_pulse_log.clear();
+  memset(&sim_counters, 0, sizeof(sim_counters));
+  sim_ros_published.clear();
+  memset(sim_pin_mode, 0, sizeof(sim_pin_mode));
+  memset(sim_pin_level, 0, sizeof(sim_pin_level));
+  __brkval = (int *) ((char *) __builtin_frame_address(0) - SIM_RAM_GAP);
+}
+
+
+//----------   T I M E   ----------
+// unsigned long is 32 bits on the AVR: both wrap like the real ones
+unsigned long millis() {
+  return (uint32_t) (sim_now_us / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t) sim_now_us;
+}
+
+void delay(unsigned long ms) {
+  sim_advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  sim_advance(us);
+}
+
+
+//----------   P I N S   ----------
+uint8_t sim_pin_mode[32];
+uint8_t sim_pin_level[32];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < 32) {
+    sim_pin_mode[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < 32) {
+    sim_pin_level[pin] = (level != LOW);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < 32) ? sim_pin_level[pin] : LOW;
+}
+
+
+//----------   R O S S E R I A L   ----------
+std::vector<SimRosMessage> sim_ros_published;
+static std::vector<std::pair<std::string, int> > ros_subscribers;
+
+void sim_ros_register_subscriber(const char * topic, int id) {
+  ros_subscribers.push_back(std::make_pair(std::string(topic), id));
+}
+
+void sim_ros_clear_subscribers() {
+  ros_subscribers.clear();
+}
+
+bool sim_ros_send(const char * topic, const uint8_t * payload, size_t length) {
+  int id = -1;
+  for (size_t i = 0; i < ros_subscribers.size(); i++) {
+    if (ros_subscribers[i].first == topic) {
+      id = ros_subscribers[i].second;
+    }
+  }
+  if (id < 0) {
+    return false;
+  }
+
+  // rosserial framing (see ros.h)
+  std::vector<uint8_t> frame;
+  frame.push_back(0xFF);
+  frame.push_back(0xFE);
+  frame.push_back((uint8_t) (length & 0xFF));
+  frame.push_back((uint8_t) (length >> 8));
+  frame.push_back((uint8_t) (255 - ((frame[2] + frame[3]) % 256)));
+  frame.push_back((uint8_t) (id & 0xFF));
+  frame.push_back((uint8_t) (id >> 8));
+  frame.insert(frame.end(), payload, payload + length);
+  unsigned int sum = 0;
+  for (size_t i = 5; i < frame.size(); i++) {
+    sum += frame[i];
+  }
+  frame.push_back((uint8_t) (255 - (sum % 256)));
+  sim_serial_send(frame.data(), frame.size());
+  return true;
+}
@@ -0,0 +1,151 @@
+#ifndef ARDUINO_SIM_H
+#define ARDUINO_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------
+//-----------------------   A R D U I N O   S I M U L A T O R   ---------------------
+//-----------------------------------------------------------------------------------
+  Runs the sketches on Linux, against the stand-ins in shims/ for the AVR
+  core (Arduino.h, Serial, Timer2, PROGMEM), Wire, Adafruit_PWMServoDriver,
+  TwiQueue and ros_lib.  Everything happens on a virtual clock (sim_now_us)
+  that only moves when sim_advance() moves it, so a simulated hour takes
+  seconds and every run is repeatable.
+
+  What is modelled, in virtual time:
+    - Timer2 compare match A interrupts (the TickScheduler tick), at the rate
+      the sketch programs into TCCR2B/OCR2A
+    - The serial link: bytes from the host arrive at the baud rate into the
+      64 byte receive buffer (later bytes are dropped while it is full, like
+      the real UART), and Serial.write() waits while the 64 byte transmit
+      buffer is full
+    - The I2C bus: every transaction takes its bits at the bus clock.  TwiQueue
+      writes go out one after another in the background; Wire waits.
+    - PCA9685 boards: registers, MODE1 auto-increment and the pulse of every
+      channel.  Every register write and every pulse change is logged with
+      its virtual timestamp (while sim_record is set)
+  The sketch's own code takes no virtual time: the drivers call
+  sim_advance() after every loop() to stand for it.
+
+  free_ram() sees a 2 KB gap between the heap and the frame sim_reset() was
+  called from, so it reports 2048 less the stack the sketch uses on the host
+  (more than on the AVR, but it shows where the deepest call is).
+*/
+
+//----------   C L O C K   ----------
+extern uint64_t sim_now_us;
+
+/***** sim_advance() ***
+  Moves the clock on, firing every timer tick, serial byte arrival and I2C
+    completion that falls in between, in time order  */
+void sim_advance(uint64_t us);
+
+/***** sim_reset() ***
+  Back to time 0 with no pending bytes, transactions or log (the sketch's
+    globals are not reset)  */
+void sim_reset();
+
+/***** sim_drain() ***
+  Finishes every queued TwiQueue transaction and empties the serial transmit
+    buffer right away, without moving the clock (benchmarks)  */
+void sim_drain();
+
+
+//----------   I 2 C   ----------
+struct SimRegisterWrite {
+  uint64_t time_us;
+  uint8_t  address;
+  uint8_t  reg;
+  uint8_t  value;
+};
+
+struct SimPulseChange {
+  uint64_t time_us;
+  uint8_t  address;
+  uint8_t  channel;
+  uint16_t pulse;     // OFF count (ON is assumed 0, as the sketches write it)
+};
+
+struct SimCounters {
+  uint32_t i2c_transactions;
+  uint32_t i2c_bytes;
+  uint32_t register_writes;
+  uint32_t serial_rx_bytes;
+  uint32_t serial_rx_overruns;  // Bytes dropped, the receive buffer was full
+  uint32_t serial_tx_bytes;
+  uint64_t serial_tx_wait_us;   // Time Serial.write() waited for the transmit buffer
+  uint32_t ros_dropped;         // rosserial messages too big for the NodeHandle buffers
+  uint32_t ros_bad_frames;      // rosserial frames with a bad checksum (bytes lost)
+};
+
+extern bool sim_record;                                // Log register writes and pulse changes
+extern std::vector<SimRegisterWrite> sim_register_log;
+extern std::vector<SimPulseChange> sim_pulse_log;
+extern SimCounters sim_counters;
+
+/***** sim_i2c_time_us() ***
+  @RETURN how long a write of length data bytes takes on the bus  */
+uint64_t sim_i2c_time_us(uint8_t length, uint32_t frequency);
+
+/***** sim_i2c_write() ***
+  Applies one write transaction to the device at address (now)  */
+void sim_i2c_write(uint8_t address, const uint8_t * data, uint8_t length);
+
+/***** sim_i2c_read() ***
+  Reads from the device's register pointer (auto-incremented like a write)  */
+uint8_t sim_i2c_read(uint8_t address);
+
+uint16_t sim_pca9685_pulse(uint8_t address, uint8_t channel);
+uint8_t sim_pca9685_register(uint8_t address, uint8_t reg);
+
+// Used by sim_advance(): the end of the TwiQueue transaction on the bus
+bool sim_i2c_next_event(uint64_t * time_us);
+void sim_i2c_event();
+void sim_i2c_drain();
+void sim_i2c_reset();
+
+
+//----------   S E R I A L   L I N K   ----------
+/***** sim_serial_send() ***
+  Sends bytes from the host: they arrive one by one at the baud rate, after
+    whatever was sent before  */
+void sim_serial_send(const uint8_t * bytes, size_t length);
+
+/***** sim_serial_inject() ***
+  Puts bytes straight into the receive buffer (benchmarks, no overruns)  */
+void sim_serial_inject(const uint8_t * bytes, size_t length);
+
+/***** sim_serial_idle() ***
+  @RETURN true once every byte sent by the host has arrived  */
+bool sim_serial_idle();
+
+extern std::vector<uint8_t> sim_serial_output;  // Everything the sketch wrote
+
+
+//----------   R O S S E R I A L   ----------
+struct SimRosMessage {
+  uint64_t time_us;
+  std::string topic;
+  std::vector<uint8_t> payload;  // Serialized message
+};
+extern std::vector<SimRosMessage> sim_ros_published;  // Everything the sketch published
+
+/***** sim_ros_send() ***
+  Frames a serialized message for a topic the sketch subscribes to, and
+    sends it over the serial link
+  @RETURN false if the sketch has no such subscriber  */
+bool sim_ros_send(const char * topic, const uint8_t * payload, size_t length);
+
+// Used by the ros.h shim
+void sim_ros_register_subscriber(const char * topic, int id);
+void sim_ros_clear_subscribers();
+
+
+//----------   P I N S   ----------
+extern uint8_t sim_pin_mode[32];
+extern uint8_t sim_pin_level[32];
+
+#endif
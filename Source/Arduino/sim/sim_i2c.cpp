@@ -0,0 +1,313 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <TwiQueue.h>
+#include <deque>
+#include "sim.h"
+
+//----------   P C A 9 6 8 5   ----------
+/* Every address from 0x40 up answers as a PCA9685 (the boards' address
+  range); anything else NACKs.  Only what the sketches use is modelled:
+  the register file, MODE1 auto-increment and the LEDn registers.  */
+#define PCA9685_FIRST_ADDRESS  0x40
+#define PCA9685_MODE1_AI       0x20
+#define PCA9685_LED0           0x06
+#define PCA9685_CHANNELS       16
+
+struct Pca9685 {
+  bool     present;
+  uint8_t  registers[256];
+  uint8_t  pointer;
+  uint16_t pulse[PCA9685_CHANNELS];  // Last logged
+};
+
+static Pca9685 boards[128];
+
+bool sim_record = true;
+std::vector<SimRegisterWrite> sim_register_log;
+std::vector<SimPulseChange> sim_pulse_log;
+SimCounters sim_counters;
+
+static Pca9685 * board(uint8_t address) {
+  if (address < PCA9685_FIRST_ADDRESS || address >= 128) {
+    return NULL;
+  }
+  Pca9685& chip = boards[address];
+  if (!chip.present) {
+    chip.present = true;
+    memset(chip.registers, 0, sizeof(chip.registers));
+    chip.registers[0x00] = 0x11;  // MODE1 after power up: SLEEP, ALLCALL
+    chip.registers[0xFE] = 0x1E;  // PRE_SCALE (200 Hz)
+    chip.pointer = 0;
+    for (uint8_t channel = 0; channel < PCA9685_CHANNELS; channel++) {
+      chip.pulse[channel] = 0;
+    }
+  }
+  return &chip;
+}
+
+static void step_pointer(Pca9685 * chip) {
+  if (chip->registers[0x00] & PCA9685_MODE1_AI) {
+    chip->pointer++;
+  }
+}
+
+uint64_t sim_i2c_time_us(uint8_t length, uint32_t frequency) {
+  // START, address and data bytes (9 bits each with the ACK), STOP
+  uint64_t bits = 9 * (1 + (uint64_t) length) + 2;
+  return (bits * 1000000ULL + frequency - 1) / frequency;
+}
+
+void sim_i2c_write(uint8_t address, const uint8_t * data, uint8_t length) {
+  Pca9685 * chip = board(address);
+  if (chip == NULL) {
+    return;
+  }
+  sim_counters.i2c_transactions++;
+  sim_counters.i2c_bytes += length;
+  if (length == 0) {
+    return;
+  }
+  chip->pointer = data[0];
+  for (uint8_t i = 1; i < length; i++) {
+    uint8_t reg = chip->pointer;
+    chip->registers[reg] = data[i];
+    sim_counters.register_writes++;
+    if (sim_record) {
+      SimRegisterWrite write = { sim_now_us, address, reg, data[i] };
+      sim_register_log.push_back(write);
+    }
+    step_pointer(chip);
+  }
+
+  for (uint8_t channel = 0; channel < PCA9685_CHANNELS; channel++) {
+    const uint8_t * led = chip->registers + PCA9685_LED0 + 4 * channel;
+    uint16_t pulse = (uint16_t) (led[2] | ((led[3] & 0x0F) << 8));
+    if (pulse != chip->pulse[channel]) {
+      chip->pulse[channel] = pulse;
+      if (sim_record) {
+        SimPulseChange change = { sim_now_us, address, channel, pulse };
+        sim_pulse_log.push_back(change);
+      }
+    }
+  }
+}
+
+uint8_t sim_i2c_read(uint8_t address) {
+  Pca9685 * chip = board(address);
+  if (chip == NULL) {
+    return 0xFF;
+  }
+  uint8_t value = chip->registers[chip->pointer];
+  step_pointer(chip);
+  return value;
+}
+
+uint16_t sim_pca9685_pulse(uint8_t address, uint8_t channel) {
+  Pca9685 * chip = board(address);
+  return (chip == NULL || channel >= PCA9685_CHANNELS) ? 0 : chip->pulse[channel];
+}
+
+uint8_t sim_pca9685_register(uint8_t address, uint8_t reg) {
+  Pca9685 * chip = board(address);
+  return (chip == NULL) ? 0xFF : chip->registers[reg];
+}
+
+
+//----------   T W I   Q U E U E   ----------
+/* TwiQueue.h on the simulated bus: transactions go out one after another,
+  each taking sim_i2c_time_us(), and reach the PCA9685 when they finish.
+  The ring buffer is only accounted (length + 2 bytes a transaction, the
+  header given back when it starts), so refusals happen when they would.  */
+struct TwiTransaction {
+  uint8_t address;
+  uint8_t length;
+  uint8_t data[TWI_QUEUE_MAX_LENGTH];
+};
+
+volatile uint16_t twi_queue_errors = 0;
+volatile uint16_t twi_queue_refused = 0;
+
+static std::deque<TwiTransaction> queue;
+static uint32_t twi_frequency = 100000;
+static uint16_t used = 0;               // Ring buffer bytes taken
+static bool busy = false;               // queue.front() is on the bus
+static uint64_t started_us = 0;
+static uint64_t finished_us = 0;
+static TwiQueueTiming timing = { 0, 0xFFFF, 0, 0 };
+
+static void start_next() {
+  busy = !queue.empty();
+  if (busy) {
+    started_us = sim_now_us;
+    finished_us = sim_now_us + sim_i2c_time_us(queue.front().length, twi_frequency);
+    used -= 2;
+  }
+}
+
+/***** finish_transaction() ***
+  Applies the transaction on the bus, and starts the next  */
+static void finish_transaction() {
+  const TwiTransaction& transaction = queue.front();
+  if (board(transaction.address) == NULL) {
+    twi_queue_errors++;  // Address NACK
+  } else {
+    sim_i2c_write(transaction.address, transaction.data, transaction.length);
+  }
+  uint64_t elapsed = finished_us - started_us;
+  uint16_t us = (elapsed > 0xFFFF) ? 0xFFFF : (uint16_t) elapsed;
+  timing.min_us = min(timing.min_us, us);
+  timing.max_us = max(timing.max_us, us);
+  if (timing.count < 0xFFFF) {
+    timing.count++;
+    timing.total_us += us;
+  }
+  used -= transaction.length;
+  queue.pop_front();
+  start_next();
+}
+
+bool sim_i2c_next_event(uint64_t * time_us) {
+  *time_us = finished_us;
+  return busy;
+}
+
+void sim_i2c_event() {
+  finish_transaction();
+}
+
+void sim_i2c_drain() {
+  while (busy) {
+    finished_us = sim_now_us;
+    finish_transaction();
+  }
+}
+
+void sim_i2c_reset() {
+  queue.clear();
+  used = 0;
+  busy = false;
+  twi_queue_errors = 0;
+  twi_queue_refused = 0;
+  timing.count = 0;
+  timing.min_us = 0xFFFF;
+  timing.max_us = 0;
+  timing.total_us = 0;
+  for (uint8_t address = 0; address < 128; address++) {
+    boards[address].present = false;
+  }
+}
+
+void twi_queue_begin(uint32_t frequency) {
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  twi_frequency = frequency;
+}
+
+bool twi_queue_write(uint8_t address, const uint8_t * data, uint8_t length) {
+  if (length > TWI_QUEUE_MAX_LENGTH) {
+    return false;
+  }
+  if (used + length + 2 > TWI_QUEUE_SIZE) {
+    twi_queue_refused++;
+    return false;
+  }
+  TwiTransaction transaction;
+  transaction.address = address;
+  transaction.length = length;
+  memcpy(transaction.data, data, length);
+  queue.push_back(transaction);
+  used += length + 2;
+  if (!busy) {
+    start_next();
+  }
+  return true;
+}
+
+uint8_t twi_queue_free() {
+  uint16_t free_bytes = TWI_QUEUE_SIZE - used;
+  if (free_bytes < 2) {
+    return 0;
+  }
+  free_bytes -= 2;
+  return free_bytes > TWI_QUEUE_MAX_LENGTH ? TWI_QUEUE_MAX_LENGTH : (uint8_t) free_bytes;
+}
+
+bool twi_queue_idle() {
+  return !busy;
+}
+
+void twi_queue_take_timing(TwiQueueTiming * copy) {
+  *copy = timing;
+  timing.count = 0;
+  timing.min_us = 0xFFFF;
+  timing.max_us = 0;
+  timing.total_us = 0;
+}
+
+void twi_queue_flush() {
+  while (busy) {
+    sim_advance(finished_us - sim_now_us);
+  }
+}
+
+
+//----------   W I R E   ----------
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t slave) {
+  address = slave;
+  length = 0;
+  transmitting = true;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (!transmitting || length >= WIRE_BUFFER_LENGTH) {
+    return 0;
+  }
+  buffer[length++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t * data, size_t count) {
+  size_t written = 0;
+  while (written < count && write(data[written])) {
+    written++;
+  }
+  return written;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  (void) stop;
+  transmitting = false;
+  sim_advance(sim_i2c_time_us(length, frequency));  // Wire waits for the bus
+  if (board(address) == NULL) {
+    return 2;  // Address NACK
+  }
+  sim_i2c_write(address, buffer, length);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t slave, uint8_t count) {
+  if (count > WIRE_BUFFER_LENGTH) {
+    count = WIRE_BUFFER_LENGTH;
+  }
+  sim_advance(sim_i2c_time_us(count, frequency));
+  if (board(slave) == NULL) {
+    available_bytes = 0;
+    return 0;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    buffer[i] = sim_i2c_read(slave);
+  }
+  read_address = 0;
+  available_bytes = count;
+  return count;
+}
+
+int TwoWire::read() {
+  if (available_bytes == 0) {
+    return -1;
+  }
+  available_bytes--;
+  return buffer[read_address++];
+}
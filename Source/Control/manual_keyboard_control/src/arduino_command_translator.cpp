@@ -1,9 +1,22 @@
 #include "ros/ros.h"
 #include "std_msgs/String.h"
-#include <std_msgs/Int16.h>
-#include <std_msgs/Int16MultiArray.h>
 #include <std_msgs/UInt16MultiArray.h>
-#include <keyboard/Key.h>
+#include <std_msgs/UInt8MultiArray.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <manual_keyboard_control/RoverCommand.h>
+#include "arduino_command_translator.h"
+#include "pulse_tables.h"  // PWM, servo and motor constants
+#include "calibration.h"
+#include "serial_port.h"
+#include "latency_histogram.h"
+#include <RoverProtocol.h>    // Source/Arduino/libraries/RoverProtocol
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <atomic>
 #include <inttypes.h>
 #include <sstream>
 #include <stdio.h>
@@ -12,7 +25,9 @@
 /*----------    T E S T I N G   C O M M A N D S    ----------
 To test this code without running the "Mission Control" code:
   $ rosrun rosserial_python serial_node.py _port:/dev/<PORT NUMBER>
-  $ rostopic pub arm_cmd std_msgs/UInt16MultiArray '{data: [<I2C_INDEX>, <servo_1>, etc.]}' */
+  $ rostopic pub arm_cmd std_msgs/UInt16MultiArray '{data: [<I2C_INDEX>, <servo_1>, etc.]}'
+To test the translator without the keyboard (dirty_mask 1 = arm base only):
+  $ rostopic pub rover_cmd_manual manual_keyboard_control/RoverCommand '{dirty_mask: 1, channel: [45, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]}' */
 
 
 /*-----------------------------------------------------------------------------------
@@ -20,8 +35,8 @@ To test this code without running the "Mission Control" code:
 //-----------------------------------------------------------------------------------
 # Servo and DC Motor reference
 +---------+---------+---------+--------------------------+
-| \\  //  ‖ IN MSG  | OUT MSG | DESCRIPTION              |
-|   ||    ‖  ARRAY  |  ARRAY  |                          |
+| \\  //  ‖ COMMAND | OUT MSG | DESCRIPTION              |
+|   ||    ‖ CHANNEL |  ARRAY  |                          |
 | //  \\  ‖  INDEX  |  INDEX  |                          |
 +=========+=========+=========+==========================+
 |         ‖    0    |    0    | Arm Base                 |
@@ -29,98 +44,28 @@ To test this code without running the "Mission Control" code:
 | Servos  ‖    2    |    2    | Arm Elbow                |
 |         ‖    3    |    3    | Arm Wrist                |
 +---------+---------+---------+--------------------------+
-| Gripper ‖    4    |   12    | Gripper Rotate           |
-| Servos  ‖    5    |   13    | Gripper Claw             |
+|  Drive  ‖    4    |    4    | Rear Wheel               |
+| Servos  ‖    5    |    5    | Front Right Wheel        |
+|         ‖    6    |    6    | Front Left Wheel         |
 +---------+---------+---------+--------------------------+
-|  Drive  ‖    0    |    4    | Rear Wheel               |
-| Servos  ‖    1    |    5    | Front Right Wheel        |
-|         ‖    2    |    6    | Front Left Wheel         |
+|         ‖    7    |    7    | Rear Wheel               |
+|  Drive  ‖    8    |    8    | Side Right Wheels (BOTH) |
+|   DC    ‖    9    |    9    | Side Left Wheels (BOTH)  |
+| Motors  ‖   10    |   10    | Front Right Wheel        |
+|         ‖   11    |   11    | Front Left Wheels        |
 +---------+---------+---------+--------------------------+
-|         ‖    0    |    7    | Rear Wheel               |
-|  Drive  ‖    1    |    8    | Side Right Wheels (BOTH) |
-|   DC    ‖    2    |    9    | Side Left Wheels (BOTH)  |
-| Motors  ‖    3    |   10    | Front Right Wheel        |
-|         ‖    4    |   11    | Front Left Wheels        |
+| Gripper ‖   12    |   12    | Gripper Rotate           |
+| Servos  ‖   13    |   13    | Gripper Claw             |
 +---------+---------+---------+--------------------------+
-|  Mast   ‖    0    |   14    | Mast Stepper             |
+|  Mast   ‖   14    |   14    | Mast Stepper             |
 +---------+---------+---------+--------------------------+             */
 
 
-//-----------------------------------------------------------------------------------
-//------------------------------   C O N S T A N T S   ------------------------------
-//-----------------------------------------------------------------------------------
-//----------   P W M    C O N S T A N T S   ----------
-#define PWM_FREQUENCY     50
-#define PWM_RESOLUTION    4096
-
-//----------   A R M   S E R V O   C O N S T A N T S   ----------
-// # Hitec HS-785HB 
-#define ARM_PWM_MIN          126  // "-315 degrees", min pulse length count (out of 4096@50Hz)
-#define ARM_PWM_MAX          504  // "+315 degrees", max pulse length count (out of 4096@50Hz)
-#define ARM_PWM_NEUTRAL      315  // "0 degrees", center pulse length count (out of 4096@50Hz)
-#define ARM_PWM_360_DEGREES  216  // "360 degrees", one full rotation
-
-//----------   S T E E R I N G   S E R V O   C O N S T A N T S   ----------
-#define STEER_PWM_MIN          105
-#define STEER_PWM_MAX          495 
-#define STEER_PWM_NEUTRAL      295
-#define STEER_PWM_360_DEGREES  720
-//#define STEER_PWM_360_DEGREES  716 // <--- ACTUAL VALUE ???
-
-//----------   G R I P P E R   S E R V O   C O N S T A N T S   ----------
-// # Hitec HS-422 (gripper rotation servo)
-#define GRIPPER_ROTATE_PWM_MIN         105
-#define GRIPPER_ROTATE_PWM_MAX         495
-#define GRIPPER_ROTATE_PWM_NEUTRAL     295
-#define GRIPPER_ROTATE_PWM_360_DEGREES 720
-// # Hitec HS-322HD (gripper claw servo)
-#define GRIPPER_CLAW_CONSTANT    100.0
-#define GRIPPER_CLAW_PWM_CLOSED 276
-#define GRIPPER_CLAW_PWM_OPEN   355
-
-//----------   D C   M O T O R   C O N S T A N T S   ----------
-// # If the motor pwms are too close to neutral (4096/2 +- ~5%)
-//#define FORWARD_DEADZONE_CUTOFF_PWM  2248 // Max DC motor pwm
-//#define REVERSE_DEADZONE_CUTOFF_PWM  1848 // Min DC motor pwm
-#define MAX_FORWARD_SPEED_PWM  345  // avoid extremes (SHOULD BE 345)
-#define MAX_REVERSE_SPEED_PWM  248  // avoid extremes 
-#define NEUTRAL_SPEED_PWM      292 	// Stopped DC motor pwm
-
-//----------    M A S T   S E R V O   C O N S T A N T S   ----------
-// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-// !!!   NOTE THAT THE MAST SERVO IS CONTINUOUS ROTATION   !!!
-// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-#define MAST_SERVO_PWM_MAX 315
-#define MAST_SERVO_PWM_MIN 305
-#define MAST_SERVO_PWM_IMMOBILE 310
-
-
 //-----------------------------------------------------------------------------------
 //--------------   A R R A Y   &   M E S S A G E   C O S N T A N T S   --------------
 //-----------------------------------------------------------------------------------
-//----------    I N   M E S S A G E   I N D E C E S    ----------
-// Arm servos
-#define IN_MSG_INDEX_ARM_BASE       0
-#define IN_MSG_INDEX_ARM_SHOULDER   1
-#define IN_MSG_INDEX_ARM_ELBOW      2
-#define IN_MSG_INDEX_ARM_WRIST      3
-// Arm gripper
-#define IN_MSG_INDEX_GRIPPER_ROTATE 4
-#define IN_MSG_INDEX_GRIPPER_CLAW   5
-// Steering servos
-#define IN_MSG_INDEX_STEER_R        0
-#define IN_MSG_INDEX_STEER_F_R      1
-#define IN_MSG_INDEX_STEER_F_L      2
-// Drive motors
-#define IN_MSG_INDEX_DRIVE_R        0
-#define IN_MSG_INDEX_DRIVE_S_R      1
-#define IN_MSG_INDEX_DRIVE_S_L      2
-#define IN_MSG_INDEX_DRIVE_F_R      3
-#define IN_MSG_INDEX_DRIVE_F_L      4
-// Mast Stepper
-//#define IN_MSG_INDEX_MAST 0  // MIGHT NOT BE USED...
-
 //----------    O U T   M E S S A G E   I N D E C E S    ----------
+// # Same order as the channels of manual_keyboard_control/RoverCommand
 #define OUT_MSG_INDEX_ARM_BASE       0
 #define OUT_MSG_INDEX_ARM_SHOULDER   1
 #define OUT_MSG_INDEX_ARM_ELBOW      2
@@ -136,257 +81,1125 @@ To test this code without running the "Mission Control" code:
 #define OUT_MSG_INDEX_GRIPPER_ROTATE 12
 #define OUT_MSG_INDEX_GRIPPER_CLAW   13
 #define OUT_MSG_MSG_INDEX_MAST       14
+#define OUT_MSG_CHANNEL_COUNT        15
+
+//----------    D E L T A   F R A M E S    ----------
+/* arduino_cmd carries three kinds of frame:
+  - Keyframe:    the 15 pulses above, in order (every pulse is < 4096)
+  - Delta frame: a tag word (DELTA_FRAME_TAG | <number of changes>) followed by
+                 one word per changed channel: (<out index> << 12) | <pulse>
+  - Move frame:  a tag word (MOVE_FRAME_TAG | <number of moves>) followed by
+                 MOVE_WORDS words per move (see SERVO MOVES)
+  Keyframes and delta frames end with one more word, the frame's sequence
+  number, which the arduino echoes back on arduino_echo (see LATENCY TRACING).
+  A keyframe is sent every keyframe_interval frames or keyframe_period seconds
+  (whichever comes first) so the arduino resyncs after a lost frame.  While
+  no commands arrive, keyframe_timer sends one once keyframe_period seconds are
+  up (checked twice a period, see send_idle_keyframe()).
+  Must match arduino_manual_keyboard_control.ino  */
+#define DELTA_FRAME_TAG       0xF000
+#define DELTA_FRAME_TAG_MASK  0xF000
+#define DELTA_CHANNEL_SHIFT   12
+#define DELTA_PULSE_MASK      0x0FFF
+#define MOVE_FRAME_TAG        0xE000
+
+//----------    M O T O R   P R O F I L E S    ----------
+/* How the arduino ramps the DC motors to their targets, sent on
+  arduino_motor_profile (or as a ROVER_FRAME_MOTOR_PROFILE frame) at startup
+  and every motor_profile_period seconds:
+    <motor mask>, <profile>, <acceleration (counts/s)>, <jerk (counts/s^2)>,
+    <emergency deceleration (counts/s)>
+  The arduino ramps each motor in fixed point: trapezoidal moves the pulse
+  at most the acceleration, S-curve also ramps the acceleration up and down
+  by the jerk.  Stops (a neutral target) use the emergency deceleration.
+  Must match arduino_manual_keyboard_control.ino  */
+#define PROFILE_WORD_MOTORS        0
+#define PROFILE_WORD_PROFILE       1
+#define PROFILE_WORD_ACCELERATION  2
+#define PROFILE_WORD_JERK          3
+#define PROFILE_WORD_EMERGENCY     4
+#define PROFILE_WORDS              5
+#define PROFILE_ALL_MOTORS         0x1F
+#define PROFILE_TRAPEZOIDAL        0
+#define PROFILE_S_CURVE            1
+
+//----------    S E R V O   M O V E S    ----------
+/* A RoverCommand channel with a move_ms goes to the arduino as a move instead
+  of a pulse, in a move frame on arduino_cmd (or in ROVER_FRAME_SERVO_MOVE
+  frames), a pair of words per channel:
+    (<out index> << 12) | <target pulse>, <duration (ms)>
+  The arduino steps the servo to the target over the duration itself (at the
+  50 Hz PWM frame rate), so a slow sweep is one message.  The target then
+  counts as sent: keyframes repeat it, which does not stop the move.  The
+  moves go out on the same topic (or serial port) just before the frame, so
+  the arduino always starts a move before a keyframe repeats its target.
+  Only the servos (MOVE_CHANNELS) move; the drive motors have their own ramp.
+  Must match arduino_manual_keyboard_control.ino  */
+#define MOVE_WORDS     2
+#define MOVE_CHANNELS  (((1 << (OUT_MSG_INDEX_STEER_F_L + 1)) - 1) | (1 << OUT_MSG_INDEX_GRIPPER_ROTATE) \
+                        | (1 << OUT_MSG_INDEX_GRIPPER_CLAW))
+
+//----------    C O M M A N D   G R O U P S    ----------
+/* Channels that are always handed to the output thread together (see COMMAND SLOTS)
+  so, e.g., the left and right drive motors never go out from different commands */
+#define GROUP_ARM      0
+#define GROUP_STEER    1
+#define GROUP_DRIVE    2
+#define GROUP_GRIPPER  3
+#define GROUP_MAST     4
+#define GROUP_COUNT    5
+#define ALL_GROUPS     ((1 << GROUP_COUNT) - 1)
+
+const struct {
+  int first;  // Out index of the first channel
+  int count;
+} COMMAND_GROUPS[GROUP_COUNT] = {
+  { OUT_MSG_INDEX_ARM_BASE,       4 },  // GROUP_ARM
+  { OUT_MSG_INDEX_STEER_R,        3 },  // GROUP_STEER
+  { OUT_MSG_INDEX_DRIVE_R,        5 },  // GROUP_DRIVE
+  { OUT_MSG_INDEX_GRIPPER_ROTATE, 2 },  // GROUP_GRIPPER
+  { OUT_MSG_MSG_INDEX_MAST,       1 },  // GROUP_MAST
+};
+
+//----------    F I R M W A R E   T E L E M E T R Y    ----------
+/* The arduino reports its own statistics (loop period, command apply time,
+  I2C transaction time, frame and error counts, free RAM, task timing) as a
+  packed RoverTelemetry report every second or so: the bytes of an
+  arduino_telemetry message, or ROVER_TELEMETRY_PAGES telemetry frames on
+  the binary transport (see RoverProtocol.h).  The last report is put on
+  /diagnostics with the latency; a report older than TELEMETRY_STALE_PERIODS
+  of its own periods is a warning. */
+#define TELEMETRY_STALE_PERIODS  3
+const char * const TASK_NAMES[ROVER_TELEMETRY_TASKS] = { "serial task", "motor task", "telemetry task" };
+
+//----------    L A T E N C Y   T R A C I N G    ----------
+/* Every RoverCommand carries a trace id and the stamps of the key event that
+  caused it (see RoverCommand.msg).  The translator stamps when it receives a
+  command and when its frame goes to the arduino, and remembers the frame by
+  its sequence number.  The arduino echoes that number back (with the time it
+  took to write the PWM registers) on arduino_echo, or as a ROVER_FRAME_ECHO
+  frame on the binary transport.  Each stage goes into its own histogram,
+  reported on /diagnostics every diagnostics_period seconds.
+  Commands merged into a later frame (coalescing) are not traced, and the
+  arduino's clock is never compared with ours: it only reports a duration. */
+#define STAGE_KEYBOARD       0  // keyboard::Key stamp -> received by manual_keyboard_control
+#define STAGE_TELEOP         1  // received -> RoverCommand published
+#define STAGE_TO_TRANSLATOR  2  // published -> received by the translator
+#define STAGE_TRANSLATOR     3  // received -> frame sent to the arduino
+#define STAGE_LINK           4  // sent -> echo received, less the arduino's time
+#define STAGE_FIRMWARE       5  // frame received by the arduino -> PWM registers written
+#define STAGE_TOTAL          6  // key stamp (teleop step for held keys) -> echo received
+#define STAGE_COUNT          7
+
+const char * STAGE_NAMES[STAGE_COUNT] = {
+  "keyboard", "teleop", "to translator", "translator", "serial link", "firmware", "total"
+};
+
+// Words of the trace slot
+#define TRACE_ID       0  // trace_id + 1 (0 = no command yet)
+#define TRACE_KEY      1  // Stamps, in ns
+#define TRACE_INPUT    2
+#define TRACE_PUBLISH  3
+#define TRACE_RECEIVE  4
+#define TRACE_WORDS    5
+
+#define ECHO_PENDING   256  // Frames waiting for their echo (one per sequence number)
 
 
 //-----------------------------------------------------------------------------------
 //----------   R O S   S U S C R I B E R S   A N D   P U B L I S H E R S   ----------
 //-----------------------------------------------------------------------------------
-// ROS Subscribers
-ros::Subscriber * sub_arm_cmd_manual;
-ros::Subscriber * sub_steer_cmd_manual;
-ros::Subscriber * sub_drive_cmd_manual;
-ros::Subscriber * sub_mast_cmd_manual;
+// ROS Subscriber
+ros::Subscriber * sub_rover_cmd_manual;
 
 // ROS publisher
 ros::Publisher * pub_arduino_cmd;
+ros::Publisher * pub_arduino_motor_profile;
+ArduinoCmdSink arduino_cmd_sink = NULL;  // Replaces pub_arduino_cmd when run offline
 
 
 //-----------------------------------------------------------------------------------
 //-----------   M O T O R   A N D   S E R V O   V A R I A B L E S   -----------------
 //-----------------------------------------------------------------------------------
-// Command publisher array
+//----------    C O M M A N D   S L O T S    ----------
+/* Commands are received on a spinner thread and sent by one output thread.
+  rover_cmd_manual is one subscription, so roscpp hands it one message at a
+  time whatever the number of threads; more threads only keep the echo,
+  telemetry and timer callbacks from waiting behind it.  Each group has a latest-value slot, a seqlock written only by
+  rover_cmd_manual_callback (roscpp never runs one subscription's callbacks
+  at the same time) and read by the output thread, which retries if the slot
+  was written meanwhile.  Neither side ever waits on the other, so a command
+  is never queued behind a slow write to the arduino: the output thread just
+  sends the newest value of each group when it gets to it. */
+std::atomic<uint32_t> slot_seq[GROUP_COUNT];                  // Odd while the slot is written
+std::atomic<int16_t> slot_value[OUT_MSG_CHANNEL_COUNT];       // Latest value of each channel
+std::atomic<uint16_t> slot_move_ms[OUT_MSG_CHANNEL_COUNT];    // And its move duration (see SERVO MOVES)
+std::atomic<uint32_t> pending_groups(0);                      // Groups written since the output thread last read them
+boost::mutex output_mutex;                                    // Only guards the wakeup
+boost::condition_variable output_wakeup;
+boost::thread * output_thread;
+std::atomic<uint32_t> trace_seq(0);                           // Seqlock of the newest command's trace
+std::atomic<uint64_t> trace_value[TRACE_WORDS];
+
+// Command publisher array (output thread only from here down)
 std_msgs::UInt16MultiArray command_message_array;
-bool UPDATE_NEEDED = false;
+double coalesce_window = 0;     // Seconds to batch commands for (0 = publish every command right away)
+
+// Delta frames
+bool delta_frames = true;                         // Send delta frames (false = keyframes only)
+int keyframe_interval = 20;                       // Most delta frames between keyframes
+double keyframe_period = 1.0;                     // Most seconds between keyframes
+int frames_since_keyframe = 0;
+ros::Time last_keyframe_time;                     // Zero until the first keyframe
+std::atomic<bool> keyframe_pending(false);        // keyframe_timer fired (see send_idle_keyframe())
+ros::WallTimer * keyframe_timer;
+uint16_t last_sent_pulse[OUT_MSG_CHANNEL_COUNT];  // Pulses the arduino has been sent
+
+// Calibration
+boost::shared_ptr<const CalibratedTables> calibrated_tables;  // Swapped atomically on reload
+std::string calibration_file;                                 // Empty = pulse_tables.h defaults
+ros::WallTimer * calibration_timer;
+struct timespec calibration_mtime;                            // Of the loaded file
+off_t calibration_size;
+int16_t command_values[OUT_MSG_CHANNEL_COUNT];                // Last snapshot of the slots (re-converted on reload)
+uint16_t command_move_ms[OUT_MSG_CHANNEL_COUNT];              // Move durations of that snapshot
+
+// Transport to the arduino
+bool BINARY_TRANSPORT = false;  // true = RoverProtocol frames straight to the tty, false = arduino_cmd over rosserial
+int serial_fd = -1;             // Open tty (binary transport only)
+uint8_t frame_seq = 0;          // Sequence number of the next frame (either transport)
+boost::thread * echo_thread;    // Reads echo frames (binary transport only)
+
+// Motor profile (see MOTOR PROFILES)
+uint16_t motor_profile[PROFILE_WORDS];
+std::atomic<bool> motor_profile_pending(false);  // The output thread writes the frame (binary transport)
+ros::WallTimer * motor_profile_timer;
+
+// Latency tracing (guarded by trace_mutex, see LATENCY TRACING)
+struct PendingEcho {
+  bool valid;
+  uint64_t trace[TRACE_WORDS];
+  uint64_t send;                // When the frame was sent (ns)
+};
+boost::mutex trace_mutex;
+PendingEcho pending_echo[ECHO_PENDING];         // Indexed by sequence number
+LatencyHistogram stage_latency[STAGE_COUNT];
+uint32_t lost_echoes = 0;                       // Frames whose echo never came
+uint32_t traced_commands = 0;
+uint64_t last_traced_id = 0;                    // TRACE_ID of the last command traced (output thread only)
+ros::Publisher * pub_diagnostics;
+ros::Subscriber * sub_arduino_echo;
+ros::WallTimer * diagnostics_timer;
+double latency_window = 10.0;                   // Seconds between histogram resets (0 = never)
+ros::WallTime latency_window_start;
+
+// Firmware telemetry (guarded by telemetry_mutex, see FIRMWARE TELEMETRY)
+boost::mutex telemetry_mutex;
+RoverTelemetry firmware_telemetry;              // Last report
+ros::WallTime firmware_telemetry_time;          // When it came (zero until the first)
+uint32_t firmware_telemetry_reports = 0;
+ros::Subscriber * sub_arduino_telemetry;
 
 
 //-----------------------------------------------------------------------------------
 //--------------------   C O D E   B E G I N S   H E R E   --------------------------
 //-----------------------------------------------------------------------------------
 
-//----------  T R A N S L A T O R S  ---------
-
-/***** Converting angles to PWM pulses
-  These functions convert a servo angles (in degrees) into a PWM pulses
-  Both arm_angle_to_pulse() and steer_angle_to_pulse() simply call angle_to_pulse()
-    with the appropriate values
-
-  Here's some math:
-    PWM_pulse = <neurtal_pwm> + (angle/360) * <full_turn_pwm>     
-*/
-uint16_t angle_to_pulse(int int_angle, int servo_neutral, int servo_full_turn, int servo_min, int servo_max) {
-  // Typecast angle to double to prevent overflow
-  double angle = int_angle * 1.0;
-  uint16_t pulse = (uint16_t) (servo_neutral + (((long)angle*(long)servo_full_turn)/360));
-  // Check if within range
-  if (pulse < servo_min) { 
-    pulse = (uint16_t) servo_min; 
-  } else if (pulse > servo_max) {
-    pulse = (uint16_t) servo_max;
-  }
-  return pulse;
-}
-uint16_t arm_angle_to_pulse(int int_angle) {
-  return angle_to_pulse(int_angle, ARM_PWM_NEUTRAL, 
-    ARM_PWM_360_DEGREES, ARM_PWM_MIN, ARM_PWM_MAX);
-}
-uint16_t steer_angle_to_pulse(int int_angle) {
-  return angle_to_pulse(int_angle, STEER_PWM_NEUTRAL, 
-    STEER_PWM_360_DEGREES, STEER_PWM_MIN, STEER_PWM_MAX);
-}
-uint16_t gripper_angle_to_pulse(int int_angle) {
-  return angle_to_pulse(int_angle, 
-    GRIPPER_ROTATE_PWM_NEUTRAL, GRIPPER_ROTATE_PWM_360_DEGREES, 
-    GRIPPER_ROTATE_PWM_MIN, GRIPPER_ROTATE_PWM_MAX);
-}
-uint16_t gripper_claw_to_pulse(int int_claw) {
-
-  return GRIPPER_CLAW_PWM_OPEN - (
-        (int_claw*1.0)/GRIPPER_CLAW_CONSTANT) * 
-        (GRIPPER_CLAW_PWM_OPEN - GRIPPER_CLAW_PWM_CLOSED);
-}
-
-/***** drive_speed_to_pulse() ###
-  Converts a drive speed to a PWM pulse,
-    checking if this pulse is within range
-    and is not too close to "NEUTRAL_SPEED_PWM"
-
-  !!! THIS FUNCTION SHOULD NEVER RETURN ANY VALUE 
-  !!! WITHIN THE MIN FORWARD/BACKWARD PWMs
-  !!! OTHER THAN "neutral" (ie NEUTRAL_SPEED_PWM )
-*/
-uint16_t drive_speed_to_pulse(int int_speed) {
-  // Typecast angle to double to prevent overflow
-  double speed = int_speed * 1.0;
-  uint16_t pulse;
-  if (int_speed < 0) {
-    speed = NEUTRAL_SPEED_PWM + (speed / 2000) * (NEUTRAL_SPEED_PWM - MAX_REVERSE_SPEED_PWM);
-  } else if (int_speed > 0) {
-    speed = NEUTRAL_SPEED_PWM + (speed / 2000) * (MAX_FORWARD_SPEED_PWM - NEUTRAL_SPEED_PWM);      
+void trace_expect_echo(const uint64_t * trace, uint8_t seq, uint64_t send);
+void trace_sent(const uint64_t * trace, uint8_t seq, uint64_t send, bool sent);
+
+//----------  S U B S C R I B E R S / P U B L I S H E R S  ---------
+
+/***** write_binary_frame() ###
+  Writes the command array to the arduino's tty as one RoverProtocol frame
+  @INPUT changed_mask - channels that changed (ROVER_KEYFRAME_MASK for a keyframe)
+*/
+void write_binary_frame(uint16_t changed_mask) {
+  if (serial_fd < 0) {
+    return;  // Reported when the port failed to open
+  }
+
+  RoverFrame frame;
+  uint8_t buffer[ROVER_FRAME_SIZE];
+
+  frame.seq = frame_seq++;
+  frame.type = ROVER_FRAME_COMMAND;
+  frame.mask = changed_mask;
+  for (int channel = 0; channel < OUT_MSG_CHANNEL_COUNT; channel++) {
+    frame.pulse[channel] = command_message_array.data[channel];
+  }
+  uint8_t length = rover_encode_frame(buffer, &frame);
+  if (!write_serial_port(serial_fd, buffer, length)) {
+    ROS_ERROR("Could not write to the arduino: %s", strerror(errno));
+  }
+}
+
+/***** publish_arduino_cmd() ###
+  Publishes a frame on arduino_cmd (or hands it to the offline sink)
+*/
+void publish_arduino_cmd(const std_msgs::UInt16MultiArrayPtr& message) {
+  if (arduino_cmd_sink != NULL) {
+    arduino_cmd_sink(message);
   } else {
-    speed = NEUTRAL_SPEED_PWM;
+    pub_arduino_cmd->publish(message);
   }
-  pulse = (uint16_t) speed;
-  return pulse;
 }
 
+/***** publish_delta_frame() ###
+  Publishes the changed pulses on arduino_cmd (see DELTA FRAMES)
+  @INPUT changed_mask - channels that changed
+  @INPUT changes - number of channels that changed
+*/
+void publish_delta_frame(uint16_t changed_mask, int changes) {
+  std_msgs::UInt16MultiArrayPtr message(new std_msgs::UInt16MultiArray());
+  message->data.reserve(changes + 2);
+  message->data.push_back(DELTA_FRAME_TAG | changes);
+  for (int channel = 0; channel < OUT_MSG_CHANNEL_COUNT; channel++) {
+    if (changed_mask & (1 << channel)) {
+      message->data.push_back((channel << DELTA_CHANNEL_SHIFT) | (command_message_array.data[channel] & DELTA_PULSE_MASK));
+    }
+  }
+  message->data.push_back(frame_seq++);
+  publish_arduino_cmd(message);
+}
 
-//----------  S U B S C R I B E R S / P U B L I S H E R S  ---------
+/***** publish_keyframe() ###
+  Publishes every pulse on arduino_cmd
+*/
+void publish_keyframe() {
+  std_msgs::UInt16MultiArrayPtr message(new std_msgs::UInt16MultiArray());
+  message->data.reserve(OUT_MSG_CHANNEL_COUNT + 1);
+  message->data.assign(command_message_array.data.begin(), command_message_array.data.end());
+  message->data.push_back(frame_seq++);
+  publish_arduino_cmd(message);
+}
+
+/***** send_servo_moves() ###
+  Sends servo moves (see SERVO MOVES): published as a move frame on
+    arduino_cmd, or written as frames of up to ROVER_MOVES_PER_FRAME moves
+    (output thread)
+  @INPUT words - MOVE_WORDS words per move
+  @INPUT length - number of words
+*/
+void send_servo_moves(const uint16_t * words, int length) {
+  if (!BINARY_TRANSPORT) {
+    std_msgs::UInt16MultiArrayPtr message(new std_msgs::UInt16MultiArray());
+    message->data.reserve(length + 1);
+    message->data.push_back(MOVE_FRAME_TAG | (length / MOVE_WORDS));
+    message->data.insert(message->data.end(), words, words + length);
+    publish_arduino_cmd(message);
+    return;
+  }
+  if (serial_fd < 0) {
+    return;
+  }
+
+  RoverFrame frame;
+  uint8_t buffer[ROVER_FRAME_SIZE];
+  for (int first = 0; first < length; first += ROVER_MOVES_PER_FRAME * MOVE_WORDS) {
+    memset(&frame, 0, sizeof(frame));
+    frame.type = ROVER_FRAME_SERVO_MOVE;
+    frame.mask = (uint16_t) std::min(length - first, ROVER_MOVES_PER_FRAME * MOVE_WORDS);
+    memcpy(frame.pulse, words + first, frame.mask * sizeof(uint16_t));
+    uint8_t frame_length = rover_encode_frame(buffer, &frame);
+    if (!write_serial_port(serial_fd, buffer, frame_length)) {
+      ROS_ERROR("Could not write to the arduino: %s", strerror(errno));
+    }
+  }
+}
+
+/***** send_changed_moves() ###
+  Sends the changed servo channels that have a move duration as moves, and
+    marks them sent (see SERVO MOVES)
+*/
+void send_changed_moves() {
+  uint16_t words[OUT_MSG_CHANNEL_COUNT * MOVE_WORDS];
+  int length = 0;
+  for (int channel = 0; channel < OUT_MSG_CHANNEL_COUNT; channel++) {
+    uint16_t pulse = command_message_array.data[channel];
+    if ((MOVE_CHANNELS & (1 << channel)) && command_move_ms[channel] > 0 && pulse != last_sent_pulse[channel]) {
+      words[length++] = (channel << DELTA_CHANNEL_SHIFT) | (pulse & DELTA_PULSE_MASK);
+      words[length++] = command_move_ms[channel];
+      last_sent_pulse[channel] = pulse;
+    }
+  }
+  if (length > 0) {
+    send_servo_moves(words, length);
+  }
+}
+
+/***** publish_command() ###
+  Sends the command array to the arduino, as a delta frame with the pulses
+    that changed since the last frame or as a keyframe (see DELTA FRAMES),
+    over rosserial (arduino_cmd) or the binary transport.  Changed servo
+    channels with a move duration go out before it as moves instead (see
+    SERVO MOVES).
+  rosserial frames are built in a new message and published by pointer,
+    so they can be handed to a nodelet in the same manager without
+    being serialized.
+  @RETURN true if a frame was sent (its sequence number is frame_seq - 1)
+*/
+bool publish_command() {
+  ros::Time now = ros::Time::now();
+  send_changed_moves();
+
+  // Find the changed pulses
+  uint16_t changed_mask = 0;
+  int changes = 0;
+  for (int channel = 0; channel < OUT_MSG_CHANNEL_COUNT; channel++) {
+    if (command_message_array.data[channel] != last_sent_pulse[channel]) {
+      changed_mask |= 1 << channel;
+      changes++;
+    }
+  }
+
+  bool keyframe = !delta_frames
+               || last_keyframe_time.isZero()
+               || frames_since_keyframe >= keyframe_interval
+               || (now - last_keyframe_time).toSec() >= keyframe_period
+               || changes + 1 >= OUT_MSG_CHANNEL_COUNT;  // A delta frame would not be smaller
+
+  if (keyframe) {
+    frames_since_keyframe = 0;
+    last_keyframe_time = now;
+  } else if (changes == 0) {
+    return false;
+  } else {
+    frames_since_keyframe++;
+  }
+
+  if (BINARY_TRANSPORT) {
+    write_binary_frame(keyframe ? ROVER_KEYFRAME_MASK : changed_mask);
+  } else if (keyframe) {
+    publish_keyframe();
+  } else {
+    publish_delta_frame(changed_mask, changes);
+  }
+
+  for (int channel = 0; channel < OUT_MSG_CHANNEL_COUNT; channel++) {
+    last_sent_pulse[channel] = command_message_array.data[channel];
+  }
+  return true;
+}
+
+/***** send_motor_profile() ###
+  Sends the motor profile: published on arduino_motor_profile, or written
+    as a frame by the output thread (the only writer of the tty)
+*/
+void send_motor_profile() {
+  if (BINARY_TRANSPORT) {
+    motor_profile_pending.store(true);
+    boost::lock_guard<boost::mutex> lock(output_mutex);
+    output_wakeup.notify_one();
+    return;
+  }
+  std_msgs::UInt16MultiArrayPtr message(new std_msgs::UInt16MultiArray());
+  message->data.assign(motor_profile, motor_profile + PROFILE_WORDS);
+  pub_arduino_motor_profile->publish(message);
+}
+
+/***** write_motor_profile_frame() ###
+  Writes the motor profile to the arduino's tty (output thread)
+*/
+void write_motor_profile_frame() {
+  if (serial_fd < 0) {
+    return;
+  }
+
+  RoverFrame frame;
+  uint8_t buffer[ROVER_FRAME_SIZE];
+
+  memset(&frame, 0, sizeof(frame));
+  frame.type = ROVER_FRAME_MOTOR_PROFILE;
+  memcpy(frame.pulse, motor_profile, sizeof(motor_profile));
+  uint8_t length = rover_encode_frame(buffer, &frame);
+  if (!write_serial_port(serial_fd, buffer, length)) {
+    ROS_ERROR("Could not write to the arduino: %s", strerror(errno));
+  }
+}
+
+void motor_profile_timer_callback(const ros::WallTimerEvent&) {
+  send_motor_profile();
+}
+
+/***** send_idle_keyframe() ###
+  Sends a keyframe if none has gone out for keyframe_period seconds, so an
+    arduino that lost a frame resyncs while no commands arrive (output thread)
+*/
+void send_idle_keyframe() {
+  if (last_keyframe_time.isZero() || (ros::Time::now() - last_keyframe_time).toSec() < keyframe_period) {
+    return;  // Nothing sent yet, or a keyframe went out with a command
+  }
+  publish_command();  // A keyframe, the period being up
+}
+
+void keyframe_timer_callback(const ros::WallTimerEvent&) {
+  keyframe_pending.store(true);
+  boost::lock_guard<boost::mutex> lock(output_mutex);
+  output_wakeup.notify_one();
+}
+
+//----------  C O M M A N D   S L O T S  ---------
+
+/***** write_slot() ###
+  Stores a command's values for one group (single writer, see COMMAND SLOTS)
+  @INPUT group - GROUP_*
+  @INPUT channel - values of every channel
+  @INPUT move_ms - move duration of every channel
+*/
+void write_slot(int group, const int16_t * channel, const uint16_t * move_ms) {
+  uint32_t seq = slot_seq[group].load(std::memory_order_relaxed);
+  slot_seq[group].store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int i = COMMAND_GROUPS[group].first; i < COMMAND_GROUPS[group].first + COMMAND_GROUPS[group].count; i++) {
+    slot_value[i].store(channel[i], std::memory_order_relaxed);
+    slot_move_ms[i].store(move_ms[i], std::memory_order_relaxed);
+  }
+  slot_seq[group].store(seq + 2, std::memory_order_release);
+}
+
+/***** read_slot() ###
+  Copies the latest values of one group, all from the same command
+  @INPUT group - GROUP_*
+  @INPUT channel - filled in for the group's channels
+  @INPUT move_ms - and their move durations
+*/
+void read_slot(int group, int16_t * channel, uint16_t * move_ms) {
+  uint32_t before, after;
+  do {
+    before = slot_seq[group].load(std::memory_order_acquire);
+    for (int i = COMMAND_GROUPS[group].first; i < COMMAND_GROUPS[group].first + COMMAND_GROUPS[group].count; i++) {
+      channel[i] = slot_value[i].load(std::memory_order_relaxed);
+      move_ms[i] = slot_move_ms[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = slot_seq[group].load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+/***** write_trace() ###
+  Stores the trace of the newest command (single writer, like the slots)
+  @INPUT receive - when the command was received (ns)
+*/
+void write_trace(const manual_keyboard_control::RoverCommand::ConstPtr& cmd_msg, uint64_t receive) {
+  uint32_t seq = trace_seq.load(std::memory_order_relaxed);
+  trace_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  trace_value[TRACE_ID].store((uint64_t) cmd_msg->trace_id + 1, std::memory_order_relaxed);
+  trace_value[TRACE_KEY].store(cmd_msg->key_stamp.toNSec(), std::memory_order_relaxed);
+  trace_value[TRACE_INPUT].store(cmd_msg->input_stamp.toNSec(), std::memory_order_relaxed);
+  trace_value[TRACE_PUBLISH].store(cmd_msg->header.stamp.toNSec(), std::memory_order_relaxed);
+  trace_value[TRACE_RECEIVE].store(receive, std::memory_order_relaxed);
+  trace_seq.store(seq + 2, std::memory_order_release);
+}
+
+/***** read_trace() ###
+  Copies the trace of the newest command
+  @INPUT trace - TRACE_WORDS words
+*/
+void read_trace(uint64_t * trace) {
+  uint32_t before, after;
+  do {
+    before = trace_seq.load(std::memory_order_acquire);
+    for (int i = 0; i < TRACE_WORDS; i++) {
+      trace[i] = trace_value[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = trace_seq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+/***** wake_output_thread() ###
+  Marks groups as written and wakes the output thread
+  @INPUT groups - bit per GROUP_*
+*/
+void wake_output_thread(uint32_t groups) {
+  pending_groups.fetch_or(groups);
+  // Taking the lock (it is only held while the output thread checks
+  // pending_groups) makes sure the wakeup is not missed
+  { boost::lock_guard<boost::mutex> lock(output_mutex); }
+  output_wakeup.notify_one();
+}
+
+/***** rover_cmd_manual_callback() ###
+  Stores a command in the slots of the groups it changes.  Translating
+    and sending it is left to the output thread.
+*/
+void rover_cmd_manual_callback(const manual_keyboard_control::RoverCommand::ConstPtr& cmd_msg) {
+  uint64_t receive = ros::Time::now().toNSec();
+  uint32_t dirty_mask = cmd_msg->dirty_mask;
+  uint32_t groups = 0;
+
+  for (int group = 0; group < GROUP_COUNT; group++) {
+    uint32_t group_mask = ((1 << COMMAND_GROUPS[group].count) - 1) << COMMAND_GROUPS[group].first;
+    if (dirty_mask & group_mask) {
+      write_slot(group, &cmd_msg->channel[0], &cmd_msg->move_ms[0]);
+      groups |= 1 << group;
+    }
+  }
+
+  if (groups != 0) {
+    write_trace(cmd_msg, receive);
+    wake_output_thread(groups);
+  }
+}
+
+/***** translate_pending_commands() ###
+  Translates the latest values of the written slots into PWM pulses and
+    sends them.
+  Converting all the channels with the calibrated lookup tables (see
+    calibration.h) is cheaper than only converting the groups that changed.
+*/
+void translate_pending_commands() {
+  uint32_t groups = pending_groups.exchange(0);
+  if (groups == 0) {
+    return;
+  }
+  for (int group = 0; group < GROUP_COUNT; group++) {
+    if (groups & (1 << group)) {
+      read_slot(group, command_values, command_move_ms);
+    }
+  }
+
+  // Holds on to the tables even if they are reloaded meanwhile
+  boost::shared_ptr<const CalibratedTables> tables = boost::atomic_load(&calibrated_tables);
+  convert_channels(tables->channel, command_values, &command_message_array.data[0]);
+  uint64_t trace[TRACE_WORDS];
+  read_trace(trace);
+  // Not re-traced when a calibration reload re-sends the same command.
+  // The echo is expected before the frame goes out: it can come back (on
+  // another thread) before publish_command() returns.
+  bool traced = trace[TRACE_ID] != last_traced_id;
+  uint8_t seq = frame_seq;
+  if (traced) {
+    trace_expect_echo(trace, seq, ros::Time::now().toNSec());
+  }
+  bool sent = publish_command();
+  if (traced) {
+    if (sent) {
+      last_traced_id = trace[TRACE_ID];
+    }
+    trace_sent(trace, seq, ros::Time::now().toNSec(), sent);
+  }
+}
+
+/***** output_thread_main() ###
+  Waits for written slots, then translates and sends them.
+*/
+void output_thread_main() {
+  while (ros::ok()) {
+    bool commands;
+    {
+      boost::unique_lock<boost::mutex> lock(output_mutex);
+      while (pending_groups.load() == 0 && !motor_profile_pending.load() && !keyframe_pending.load() && ros::ok()) {
+        output_wakeup.timed_wait(lock, boost::posix_time::milliseconds(100));  // Checks ros::ok() for shutdown
+      }
+      commands = pending_groups.load() != 0;
+    }
+    if (motor_profile_pending.exchange(false)) {
+      write_motor_profile_frame();
+    }
+    if (keyframe_pending.exchange(false)) {
+      send_idle_keyframe();
+    }
+    if (commands && coalesce_window > 0) {
+      // Batch whatever else arrives within the window (not after a timer's
+      // wakeup, which would hold the next command back by the whole window)
+      ros::Duration(coalesce_window).sleep();
+    }
+    translate_pending_commands();
+  }
+}
+
+//----------  L A T E N C Y   T R A C I N G  ---------
+
+/***** trace_expect_echo() ###
+  Waits for the echo of the frame a command is about to be sent in
+  @INPUT trace - TRACE_WORDS words
+  @INPUT seq - sequence number the frame will have
+  @INPUT send - when the frame is being sent (ns)
+*/
+void trace_expect_echo(const uint64_t * trace, uint8_t seq, uint64_t send) {
+  boost::lock_guard<boost::mutex> lock(trace_mutex);
+  PendingEcho& pending = pending_echo[seq];
+  if (pending.valid) {
+    lost_echoes++;  // Overwritten after 256 frames
+  }
+  pending.valid = true;
+  memcpy(pending.trace, trace, sizeof(pending.trace));
+  pending.send = send;
+}
+
+/***** trace_sent() ###
+  Records the host side stages of a command once its frame is out
+  @INPUT trace - TRACE_WORDS words
+  @INPUT seq - sequence number of the frame
+  @INPUT send - when the frame was sent (ns)
+  @INPUT sent - false if publish_command() had nothing to send
+*/
+void trace_sent(const uint64_t * trace, uint8_t seq, uint64_t send, bool sent) {
+  boost::lock_guard<boost::mutex> lock(trace_mutex);
+  PendingEcho& pending = pending_echo[seq];
+  if (!sent) {
+    pending.valid = false;  // No frame, no echo
+    return;
+  }
+  if (pending.valid) {
+    pending.send = send;  // Unless the echo is already in
+  }
+
+  if (trace[TRACE_KEY] != 0) {
+    latency_record(stage_latency[STAGE_KEYBOARD], ((int64_t) (trace[TRACE_INPUT] - trace[TRACE_KEY])) / 1000);
+  }
+  latency_record(stage_latency[STAGE_TELEOP], ((int64_t) (trace[TRACE_PUBLISH] - trace[TRACE_INPUT])) / 1000);
+  latency_record(stage_latency[STAGE_TO_TRANSLATOR], ((int64_t) (trace[TRACE_RECEIVE] - trace[TRACE_PUBLISH])) / 1000);
+  latency_record(stage_latency[STAGE_TRANSLATOR], ((int64_t) (send - trace[TRACE_RECEIVE])) / 1000);
+  traced_commands++;
+}
+
+/***** trace_echo() ###
+  Records the arduino side stages of a command when its echo arrives
+  @INPUT seq - sequence number of the frame
+  @INPUT apply_us - time the arduino took to apply it
+*/
+void trace_echo(uint8_t seq, uint16_t apply_us) {
+  uint64_t now = ros::Time::now().toNSec();
+  boost::lock_guard<boost::mutex> lock(trace_mutex);
+  PendingEcho& pending = pending_echo[seq];
+  if (!pending.valid) {
+    return;  // Not traced (or a duplicate)
+  }
+  pending.valid = false;
+
+  uint64_t origin = pending.trace[TRACE_KEY] != 0 ? pending.trace[TRACE_KEY] : pending.trace[TRACE_INPUT];
+  latency_record(stage_latency[STAGE_LINK], ((int64_t) (now - pending.send)) / 1000 - apply_us);
+  latency_record(stage_latency[STAGE_FIRMWARE], apply_us);
+  latency_record(stage_latency[STAGE_TOTAL], ((int64_t) (now - origin)) / 1000);
+}
+
+/***** arduino_echo_callback() ###
+  Echo of a rosserial frame: [<sequence number>, <apply time (us)>]
+*/
+void arduino_echo_callback(const std_msgs::UInt16MultiArray::ConstPtr& echo_msg) {
+  if (echo_msg->data.size() >= 2) {
+    trace_echo((uint8_t) echo_msg->data[0], echo_msg->data[1]);
+  }
+}
+
+//----------  F I R M W A R E   T E L E M E T R Y  ---------
+
+/***** store_telemetry() ###
+  Keeps a packed report from the arduino for the next diagnostics
+*/
+void store_telemetry(const uint8_t * bytes, size_t size) {
+  RoverTelemetry telemetry;
+  if (!rover_telemetry_unpack(&telemetry, bytes, (uint16_t) std::min(size, (size_t) 0xFFFF))) {
+    ROS_WARN_THROTTLE(10, "Bad telemetry report from the arduino (%zu bytes, version %d)",
+                      size, size > 0 ? bytes[0] : -1);
+    return;
+  }
+  boost::lock_guard<boost::mutex> lock(telemetry_mutex);
+  firmware_telemetry = telemetry;
+  firmware_telemetry_time = ros::WallTime::now();
+  firmware_telemetry_reports++;
+}
+
+/***** arduino_telemetry_callback() ###
+  Telemetry report over rosserial
+*/
+void arduino_telemetry_callback(const std_msgs::UInt8MultiArray::ConstPtr& telemetry_msg) {
+  store_telemetry(telemetry_msg->data.data(), telemetry_msg->data.size());
+}
+
+/***** add_telemetry_page() ###
+  Collects the pages of a report sent as telemetry frames (binary
+    transport), and stores it once every page of the same report is in
+  @INPUT frame - a ROVER_FRAME_TELEMETRY frame
+  @INPUT bytes - the report so far
+  @INPUT pages - bit per page of bytes received
+  @INPUT seq - report the pages are from (-1 for none)
+*/
+void add_telemetry_page(const RoverFrame& frame, uint8_t * bytes, uint32_t& pages, int& seq) {
+  if (frame.mask >= ROVER_TELEMETRY_PAGES) {
+    return;
+  }
+  if (frame.seq != seq) {
+    seq = frame.seq;
+    pages = 0;
+  }
+  uint8_t * page = bytes + frame.mask * ROVER_PAYLOAD_SIZE;
+  for (int i = 0; i < ROVER_CHANNEL_COUNT; i++) {
+    page[2 * i] = (uint8_t) (frame.pulse[i] & 0xFF);
+    page[2 * i + 1] = (uint8_t) (frame.pulse[i] >> 8);
+  }
+  pages |= 1u << frame.mask;
+  if (pages == (1u << ROVER_TELEMETRY_PAGES) - 1) {
+    store_telemetry(bytes, ROVER_TELEMETRY_SIZE);
+    seq = -1;
+  }
+}
+
+/***** echo_thread_main() ###
+  Reads echo and telemetry frames from the arduino's tty (binary transport)
+*/
+void echo_thread_main() {
+  RoverDecoder decoder;
+  uint8_t buffer[64];
+  uint8_t telemetry_bytes[ROVER_TELEMETRY_PAGES * ROVER_PAYLOAD_SIZE];
+  uint32_t telemetry_pages = 0;
+  int telemetry_seq = -1;
+  rover_decoder_init(&decoder);
+
+  while (ros::ok()) {
+    int count = read_serial_port(serial_fd, buffer, sizeof(buffer), 100);  // Checks ros::ok() for shutdown
+    if (count < 0) {
+      ROS_ERROR("Could not read from the arduino: %s", strerror(errno));
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      if (!rover_decoder_push(&decoder, buffer[i])) {
+        continue;
+      }
+      if (decoder.frame.type == ROVER_FRAME_ECHO) {
+        trace_echo(decoder.frame.seq, decoder.frame.pulse[ROVER_ECHO_APPLY_US]);
+      } else if (decoder.frame.type == ROVER_FRAME_TELEMETRY) {
+        add_telemetry_page(decoder.frame, telemetry_bytes, telemetry_pages, telemetry_seq);
+      }
+    }
+  }
+}
+
+/***** add_value() ###
+  Appends a key/value pair to a diagnostic status
+*/
+void add_value(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, double value) {
+  diagnostic_msgs::KeyValue pair;
+  std::ostringstream text;
+  text << value;
+  pair.key = key;
+  pair.value = text.str();
+  status.values.push_back(pair);
+}
 
-void arm_cmd_manual_callback(const std_msgs::Int16MultiArray& cmd_msg) {
-	int16_t  newAngle;	// Reading from array
-	uint16_t newPulse;		// Pulse to send to arduino
-
-	// Set arm base
-	newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_ARM_BASE];
-	newPulse = arm_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_ARM_BASE] = newPulse;
-	// Set arm shoulder
-	newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_ARM_SHOULDER];
-	newPulse = arm_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_ARM_SHOULDER] = newPulse;
-	// Set arm elbow
-	newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_ARM_ELBOW];
-	newPulse = arm_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_ARM_ELBOW] = newPulse;
-	// Set arm wrist
-	newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_ARM_WRIST];
-	newPulse = arm_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_ARM_WRIST] = newPulse;
-
-	// Gripper rotation
-  newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_GRIPPER_ROTATE];
-  newPulse = gripper_angle_to_pulse(newAngle);
-  command_message_array.data[OUT_MSG_INDEX_GRIPPER_ROTATE] = newPulse;
-  // Gripper claw
-  newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_GRIPPER_CLAW];
-  newPulse = gripper_claw_to_pulse(newAngle);
-  command_message_array.data[OUT_MSG_INDEX_GRIPPER_CLAW] = newPulse;
-
-	// Signal updated comamnds
-	UPDATE_NEEDED = true;
-} 
-
-void steer_cmd_manual_callback(const std_msgs::Int16MultiArray& cmd_msg) {
-	int16_t  newAngle;	// Reading from array
-	uint16_t newPulse;		// Pulse to send to arduino
-
-	// Set steer rear
-	newAngle = -((int16_t) cmd_msg.data[IN_MSG_INDEX_STEER_R]);
-	newPulse = steer_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_STEER_R] = newPulse;
-
-	// Set steer front right
-	newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_STEER_F_R];
-	newPulse = steer_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_STEER_F_R] = newPulse;
-	// Set steer front left
-	newAngle = (int16_t) cmd_msg.data[IN_MSG_INDEX_STEER_F_L];
-	newPulse = steer_angle_to_pulse(newAngle);
-	command_message_array.data[OUT_MSG_INDEX_STEER_F_L] = newPulse;
-
-	// Signal updated comamnds
-	UPDATE_NEEDED = true;
-} 
-
-void drive_cmd_manual_callback(const std_msgs::Int16MultiArray& cmd_msg) {
-	int16_t  newSpeed;	// Reading from array
-	uint16_t newPulse;	// Pulse to send to arduino
-
-	// Set drive rear
-	newSpeed = -((int16_t) cmd_msg.data[IN_MSG_INDEX_DRIVE_R]);
-	newPulse = drive_speed_to_pulse(newSpeed);
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_R] = newPulse;
-	// Set drive side right
-	newSpeed = (int16_t) cmd_msg.data[IN_MSG_INDEX_DRIVE_S_R];
-	newPulse = drive_speed_to_pulse(newSpeed);
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_S_R] = newPulse;
-	// Set drive side left
-	newSpeed = ((int16_t) cmd_msg.data[IN_MSG_INDEX_DRIVE_S_L]);
-	newPulse = drive_speed_to_pulse(newSpeed);
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_S_L] = newPulse;
-	// Set drive front right
-	newSpeed = (int16_t) cmd_msg.data[IN_MSG_INDEX_DRIVE_F_R];
-	newPulse = drive_speed_to_pulse(newSpeed);
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_F_R] = newPulse;
-	// Set drive front left
-	newSpeed = ((int16_t) cmd_msg.data[IN_MSG_INDEX_DRIVE_F_L]);
-	newPulse = drive_speed_to_pulse(newSpeed);
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_F_L] = newPulse;
-
-	// Signal updated comamnds
-	UPDATE_NEEDED = true;
-} 
-
-void mast_cmd_manual_callback(const std_msgs::Int16& cmd_msg) {
-  int16_t newSpeed = (int16_t) cmd_msg.data;
-  command_message_array.data[OUT_MSG_MSG_INDEX_MAST] = MAST_SERVO_PWM_IMMOBILE + newSpeed;
-
-  // Signal updated comamnds
-  UPDATE_NEEDED = true;
+/***** add_timer_values() ###
+  Appends a firmware timer (count, min/avg/max in ms) to a diagnostic status
+*/
+void add_timer_values(diagnostic_msgs::DiagnosticStatus& status, const std::string& name, const RoverTimer& timer) {
+  add_value(status, name + " count", timer.count);
+  add_value(status, name + " min (ms)", timer.count > 0 ? timer.min_us / 1000.0 : 0.0);
+  add_value(status, name + " avg (ms)", timer.count > 0 ? timer.total_us / (1000.0 * timer.count) : 0.0);
+  add_value(status, name + " max (ms)", timer.max_us / 1000.0);
+}
+
+/***** firmware_status() ###
+  The last telemetry report from the arduino (see FIRMWARE TELEMETRY)
+*/
+diagnostic_msgs::DiagnosticStatus firmware_status() {
+  RoverTelemetry telemetry;
+  ros::WallTime received;
+  uint32_t reports;
+  {
+    boost::lock_guard<boost::mutex> lock(telemetry_mutex);
+    telemetry = firmware_telemetry;
+    received = firmware_telemetry_time;
+    reports = firmware_telemetry_reports;
+  }
+
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "arduino_command_translator: arduino firmware";
+  status.hardware_id = "arduino";
+  if (reports == 0) {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "No telemetry from the arduino";
+    return status;
+  }
+  double age = (ros::WallTime::now() - received).toSec();
+  if (age > TELEMETRY_STALE_PERIODS * std::max(telemetry.period_ms, (uint16_t) 1) / 1000.0) {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Telemetry from the arduino stopped";
+  } else if (telemetry.i2c_errors > 0 || telemetry.lost_frames > 0 || telemetry.crc_errors > 0) {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Frames or I2C transactions lost";
+  } else {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+  }
+
+  add_value(status, "report age (s)", age);
+  add_value(status, "report period (s)", telemetry.period_ms / 1000.0);
+  add_value(status, "command rate (Hz)", telemetry.period_ms > 0 ? telemetry.frames * 1000.0 / telemetry.period_ms : 0.0);
+  add_value(status, "lost frames", telemetry.lost_frames);
+  add_value(status, "crc errors", telemetry.crc_errors);
+  add_value(status, "i2c errors", telemetry.i2c_errors);
+  add_value(status, "i2c queue full", telemetry.i2c_refused);
+  add_value(status, "free ram (bytes)", telemetry.free_ram);
+  add_timer_values(status, "loop period", telemetry.loop);
+  add_timer_values(status, "command apply", telemetry.command);
+  add_timer_values(status, "i2c transaction", telemetry.i2c);
+  for (int i = 0; i < ROVER_TELEMETRY_TASKS; i++) {
+    std::string name = TASK_NAMES[i];
+    const RoverTaskTelemetry& task = telemetry.task[i];
+    add_value(status, name + " runs", task.runs);
+    add_value(status, name + " overruns", task.overruns);
+    add_value(status, name + " jitter avg (ms)", task.jitter_avg_us / 1000.0);
+    add_value(status, name + " jitter max (ms)", task.jitter_max_us / 1000.0);
+    add_value(status, name + " run max (ms)", task.run_max_us / 1000.0);
+  }
+  return status;
+}
+
+/***** diagnostics_timer_callback() ###
+  Publishes the p50/p99/max of every stage (in ms) on /diagnostics, and
+    starts new histograms every latency_window seconds.  The arduino's last
+    telemetry report goes with it.
+*/
+void diagnostics_timer_callback(const ros::WallTimerEvent&) {
+  LatencyHistogram latency[STAGE_COUNT];
+  uint32_t lost, traced;
+  {
+    boost::lock_guard<boost::mutex> lock(trace_mutex);
+    memcpy(latency, stage_latency, sizeof(latency));
+    lost = lost_echoes;
+    traced = traced_commands;
+    ros::WallTime now = ros::WallTime::now();
+    if (latency_window > 0 && (now - latency_window_start).toSec() >= latency_window) {
+      for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        latency_reset(stage_latency[stage]);
+      }
+      lost_echoes = 0;
+      traced_commands = 0;
+      latency_window_start = now;
+    }
+  }
+
+  diagnostic_msgs::DiagnosticArrayPtr message(new diagnostic_msgs::DiagnosticArray());
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "arduino_command_translator: command latency";
+  status.hardware_id = "arduino";
+  if (traced > 0 && latency[STAGE_TOTAL].count == 0) {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "No echoes from the arduino";
+  } else {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+  }
+  add_value(status, "traced commands", traced);
+  add_value(status, "lost echoes", lost);
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    std::string name = STAGE_NAMES[stage];
+    add_value(status, name + " count", latency[stage].count);
+    add_value(status, name + " p50 (ms)", latency_percentile(latency[stage], 0.50) / 1000.0);
+    add_value(status, name + " p99 (ms)", latency_percentile(latency[stage], 0.99) / 1000.0);
+    add_value(status, name + " max (ms)", latency[stage].max_us / 1000.0);
+  }
+
+  message->header.stamp = ros::Time::now();
+  message->status.push_back(status);
+  message->status.push_back(firmware_status());
+  pub_diagnostics->publish(message);
+}
+
+//----------  C A L I B R A T I O N  ---------
+
+/***** load_calibrated_tables() ###
+  Loads calibration_file (or the defaults if there is none) and swaps in
+    the new lookup tables.  The old tables are kept if the file has an error.
+  @RETURN true if new tables were swapped in
+*/
+bool load_calibrated_tables() {
+  boost::shared_ptr<CalibratedTables> tables(new CalibratedTables());
+  default_calibration(tables->calibration);
+
+  if (!calibration_file.empty()) {
+    std::string error;
+    if (!load_calibration(calibration_file, tables->calibration, error)) {
+      ROS_ERROR("Calibration not loaded: %s", error.c_str());
+      return false;
+    }
+    ROS_INFO("Loaded calibration %s", calibration_file.c_str());
+  }
+
+  build_calibrated_tables(*tables);
+  boost::shared_ptr<const CalibratedTables> const_tables = tables;
+  boost::atomic_store(&calibrated_tables, const_tables);
+  return true;
+}
+
+/***** calibration_timer_callback() ###
+  Reloads the calibration file when it changes, and sends the last
+    command again through the new tables
+*/
+void calibration_timer_callback(const ros::WallTimerEvent&) {
+  struct stat info;
+  if (stat(calibration_file.c_str(), &info) != 0) {
+    return;
+  }
+  if (info.st_mtim.tv_sec == calibration_mtime.tv_sec && info.st_mtim.tv_nsec == calibration_mtime.tv_nsec
+      && info.st_size == calibration_size) {
+    return;
+  }
+  calibration_mtime = info.st_mtim;
+  calibration_size = info.st_size;
+
+  if (load_calibrated_tables()) {
+    // The output thread re-converts the last command with the new tables
+    wake_output_thread(ALL_GROUPS);
+  }
 }
 
 //----------  I N I T I A L I Z E R   F U N C T I O N S  ---------
 void initialize_command_message_array() {
+	pending_groups.store(0);
 	// Clear and reinitialize the command array
 	command_message_array.data.clear();
-	for (int i = 0; i < 15; i ++) {
+	for (int i = 0; i < OUT_MSG_CHANNEL_COUNT; i ++) {
 		command_message_array.data.push_back(0);
+		command_values[i] = 0;
+		command_move_ms[i] = 0;
+		slot_value[i].store(0);
+		slot_move_ms[i].store(0);
 	}
-	// Set default values
-	command_message_array.data[OUT_MSG_INDEX_ARM_BASE]       = ARM_PWM_NEUTRAL;	// Initialize arm servos
-	command_message_array.data[OUT_MSG_INDEX_ARM_SHOULDER]   = ARM_PWM_NEUTRAL;
-	command_message_array.data[OUT_MSG_INDEX_ARM_ELBOW]      = ARM_PWM_NEUTRAL;
-	command_message_array.data[OUT_MSG_INDEX_ARM_WRIST]      = ARM_PWM_NEUTRAL;
-	command_message_array.data[OUT_MSG_INDEX_STEER_R]        = STEER_PWM_NEUTRAL;	// Initialize steering servos
-	command_message_array.data[OUT_MSG_INDEX_STEER_F_R]      = STEER_PWM_NEUTRAL;
-	command_message_array.data[OUT_MSG_INDEX_STEER_F_L]      = STEER_PWM_NEUTRAL;
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_R]        = NEUTRAL_SPEED_PWM;	// Initialize drive motors
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_S_R]      = NEUTRAL_SPEED_PWM;
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_S_L]      = NEUTRAL_SPEED_PWM;
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_F_R]      = NEUTRAL_SPEED_PWM;
-	command_message_array.data[OUT_MSG_INDEX_DRIVE_F_L]      = NEUTRAL_SPEED_PWM;
-  command_message_array.data[OUT_MSG_INDEX_GRIPPER_ROTATE] = GRIPPER_ROTATE_PWM_NEUTRAL; // Initialize gripper
-  command_message_array.data[OUT_MSG_INDEX_GRIPPER_CLAW]   = GRIPPER_CLAW_PWM_OPEN;
-  command_message_array.data[OUT_MSG_MSG_INDEX_MAST]       = MAST_SERVO_PWM_IMMOBILE; // Set mast to immobile
-}
-
-int main(int argc, char **argv) {
-	// Initialize ROS elements
-    ros::init(argc, argv, "arduino_command_translator");
-    ros::NodeHandle n;
-    ros::Rate loop_rate(60);
-
-
-    // Create and initialize rostopic subscribers
-    sub_arm_cmd_manual = new ros::Subscriber();
-    sub_steer_cmd_manual = new ros::Subscriber();
-    sub_drive_cmd_manual = new ros::Subscriber();
-    sub_mast_cmd_manual = new ros::Subscriber();
-    *sub_arm_cmd_manual = n.subscribe("arm_cmd_manual", 1000, arm_cmd_manual_callback);
-    *sub_steer_cmd_manual = n.subscribe("steer_cmd_manual", 1000, steer_cmd_manual_callback);
-    *sub_drive_cmd_manual = n.subscribe("drive_cmd_manual", 1000, drive_cmd_manual_callback);
-    *sub_mast_cmd_manual = n.subscribe("mast_cmd_manual", 1000, mast_cmd_manual_callback);
-
-    // Create and initialize  publisher
-    pub_arduino_cmd = new ros::Publisher();
-    *pub_arduino_cmd = n.advertise<std_msgs::UInt16MultiArray>("arduino_cmd", 1000);
+	for (int i = 0; i < TRACE_WORDS; i++) {
+		trace_value[i].store(0);
+	}
+	// Set default values (arm, steering and gripper rotation centered, claw open,
+	// drive motors stopped and mast immobile)
+	convert_channels(calibrated_tables->channel, command_values, &command_message_array.data[0]);
+}
+
+/***** start_arduino_command_translator() ###
+  Creates the publishers, output thread and subscriber.
+  The subscriber comes last: a command can arrive on a spinner thread as
+    soon as it exists, and must find the tables and command slots ready.
+  Everything after this runs from callbacks (on any number of spinner
+    threads) and the output thread, so the same code is used by the
+    standalone node and the nodelet.
+*/
+void start_arduino_command_translator(ros::NodeHandle& n, ros::NodeHandle& pn) {
+    // Transport to the arduino: "rosserial" (arduino_cmd topic) or "binary" (RoverProtocol frames on ~port)
+    std::string transport;
+    pn.param<std::string>("transport", transport, "rosserial");
+    BINARY_TRANSPORT = (transport == "binary");
+
+    if (BINARY_TRANSPORT) {
+      std::string port;
+      int baud;
+      pn.param<std::string>("port", port, "/dev/ttyACM0");
+      pn.param<int>("baud", baud, ROVER_PROTOCOL_BAUD);
+      serial_fd = open_serial_port(port.c_str(), baud);
+      if (serial_fd < 0) {
+        ROS_ERROR("Could not open %s at %d baud: %s", port.c_str(), baud, strerror(errno));
+      } else {
+        echo_thread = new boost::thread(echo_thread_main);
+      }
+    } else {
+      // Create and initialize  publisher
+      pub_arduino_cmd = new ros::Publisher();
+      *pub_arduino_cmd = n.advertise<std_msgs::UInt16MultiArray>("arduino_cmd", 1000);
+      sub_arduino_echo = new ros::Subscriber();
+      *sub_arduino_echo = n.subscribe("arduino_echo", 1000, arduino_echo_callback);
+      sub_arduino_telemetry = new ros::Subscriber();
+      *sub_arduino_telemetry = n.subscribe("arduino_telemetry", 10, arduino_telemetry_callback);
+      pub_arduino_motor_profile = new ros::Publisher();
+      *pub_arduino_motor_profile = n.advertise<std_msgs::UInt16MultiArray>("arduino_motor_profile", 1, true);
+    }
+
+    // DC motor ramp profile, resent every motor_profile_period seconds
+    std::string profile;
+    int acceleration, jerk, emergency_deceleration;
+    double motor_profile_period;
+    pn.param<std::string>("motor_profile", profile, "trapezoidal");
+    pn.param<int>("motor_acceleration", acceleration, 500);
+    pn.param<int>("motor_jerk", jerk, 5000);
+    pn.param<int>("motor_emergency_deceleration", emergency_deceleration, 2000);
+    pn.param<double>("motor_profile_period", motor_profile_period, 1.0);
+    if (profile != "trapezoidal" && profile != "s_curve") {
+      ROS_ERROR("Unknown motor_profile \"%s\", using trapezoidal", profile.c_str());
+    }
+    motor_profile[PROFILE_WORD_MOTORS] = PROFILE_ALL_MOTORS;
+    motor_profile[PROFILE_WORD_PROFILE] = (profile == "s_curve") ? PROFILE_S_CURVE : PROFILE_TRAPEZOIDAL;
+    motor_profile[PROFILE_WORD_ACCELERATION] = (uint16_t) std::max(1, std::min(acceleration, 0xFFFF));
+    motor_profile[PROFILE_WORD_JERK] = (uint16_t) std::max(1, std::min(jerk, 0xFFFF));
+    motor_profile[PROFILE_WORD_EMERGENCY] = (uint16_t) std::max(1, std::min(emergency_deceleration, 0xFFFF));
+
+    // Latency tracing: stage histograms on /diagnostics every diagnostics_period seconds
+    double diagnostics_period;
+    pn.param<double>("diagnostics_period", diagnostics_period, 1.0);
+    pn.param<double>("latency_window", latency_window, 10.0);
+    latency_window_start = ros::WallTime::now();
+    pub_diagnostics = new ros::Publisher();
+    *pub_diagnostics = n.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+    diagnostics_timer = new ros::WallTimer();
+    *diagnostics_timer = n.createWallTimer(ros::WallDuration(diagnostics_period), diagnostics_timer_callback);
+
+    // Calibration file (checked for changes every calibration_poll_period seconds)
+    double calibration_poll_period;
+    pn.param<std::string>("calibration_file", calibration_file, "");
+    pn.param<double>("calibration_poll_period", calibration_poll_period, 1.0);
+    struct stat info;
+    if (!calibration_file.empty() && stat(calibration_file.c_str(), &info) == 0) {
+      calibration_mtime = info.st_mtim;
+      calibration_size = info.st_size;
+    }
+    if (!load_calibrated_tables() && !calibrated_tables) {
+      // Bad file at startup, run on the defaults until it is fixed
+      std::string file = calibration_file;
+      calibration_file.clear();
+      load_calibrated_tables();
+      calibration_file = file;
+    }
+    if (!calibration_file.empty()) {
+      calibration_timer = new ros::WallTimer();
+      *calibration_timer = n.createWallTimer(ros::WallDuration(calibration_poll_period), calibration_timer_callback);
+    }
 
     // Initialize command publisher array
     initialize_command_message_array();
 
-    std::cout << "STARTED PWM TRANSLATOR!!!" << std::endl;
-
-    while (ros::ok()) {
+    // Commands are sent as soon as the output thread wakes, or batched for up to coalesce_window seconds
+    pn.param<double>("coalesce_window", coalesce_window, 0.0);
+    // Delta frames with a keyframe every keyframe_interval frames / keyframe_period seconds
+    pn.param<bool>("delta_frames", delta_frames, true);
+    pn.param<int>("keyframe_interval", keyframe_interval, 20);
+    pn.param<double>("keyframe_period", keyframe_period, 1.0);
 
-    	// Check fo update to servos/motors
-		if (UPDATE_NEEDED) {
-			UPDATE_NEEDED = false;
-			pub_arduino_cmd->publish(command_message_array);
-		}
+    output_thread = new boost::thread(output_thread_main);
 
-        ros::spinOnce();
-        loop_rate.sleep();
+    send_motor_profile();
+    if (motor_profile_period > 0) {
+      motor_profile_timer = new ros::WallTimer();
+      *motor_profile_timer = n.createWallTimer(ros::WallDuration(motor_profile_period), motor_profile_timer_callback);
     }
+    if (keyframe_period > 0) {
+      // Checked twice a period, so an idle keyframe is at most 1.5 periods late
+      keyframe_timer = new ros::WallTimer();
+      *keyframe_timer = n.createWallTimer(ros::WallDuration(keyframe_period / 2), keyframe_timer_callback);
+    }
+
+    // Create and initialize rostopic subscriber
+    sub_rover_cmd_manual = new ros::Subscriber();
+    *sub_rover_cmd_manual = n.subscribe("rover_cmd_manual", 1000, rover_cmd_manual_callback);
 
-    return 0;
-}
\ No newline at end of file
+    std::cout << "STARTED PWM TRANSLATOR!!!" << std::endl;
+}
+
+/***** start_arduino_command_translator_offline() ###
+  Sets the translator up without a node (see arduino_command_translator.h)
+  @INPUT sink - gets every arduino_cmd frame
+*/
+void start_arduino_command_translator_offline(ArduinoCmdSink sink) {
+    arduino_cmd_sink = sink;
+    BINARY_TRANSPORT = false;
+    delta_frames = true;
+    keyframe_interval = 20;
+    keyframe_period = 1.0;
+    frames_since_keyframe = 0;
+    last_keyframe_time = ros::Time();
+    frame_seq = 0;
+    last_traced_id = 0;
+    memset(last_sent_pulse, 0, sizeof(last_sent_pulse));
+
+    calibration_file.clear();
+    load_calibrated_tables();
+    initialize_command_message_array();
+}
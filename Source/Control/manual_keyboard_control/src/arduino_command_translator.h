@@ -0,0 +1,69 @@
+#ifndef ARDUINO_COMMAND_TRANSLATOR_H
+#define ARDUINO_COMMAND_TRANSLATOR_H
+
+#include "ros/ros.h"
+#include <std_msgs/UInt16MultiArray.h>
+#include <manual_keyboard_control/RoverCommand.h>
+
+/* RoverCommand -> arduino_cmd PWM translator
+
+  Turns RoverCommand messages on rover_cmd_manual into PWM pulses on
+  arduino_cmd.  Used by arduino_command_translator_node.cpp (standalone
+  node) and nodelets.cpp (ArduinoCommandTranslatorNodelet).  The translator
+  keeps its state in globals, so only one can be loaded per process.
+  Its callbacks are safe to run on several spinner threads; the pulses are
+  sent by an output thread of its own.  Channels with a move_ms go out as
+  servo moves (move frames on arduino_cmd) that the arduino interpolates itself.
+  The latency of every stage from the key press to the PWM write (see
+  LATENCY TRACING in arduino_command_translator.cpp) is published on
+  /diagnostics, with the arduino's own telemetry (see FIRMWARE TELEMETRY).
+
+  Parameters:
+    ~coalesce_window (double, 0)   - 0 sends every command as soon as it arrives,
+                                     > 0 batches the commands that arrive within
+                                     this many seconds of each other into one
+    ~delta_frames (bool, true)     - send only the changed pulses (see DELTA FRAMES
+                                     in arduino_command_translator.cpp)
+    ~keyframe_interval (int, 20)   - most delta frames between two full keyframes
+    ~keyframe_period (double, 1.0) - most seconds between two full keyframes, also
+                                     while no commands arrive
+    ~transport (string, rosserial) - "rosserial" publishes arduino_cmd for serial_node.py,
+                                     "binary" writes RoverProtocol frames (see
+                                     Source/Arduino/libraries/RoverProtocol) to ~port
+    ~port (string, /dev/ttyACM0)   - arduino tty (binary transport)
+    ~baud (int, 115200)            - arduino baud rate (binary transport)
+    ~calibration_file (string, "") - servo/motor calibration (see config/calibration.txt),
+                                     empty uses the defaults in pulse_tables.h
+    ~calibration_poll_period (double, 1.0) - seconds between checks for a changed
+                                     calibration file (reloaded without a restart)
+    ~spinner_threads (int, 0)      - callback threads of the standalone node
+                                     (0 = one per core); rover_cmd_manual is still
+                                     taken one message at a time, the other threads
+                                     run the echo, telemetry and timer callbacks
+    ~diagnostics_period (double, 1.0) - seconds between latency reports on /diagnostics
+    ~latency_window (double, 10.0) - seconds of commands in each latency report
+                                     (0 = everything since startup)
+    ~motor_profile (string, trapezoidal) - DC motor ramp, "trapezoidal" or "s_curve"
+                                     (see MOTOR PROFILES in arduino_command_translator.cpp)
+    ~motor_acceleration (int, 500) - most change of a motor pulse (counts/s)
+    ~motor_jerk (int, 5000)        - most change of a motor's acceleration (counts/s^2, s_curve)
+    ~motor_emergency_deceleration (int, 2000) - most change of a motor pulse when
+                                     stopping (counts/s)
+    ~motor_profile_period (double, 1.0) - seconds between resends of the motor
+                                     profile (the arduino forgets it when it resets)
+*/
+
+void start_arduino_command_translator(ros::NodeHandle& n, ros::NodeHandle& pn);
+
+/* Offline use (teleop_benchmark.cpp): no node, output thread or parameters
+  (the defaults above, rosserial transport).  Commands are passed to
+  rover_cmd_manual_callback() and sent by translate_pending_commands() on
+  the caller's thread, and every arduino_cmd frame goes to the sink instead
+  of being published.  ros::Time is the caller's simulated clock. */
+typedef void (*ArduinoCmdSink)(const std_msgs::UInt16MultiArrayPtr& message);
+
+void start_arduino_command_translator_offline(ArduinoCmdSink sink);
+void rover_cmd_manual_callback(const manual_keyboard_control::RoverCommand::ConstPtr& cmd_msg);
+void translate_pending_commands();
+
+#endif
@@ -0,0 +1,22 @@
+#include "ros/ros.h"
+#include "arduino_command_translator.h"
+
+/* Standalone PWM translator node (see nodelets.cpp for the nodelet) */
+int main(int argc, char **argv) {
+	// Initialize ROS elements
+    ros::init(argc, argv, "arduino_command_translator");
+    ros::NodeHandle n;
+    ros::NodeHandle pn("~");
+
+    start_arduino_command_translator(n, pn);
+
+    // Callbacks run on spinner_threads threads (0 = one per core), rover_cmd_manual's
+    // one at a time, see COMMAND SLOTS
+    int spinner_threads;
+    pn.param<int>("spinner_threads", spinner_threads, 0);
+    ros::AsyncSpinner spinner(spinner_threads);
+    spinner.start();
+    ros::waitForShutdown();
+
+    return 0;
+}
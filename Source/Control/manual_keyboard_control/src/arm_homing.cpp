@@ -0,0 +1,111 @@
+#include "arm_homing.h"
+#include <math.h>
+
+// Collision rule angles (degrees)
+#define SHOULDER_EXTENDED   55.0f   // Pull the wrist in above this shoulder angle
+#define WRIST_RETRACTED    -40.0f   // Wrist angle while the shoulder is extended
+#define SHOULDER_CLEARANCE  30.0f   // Shoulder angle while the base turns
+#define SHOULDER_LOW        20.0f   // Below this the elbow no longer has to stay clear
+#define ELBOW_CLEARANCE     30.0f   // Elbow to shoulder angle kept while the arm is up
+
+
+/***** add_waypoint() ***
+    Appends a pose to the trajectory, timed so that the slowest joint
+    moves at its speed limit.  Poses equal to the last one are skipped.   */
+static void add_waypoint(HomingTrajectory& trajectory, const float pose[HOMING_JOINTS],
+                         const float speed[HOMING_JOINTS]) {
+    const int last = trajectory.waypoint_count - 1;
+    float duration = 0;
+    for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+        float joint_duration = fabsf(pose[joint] - trajectory.waypoint[last][joint]) / speed[joint];
+        if (joint_duration > duration) {
+            duration = joint_duration;
+        }
+    }
+    if (duration <= 0 || trajectory.waypoint_count >= HOMING_MAX_WAYPOINTS) {
+        return;
+    }
+
+    for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+        trajectory.waypoint[trajectory.waypoint_count][joint] = pose[joint];
+    }
+    trajectory.time[trajectory.waypoint_count] = trajectory.time[last] + duration;
+    trajectory.waypoint_count++;
+}
+
+/***** lift_elbow_clear() ***
+    Raises the elbow (if needed) so it is clear of the shoulder.    */
+static void lift_elbow_clear(HomingTrajectory& trajectory, float pose[HOMING_JOINTS],
+                             const float speed[HOMING_JOINTS]) {
+    if (pose[HOMING_ELBOW] < pose[HOMING_SHOULDER] + ELBOW_CLEARANCE) {
+        pose[HOMING_ELBOW] = pose[HOMING_SHOULDER] + ELBOW_CLEARANCE;
+        add_waypoint(trajectory, pose, speed);
+    }
+}
+
+void plan_arm_homing(const float start[HOMING_JOINTS], const float speed[HOMING_JOINTS],
+                     HomingTrajectory& trajectory) {
+    float pose[HOMING_JOINTS];
+    for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+        pose[joint] = start[joint];
+        trajectory.waypoint[0][joint] = start[joint];
+    }
+    trajectory.time[0] = 0;
+    trajectory.waypoint_count = 1;
+
+    // The gripper rotation can't hit anything, so it goes home during the first move
+    pose[HOMING_GRIPPER_ROTATE] = 0;
+
+    // 1. Pull the wrist in before moving an extended shoulder
+    if (pose[HOMING_SHOULDER] > SHOULDER_EXTENDED) {
+        pose[HOMING_WRIST] = WRIST_RETRACTED;
+        add_waypoint(trajectory, pose, speed);
+    }
+
+    // 2. Turn the base back from the clearance pose
+    if (pose[HOMING_BASE] != 0) {
+        lift_elbow_clear(trajectory, pose, speed);
+        pose[HOMING_SHOULDER] = SHOULDER_CLEARANCE;
+        pose[HOMING_ELBOW]    = SHOULDER_CLEARANCE + ELBOW_CLEARANCE;
+        add_waypoint(trajectory, pose, speed);
+        pose[HOMING_BASE] = 0;
+        add_waypoint(trajectory, pose, speed);
+    }
+
+    // 3. Lower the shoulder with the elbow clear of it
+    if (pose[HOMING_SHOULDER] > SHOULDER_LOW) {
+        lift_elbow_clear(trajectory, pose, speed);
+        pose[HOMING_SHOULDER] = SHOULDER_LOW;
+        pose[HOMING_ELBOW]    = SHOULDER_LOW + ELBOW_CLEARANCE;
+        add_waypoint(trajectory, pose, speed);
+    }
+
+    // 4. Home
+    for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+        pose[joint] = 0;
+    }
+    add_waypoint(trajectory, pose, speed);
+}
+
+bool sample_arm_homing(const HomingTrajectory& trajectory, float t, float pose[HOMING_JOINTS]) {
+    // Find the segment the arm is in at time t
+    int next = 1;
+    while (next < trajectory.waypoint_count && trajectory.time[next] <= t) {
+        next++;
+    }
+    if (next >= trajectory.waypoint_count) {
+        for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+            pose[joint] = trajectory.waypoint[trajectory.waypoint_count - 1][joint];
+        }
+        return false;
+    }
+
+    // Interpolate between its waypoints
+    const float * from = trajectory.waypoint[next - 1];
+    const float * to   = trajectory.waypoint[next];
+    float fraction = (t - trajectory.time[next - 1]) / (trajectory.time[next] - trajectory.time[next - 1]);
+    for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+        pose[joint] = from[joint] + fraction * (to[joint] - from[joint]);
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef ARM_HOMING_H
+#define ARM_HOMING_H
+
+/* Arm "return home" trajectory planner
+
+  The trajectory is planned once, from the pose the arm is in when the home
+  key is pressed, as a list of joint space waypoints.  Every waypoint obeys
+  the collision rules of the arm, and the arm moves in a straight line (in
+  joint space) between them, so the whole trajectory is collision free.
+  Segment durations come from the joint speed limits:
+
+    1. If the shoulder is extended (> 55 degrees) pull the wrist in (-40 degrees)
+       to reduce the strain on the shoulder servo
+    2. If the base is turned, lift the arm to the clearance pose
+       (shoulder 30, elbow shoulder + 30) and then turn the base back to 0
+    3. Lower the shoulder to 20 degrees, keeping the elbow clear of it
+    4. Move every joint to 0 degrees
+
+  The gripper claw is left alone.
+*/
+
+// Joints moved by the planner
+#define HOMING_BASE            0
+#define HOMING_SHOULDER        1
+#define HOMING_ELBOW           2
+#define HOMING_WRIST           3
+#define HOMING_GRIPPER_ROTATE  4
+#define HOMING_JOINTS          5
+
+// Longest possible plan (start pose + every step above)
+#define HOMING_MAX_WAYPOINTS   8
+
+struct HomingTrajectory {
+    int   waypoint_count;                               // Number of waypoints (including the start pose)
+    float waypoint[HOMING_MAX_WAYPOINTS][HOMING_JOINTS]; // Joint angles at every waypoint (degrees)
+    float time[HOMING_MAX_WAYPOINTS];                    // Time the arm reaches every waypoint (s)
+};
+
+/***** plan_arm_homing() ***
+    Plans a collision free trajectory from the current arm pose to home.
+    @INPUT const float start[] - current joint angles (degrees)
+    @INPUT const float speed[] - joint speed limits (degrees/s)
+    @INPUT HomingTrajectory& trajectory - set to the planned trajectory    */
+void plan_arm_homing(const float start[HOMING_JOINTS], const float speed[HOMING_JOINTS],
+                     HomingTrajectory& trajectory);
+
+/***** sample_arm_homing() ***
+    Gets the arm pose at some time along a planned trajectory.
+    @INPUT const HomingTrajectory& trajectory - planned trajectory
+    @INPUT float t - time since the start of the trajectory (s)
+    @INPUT float pose[] - set to the joint angles at time t (degrees)
+    @RETURN bool - false once the arm is home    */
+bool sample_arm_homing(const HomingTrajectory& trajectory, float t, float pose[HOMING_JOINTS]);
+
+#endif
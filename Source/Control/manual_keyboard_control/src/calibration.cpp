@@ -0,0 +1,145 @@
+#include "calibration.h"
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+// Channel names in the calibration file (RoverCommand / arduino_cmd order)
+static const char * CHANNEL_NAMES[PULSE_CHANNEL_COUNT] = {
+    "arm_base", "arm_shoulder", "arm_elbow", "arm_wrist",
+    "steer_rear", "steer_front_right", "steer_front_left",
+    "drive_rear", "drive_side_right", "drive_side_left", "drive_front_right", "drive_front_left",
+    "gripper_rotate", "gripper_claw", "mast"
+};
+
+static const char * KIND_NAMES[KIND_COUNT] = { "angle", "claw", "drive", "mast" };
+
+// Inputs covered by the table of each kind
+static const int KIND_TABLE_MIN[KIND_COUNT] = { ANGLE_TABLE_MIN, CLAW_TABLE_MIN, DRIVE_TABLE_MIN, MAST_TABLE_MIN };
+static const int KIND_TABLE_MAX[KIND_COUNT] = { ANGLE_TABLE_MAX, CLAW_TABLE_MAX, DRIVE_TABLE_MAX, MAST_TABLE_MAX };
+
+/***** set_channel() ***
+    Sets one row of a calibration    */
+static void set_channel(Calibration& c, int channel, CalibrationKind kind,
+                        int neutral, int min, int max, int full_turn, int sign) {
+    c.kind[channel]      = kind;
+    c.neutral[channel]   = neutral;
+    c.min[channel]       = min;
+    c.max[channel]       = max;
+    c.full_turn[channel] = full_turn;
+    c.sign[channel]      = sign;
+}
+
+void default_calibration(Calibration& c) {
+    for (int channel = 0; channel < 4; channel++) {
+        set_channel(c, channel, KIND_ANGLE, ARM_PWM_NEUTRAL, ARM_PWM_MIN, ARM_PWM_MAX, ARM_PWM_360_DEGREES, 1);
+    }
+    for (int channel = 4; channel < 7; channel++) {
+        set_channel(c, channel, KIND_ANGLE, STEER_PWM_NEUTRAL, STEER_PWM_MIN, STEER_PWM_MAX, STEER_PWM_360_DEGREES, 1);
+    }
+    for (int channel = 7; channel < 12; channel++) {
+        set_channel(c, channel, KIND_DRIVE, NEUTRAL_SPEED_PWM, MAX_REVERSE_SPEED_PWM, MAX_FORWARD_SPEED_PWM, 0, 1);
+    }
+    set_channel(c, 12, KIND_ANGLE, GRIPPER_ROTATE_PWM_NEUTRAL, GRIPPER_ROTATE_PWM_MIN, GRIPPER_ROTATE_PWM_MAX,
+                GRIPPER_ROTATE_PWM_360_DEGREES, 1);
+    set_channel(c, 13, KIND_CLAW, GRIPPER_CLAW_PWM_OPEN, GRIPPER_CLAW_PWM_CLOSED, GRIPPER_CLAW_PWM_OPEN, 0, 1);
+    set_channel(c, 14, KIND_MAST, MAST_SERVO_PWM_IMMOBILE, MAST_SERVO_PWM_MIN, MAST_SERVO_PWM_MAX, 0, 1);
+
+    // Mounted backwards
+    c.sign[4] = -1;  // Rear steer
+    c.sign[7] = -1;  // Rear drive
+}
+
+bool load_calibration(const std::string& path, Calibration& calibration, std::string& error) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+
+    Calibration c = calibration;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream row(line);
+        std::string name, kind_name;
+        int neutral, min, max, full_turn, sign;
+        if (!(row >> name)) {
+            continue;  // Blank or comment
+        }
+
+        std::ostringstream where;
+        where << path << ":" << line_number << ": ";
+        if (!(row >> kind_name >> neutral >> min >> max >> full_turn >> sign)) {
+            error = where.str() + "expected <name> <kind> <neutral> <min> <max> <full_turn> <sign>";
+            return false;
+        }
+
+        int channel = 0;
+        while (channel < PULSE_CHANNEL_COUNT && name != CHANNEL_NAMES[channel]) {
+            channel++;
+        }
+        if (channel == PULSE_CHANNEL_COUNT) {
+            error = where.str() + "unknown channel \"" + name + "\"";
+            return false;
+        }
+        if (kind_name != KIND_NAMES[c.kind[channel]]) {
+            error = where.str() + name + " must be of kind \"" + KIND_NAMES[c.kind[channel]] + "\"";
+            return false;
+        }
+        if (min < 0 || max >= PWM_RESOLUTION || min > max || neutral < min || neutral > max) {
+            error = where.str() + "need 0 <= min <= neutral <= max < 4096";
+            return false;
+        }
+        if (sign != 1 && sign != -1) {
+            error = where.str() + "sign must be 1 or -1";
+            return false;
+        }
+        set_channel(c, channel, (CalibrationKind) c.kind[channel], neutral, min, max, full_turn, sign);
+    }
+
+    calibration = c;
+    return true;
+}
+
+/***** calibrated_pulse() ***
+    Converts one input with one channel's calibration (the pulse_tables.h functions)    */
+static uint16_t calibrated_pulse(const Calibration& c, int channel, int input) {
+    switch (c.kind[channel]) {
+        case KIND_ANGLE:
+            return angle_pulse(input, c.neutral[channel], c.full_turn[channel], c.min[channel], c.max[channel]);
+        case KIND_CLAW:
+            return claw_pulse(input, c.neutral[channel], c.min[channel]);
+        case KIND_DRIVE:
+            return speed_pulse(input, c.neutral[channel], c.min[channel], c.max[channel]);
+        default:
+            return offset_pulse(input, c.neutral[channel], c.min[channel], c.max[channel]);
+    }
+}
+
+void build_calibrated_tables(CalibratedTables& tables) {
+    const Calibration& c = tables.calibration;
+
+    // Size the storage first (the table pointers must not move)
+    size_t size = 0;
+    for (int channel = 0; channel < PULSE_CHANNEL_COUNT; channel++) {
+        size += KIND_TABLE_MAX[c.kind[channel]] - KIND_TABLE_MIN[c.kind[channel]] + 1;
+    }
+    tables.storage.assign(size, 0);
+
+    uint16_t * next = &tables.storage[0];
+    for (int channel = 0; channel < PULSE_CHANNEL_COUNT; channel++) {
+        int min = KIND_TABLE_MIN[c.kind[channel]];
+        int max = KIND_TABLE_MAX[c.kind[channel]];
+        for (int input = min; input <= max; input++) {
+            next[input - min] = calibrated_pulse(c, channel, input);
+        }
+        tables.channel[channel].zero = next - min;
+        tables.channel[channel].min  = min;
+        tables.channel[channel].max  = max;
+        tables.channel[channel].sign = c.sign[channel];
+        next += max - min + 1;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "pulse_tables.h"
+
+/*-----------------------------------------------------------------------------------
+//-----------------   S E R V O   &   M O T O R   C A L I B R A T I O N   ----------
+//-----------------------------------------------------------------------------------
+  Per channel calibration for arduino_command_translator, read from a text file
+  (config/calibration.txt) instead of the #defines in pulse_tables.h, which are
+  now only the defaults.
+
+  A calibration is turned into one lookup table per channel (same domains and
+  conversion functions as the compile time tables), so converting a command
+  costs the same as before.  The translator keeps its tables in a shared_ptr
+  that is swapped atomically when the file changes: a command being converted
+  keeps using the tables it started with.
+*/
+
+//----------   C H A N N E L   K I N D S   ----------
+enum CalibrationKind {
+    KIND_ANGLE,  // pulse = neutral + angle * full_turn / 360, clamped to [min, max]
+    KIND_CLAW,   // 0 (open) = neutral ... 100 (closed) = min
+    KIND_DRIVE,  // -2000 = min, 0 = neutral, 2000 = max
+    KIND_MAST,   // pulse = neutral + speed, clamped to [min, max]
+    KIND_COUNT
+};
+
+//----------   C A L I B R A T I O N   ----------
+// # Struct of arrays, indexed by channel (RoverCommand / arduino_cmd order)
+struct Calibration {
+    uint8_t kind[PULSE_CHANNEL_COUNT];
+    int16_t neutral[PULSE_CHANNEL_COUNT];
+    int16_t min[PULSE_CHANNEL_COUNT];
+    int16_t max[PULSE_CHANNEL_COUNT];
+    int16_t full_turn[PULSE_CHANNEL_COUNT];  // Angles only
+    int8_t  sign[PULSE_CHANNEL_COUNT];       // -1 for servos/motors mounted backwards
+};
+
+// # Lookup tables built from a calibration
+struct CalibratedTables {
+    Calibration calibration;
+    ChannelTable channel[PULSE_CHANNEL_COUNT];
+    std::vector<uint16_t> storage;  // Every channel's table, back to back
+};
+
+/***** default_calibration() ***
+    The calibration in pulse_tables.h    */
+void default_calibration(Calibration& calibration);
+
+/***** load_calibration() ***
+    Reads a calibration file.  Channels missing from the file keep their default.
+    @INPUT const std::string& path
+    @OUTPUT Calibration& calibration - only written if the whole file is valid
+    @OUTPUT std::string& error - first problem found
+    @RETURN false if the file can't be read or has an error    */
+bool load_calibration(const std::string& path, Calibration& calibration, std::string& error);
+
+/***** build_calibrated_tables() ***
+    Fills tables.channel/storage from tables.calibration    */
+void build_calibrated_tables(CalibratedTables& tables);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*-----------------------------------------------------------------------------------
+//---------------------   L A T E N C Y   H I S T O G R A M S   ---------------------
+//-----------------------------------------------------------------------------------
+  Fixed size latency histograms for the command tracing in
+  arduino_command_translator (p50/p99/max of every stage on /diagnostics).
+
+  Samples are in microseconds.  Buckets are log scale with 4 buckets per
+  power of two (each bucket is at most ~19% wide), from 1 us up to ~16 s,
+  so recording a sample is a count-leading-zeros and an increment, and the
+  histogram never allocates.  Percentiles are reported as the upper edge of
+  their bucket; the max is exact.
+*/
+
+#define LATENCY_SUB_BUCKET_BITS  2
+#define LATENCY_SUB_BUCKETS      (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_POWER        24     // 2^24 us = ~16.8 s, longer samples go in the last bucket
+#define LATENCY_BUCKETS          ((LATENCY_MAX_POWER - LATENCY_SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+struct LatencyHistogram {
+    uint32_t bucket[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+};
+
+static inline void latency_reset(LatencyHistogram& histogram) {
+    memset(&histogram, 0, sizeof(histogram));
+}
+
+/***** latency_bucket() ***
+    Bucket of a sample: the power of two below it, then the next 2 bits    */
+static inline int latency_bucket(uint32_t us) {
+    if (us < LATENCY_SUB_BUCKETS) {
+        return (int) us;
+    }
+    int power = 31 - __builtin_clz(us);
+    if (power > LATENCY_MAX_POWER) {
+        return LATENCY_BUCKETS - 1;
+    }
+    uint32_t sub = (us >> (power - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return (power - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS + (int) sub;
+}
+
+/***** latency_bucket_limit() ***
+    Largest sample that goes in a bucket    */
+static inline uint32_t latency_bucket_limit(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return (uint32_t) bucket;
+    }
+    int power = bucket / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS - 1;
+    uint32_t sub = (uint32_t) (bucket % LATENCY_SUB_BUCKETS);
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (power - LATENCY_SUB_BUCKET_BITS)) - 1;
+}
+
+/***** latency_record() ***
+    Adds one sample (negative durations, from clocks that disagree, count as 0)    */
+static inline void latency_record(LatencyHistogram& histogram, int64_t us) {
+    uint32_t sample = (us < 0) ? 0 : ((us > 0xFFFFFFFFLL) ? 0xFFFFFFFFu : (uint32_t) us);
+    histogram.bucket[latency_bucket(sample)]++;
+    histogram.count++;
+    if (sample > histogram.max_us) {
+        histogram.max_us = sample;
+    }
+}
+
+/***** latency_percentile() ***
+    @INPUT double fraction - 0.5 for the median, 0.99 for p99
+    @RETURN the upper edge of the bucket holding that sample (0 if there are no samples)    */
+static inline uint32_t latency_percentile(const LatencyHistogram& histogram, double fraction) {
+    if (histogram.count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t) (fraction * (histogram.count - 1)) + 1;
+    uint32_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram.bucket[bucket];
+        if (seen >= rank) {
+            uint32_t limit = latency_bucket_limit(bucket);
+            return (limit < histogram.max_us) ? limit : histogram.max_us;
+        }
+    }
+    return histogram.max_us;
+}
+
+#endif
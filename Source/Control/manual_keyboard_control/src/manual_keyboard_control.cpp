@@ -1,11 +1,17 @@
 #include "ros/ros.h"
 #include "std_msgs/String.h"
-#include <std_msgs/Int16.h>
-#include <std_msgs/Int16MultiArray.h>
 #include <keyboard/Key.h>
+#include <manual_keyboard_control/RoverCommand.h>
+#include "manual_keyboard_control.h"
+#include "arm_homing.h"
 #include <inttypes.h>
 #include <sstream>
 #include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
 
 /*
 Commands:
@@ -14,9 +20,9 @@ Commands:
   $ rostopic pub arm_cmd std_msgs/UInt16MultiArray '{data: [<servo_1>, <servo_1>, etc.]}'
 */
 
-/* Servo and DC Motor reference
+/* Servo and DC Motor reference (RoverCommand channel index)
 +---------+-------+---------------------------+
-| `-..-`  ‖  MSG  | DESCRIPTION               |
+| `-..-`  ‖  CH   | DESCRIPTION               |
 | .-``-.  ‖ INDEX |                           |
 +=========+=======+===========================+
 |         ‖   0   | Arm Base                  |
@@ -24,479 +30,588 @@ Commands:
 | Servos  ‖   2   | Arm Elbow                 |
 |         ‖   3   | Arm Wrist                 |
 +---------+-------+---------------------------+
-| Gripper ‖   4   | Gripper Rotate            |
-| Gripper ‖   5   | Gripper Claw              |
+|  Steer  ‖   4   | Back Wheel                |
+| Servos  ‖   5   | Front Right Wheel         |
+|         ‖   6   | Front Left Wheel          |
 +---------+-------+---------------------------+
-|  Drive  ‖   0   | Back Wheel                |
-| Servos  ‖   1   | Front Right Wheel         |
-|         ‖   2   | Front Left Wheel          |
+|         ‖   7   | Rear Wheel                |
+|  Drive  ‖   8   | Side Right Wheels (BOTH)  |
+|   DC    ‖   9   | Side Left Wheels (BOTH)   |
+| Motors  ‖  10   | Front Right Wheel         |
+|         ‖  11   | Front Left Wheels         |
 +---------+-------+---------------------------+
-|  Mast   ‖   0   | Mast Servo                |
+| Gripper ‖  12   | Gripper Rotate            |
+| Gripper ‖  13   | Gripper Claw              |
 +---------+-------+---------------------------+
-|         ‖   0   | Rear Wheel                |
-|  Drive  ‖   1   | Side Right Wheels (BOTH)  |
-|   DC    ‖   2   | Side Left Wheels (BOTH)   |
-| Motors  ‖   3   | Front Right Wheel         |
-|         ‖   4   | Front Left Wheels         |
+|  Mast   ‖  14   | Mast Servo                |
 +---------+-------+---------------------------+   */
 
-// Camera mast
-#define MAST               0
-// Arm servos
-#define ARM_BASE           0
-#define ARM_SHOULDER       1
-#define ARM_ELBOW          2
-#define ARM_WRIST          3
-// Arm gripper
-#define ARM_GRIPPER_ROTATE 4
-#define ARM_GRIPPER_CLAW   5
-// Steering servos
-#define STEER_BACK         0
-#define STEER_FRONT_RIGHT  1
-#define STEER_FRONT_LEFT   2
-// Drive motors
-#define DRIVE_REAR         0
-#define DRIVE_SIDE_RIGHT   1
-#define DRIVE_SIDE_LEFT    2
-#define DRIVE_FRONT_RIGHT  3
-#define DRIVE_FRONT_LEFT   4
-
-// *************************************** LIMIT VALUES *************************************** //
-#define GRIPPER_ROTATE_INCREMENT 2
-#define GRIPPER_ROTATE_MAX  90
-#define GRIPPER_ROTATE_MIN -90
-#define GRIPPER_CLAW_INCREMENT   2
-#define GRIPPER_CLAW_MAX   100
-#define GRIPPER_CLAW_MIN     0
-
-// *************************************** LIMIT VALUES *************************************** //
+// *************************************** KEY BINDINGS *************************************** //
+// One past the largest SDL 1.2 key code in keyboard/Key.msg (SDLK_LAST)
+#define KEY_CODE_COUNT 324
+
+// Operator actions (each one is bound to one or more keys by the keymap)
+enum Action {
+    ACTION_ARM_BASE_CCW,
+    ACTION_ARM_BASE_CW,
+    ACTION_ARM_SHOULDER_BACK,
+    ACTION_ARM_SHOULDER_FORWARD,
+    ACTION_ARM_ELBOW_UP,
+    ACTION_ARM_ELBOW_DOWN,
+    ACTION_ARM_WRIST_FORWARD,
+    ACTION_ARM_WRIST_BACKWARD,
+    ACTION_ARM_HOME,
+    ACTION_STEER_CCW,
+    ACTION_STEER_CW,
+    ACTION_STEER_RESET,
+    ACTION_DRIVE_FORWARD,
+    ACTION_DRIVE_BACKWARD,
+    ACTION_DRIVE_STOP,
+    ACTION_GRIPPER_OPEN,
+    ACTION_GRIPPER_CLOSE,
+    ACTION_GRIPPER_ROTATE_CW,
+    ACTION_GRIPPER_ROTATE_CCW,
+    ACTION_MAST_CW,
+    ACTION_MAST_CCW,
+    ACTION_COUNT,
+    ACTION_NONE = 0xFF
+};
+
+// Parameter name (under ~keymap/) and default key(s) of every action
+struct KeyBinding {
+    const char * name;
+    const char * default_keys;
+};
+const KeyBinding DEFAULT_KEYMAP[ACTION_COUNT] = {
+    { "arm_base_ccw",          "n"     },
+    { "arm_base_cw",           "m"     },
+    { "arm_shoulder_back",     "u"     },
+    { "arm_shoulder_forward",  "j"     },
+    { "arm_elbow_up",          "i"     },
+    { "arm_elbow_down",        "k"     },
+    { "arm_wrist_forward",     "o"     },
+    { "arm_wrist_backward",    "l"     },
+    { "arm_home",              "p"     },
+    { "steer_ccw",             "a"     },
+    { "steer_cw",              "d"     },
+    { "steer_reset",           "f"     },
+    { "drive_forward",         "w"     },
+    { "drive_backward",        "s"     },
+    { "drive_stop",            "x"     },
+    { "gripper_open",          "up"    },
+    { "gripper_close",         "down"  },
+    { "gripper_rotate_cw",     "right" },
+    { "gripper_rotate_ccw",    "left"  },
+    { "mast_cw",               "q"     },
+    { "mast_ccw",              "e"     }
+};
+
+// Names for the keys that are not a single printable character
+struct KeyName {
+    const char * name;
+    uint16_t code;
+};
+const KeyName KEY_NAMES[] = {
+    { "backspace", keyboard::Key::KEY_BACKSPACE },
+    { "tab",       keyboard::Key::KEY_TAB       },
+    { "return",    keyboard::Key::KEY_RETURN    },
+    { "escape",    keyboard::Key::KEY_ESCAPE    },
+    { "space",     keyboard::Key::KEY_SPACE     },
+    { "delete",    keyboard::Key::KEY_DELETE    },
+    { "up",        keyboard::Key::KEY_UP        },
+    { "down",      keyboard::Key::KEY_DOWN      },
+    { "right",     keyboard::Key::KEY_RIGHT     },
+    { "left",      keyboard::Key::KEY_LEFT      },
+    { "insert",    keyboard::Key::KEY_INSERT    },
+    { "home",      keyboard::Key::KEY_HOME      },
+    { "end",       keyboard::Key::KEY_END       },
+    { "pageup",    keyboard::Key::KEY_PAGEUP    },
+    { "pagedown",  keyboard::Key::KEY_PAGEDOWN  },
+    { "rshift",    keyboard::Key::KEY_RSHIFT    },
+    { "lshift",    keyboard::Key::KEY_LSHIFT    },
+    { "rctrl",     keyboard::Key::KEY_RCTRL     },
+    { "lctrl",     keyboard::Key::KEY_LCTRL     }
+};
+// *************************************** KEY BINDINGS *************************************** //
+
+// *************************************** JOINT CHANNELS *************************************** //
+// Every servo/motor value sent to the rover (same order as the RoverCommand channel array)
+enum Channel {
+    CHANNEL_ARM_BASE,
+    CHANNEL_ARM_SHOULDER,
+    CHANNEL_ARM_ELBOW,
+    CHANNEL_ARM_WRIST,
+    CHANNEL_STEER_REAR,
+    CHANNEL_STEER_FRONT_RIGHT,
+    CHANNEL_STEER_FRONT_LEFT,
+    CHANNEL_DRIVE_REAR,
+    CHANNEL_DRIVE_SIDE_RIGHT,
+    CHANNEL_DRIVE_SIDE_LEFT,
+    CHANNEL_DRIVE_FRONT_RIGHT,
+    CHANNEL_DRIVE_FRONT_LEFT,
+    CHANNEL_GRIPPER_ROTATE,
+    CHANNEL_GRIPPER_CLAW,
+    CHANNEL_MAST,
+    CHANNEL_COUNT
+};
+
+// Channels that always go out together: a change to one marks the whole group
+// dirty, so e.g. the drive motors never leave in different commands
+// (the translator hands the same groups to its output thread, see COMMAND GROUPS)
+enum ChannelGroup {
+    GROUP_ARM,
+    GROUP_STEER,
+    GROUP_DRIVE,
+    GROUP_GRIPPER,
+    GROUP_MAST,
+    GROUP_COUNT
+};
+
+// How a channel reacts to its keys
+enum ChannelMode {
+    MODE_HOLD,      // Moves at "rate" units/s while a key is held, keeps its value when released
+    MODE_MOMENTARY  // Is +/- "rate" while a key is held, 0 when released
+};
+
+// One row per channel
+struct ChannelConfig {
+    uint8_t group;        // ChannelGroup
+    uint8_t mode;         // ChannelMode
+    float   rate;         // Speed in units/s (MODE_HOLD) or output while held (MODE_MOMENTARY)
+    int16_t min;          // Lowest allowed value
+    int16_t max;          // Highest allowed value
+    uint8_t increase;     // Action that increases the value
+    uint8_t decrease;     // Action that decreases the value
+    uint8_t reset;        // Action that sets the value to 0 (ACTION_NONE if there isn't one)
+    uint8_t repeats;      // Extra times a return to 0 is sent (MODE_MOMENTARY)
+};
+
+/* Arm servo limits are the full Hitec HS-785HB range (+/-315 degrees), steering limits
+   are the range the translator can turn into a valid steering pulse (+/-95 degrees).
+   Rates match the old per-step increments at 20Hz (arm 1, gripper 2, steer 3, drive 100) */
+const ChannelConfig CHANNELS[CHANNEL_COUNT] = {
+//    group           mode            rate    min    max   increase                     decrease                    reset                repeats
+    { GROUP_ARM,      MODE_HOLD,        20,  -315,   315,  ACTION_ARM_BASE_CCW,         ACTION_ARM_BASE_CW,         ACTION_NONE,         0 },
+    { GROUP_ARM,      MODE_HOLD,        20,  -315,   315,  ACTION_ARM_SHOULDER_FORWARD, ACTION_ARM_SHOULDER_BACK,   ACTION_NONE,         0 },
+    { GROUP_ARM,      MODE_HOLD,        20,  -315,   315,  ACTION_ARM_ELBOW_UP,         ACTION_ARM_ELBOW_DOWN,      ACTION_NONE,         0 },
+    { GROUP_ARM,      MODE_HOLD,        20,  -315,   315,  ACTION_ARM_WRIST_FORWARD,    ACTION_ARM_WRIST_BACKWARD,  ACTION_NONE,         0 },
+    { GROUP_STEER,    MODE_HOLD,        60,   -95,    95,  ACTION_STEER_CCW,            ACTION_STEER_CW,            ACTION_STEER_RESET,  0 },
+    { GROUP_STEER,    MODE_HOLD,        60,   -95,    95,  ACTION_STEER_CCW,            ACTION_STEER_CW,            ACTION_STEER_RESET,  0 },
+    { GROUP_STEER,    MODE_HOLD,        60,   -95,    95,  ACTION_STEER_CCW,            ACTION_STEER_CW,            ACTION_STEER_RESET,  0 },
+    { GROUP_DRIVE,    MODE_HOLD,      2000, -2000,  2000,  ACTION_DRIVE_FORWARD,        ACTION_DRIVE_BACKWARD,      ACTION_DRIVE_STOP,   0 },
+    { GROUP_DRIVE,    MODE_HOLD,      2000, -2000,  2000,  ACTION_DRIVE_FORWARD,        ACTION_DRIVE_BACKWARD,      ACTION_DRIVE_STOP,   0 },
+    { GROUP_DRIVE,    MODE_HOLD,      2000, -2000,  2000,  ACTION_DRIVE_FORWARD,        ACTION_DRIVE_BACKWARD,      ACTION_DRIVE_STOP,   0 },
+    { GROUP_DRIVE,    MODE_HOLD,      2000, -2000,  2000,  ACTION_DRIVE_FORWARD,        ACTION_DRIVE_BACKWARD,      ACTION_DRIVE_STOP,   0 },
+    { GROUP_DRIVE,    MODE_HOLD,      2000, -2000,  2000,  ACTION_DRIVE_FORWARD,        ACTION_DRIVE_BACKWARD,      ACTION_DRIVE_STOP,   0 },
+    { GROUP_GRIPPER,  MODE_HOLD,        40,   -90,    90,  ACTION_GRIPPER_ROTATE_CCW,   ACTION_GRIPPER_ROTATE_CW,   ACTION_NONE,         0 },
+    { GROUP_GRIPPER,  MODE_HOLD,        40,     0,   100,  ACTION_GRIPPER_CLOSE,        ACTION_GRIPPER_OPEN,        ACTION_NONE,         0 },
+    { GROUP_MAST,     MODE_MOMENTARY,    5,    -5,     5,  ACTION_MAST_CW,              ACTION_MAST_CCW,            ACTION_NONE,         4 }
+};
+
+// Arm channels moved by the "return home" action (in arm_homing.h joint order)
+const uint8_t HOMING_CHANNELS[HOMING_JOINTS] = {
+    CHANNEL_ARM_BASE, CHANNEL_ARM_SHOULDER, CHANNEL_ARM_ELBOW,
+    CHANNEL_ARM_WRIST, CHANNEL_GRIPPER_ROTATE
+};
+// Return home speed limits (degrees/s) of the base, shoulder, elbow, wrist and gripper rotation
+const float HOMING_SPEED[HOMING_JOINTS] = { 40, 20, 20, 40, 40 };
+// *************************************** JOINT CHANNELS *************************************** //
+
+// Default control loop rate (Hz) and longest time step integrated at once (s).
+// A step after an idle period (or a late timer) moves as much as one 20Hz step did.
+#define DEFAULT_CONTROL_RATE 20.0
+#define STEP_DT_MAX          0.05
 
 
 // ROS variables
-ros::Publisher * arm_cmd_manual;
-ros::Publisher * steer_cmd_manual;
-ros::Publisher * drive_cmd_manual;
-ros::Publisher * mast_cmd_manual;
+ros::Publisher * rover_cmd_manual;
+RoverCommandSink rover_cmd_sink = NULL;  // Replaces rover_cmd_manual when run offline
+ros::Subscriber * sub_keydown;
+ros::Subscriber * sub_keyup;
 
+// Control loop timer (only used in event driven mode)
+ros::Timer * control_timer;
+bool EVENT_DRIVEN = true;
+double control_rate = DEFAULT_CONTROL_RATE;
+ros::Time last_step_time;
 
-// Keypresses
-std::map<uint16_t, bool> keys;
-bool CURRENT_VACUUM_STATE = false;
 
-// Arm servo array
-int16_t arm_servo[6];
-std_msgs::Int16MultiArray arm_servo_message;
-bool arm_update_needed = false;
+// Keypresses (flat tables indexed by key code, compiled from the keymap at startup)
+bool    key_held[KEY_CODE_COUNT];     // Current state of every key
+uint8_t key_action[KEY_CODE_COUNT];   // Action bound to every key (ACTION_NONE if unbound)
+uint8_t action_held[ACTION_COUNT];    // Number of held keys bound to every action
+int     actions_held = 0;             // Number of held keys bound to any action
 
-// Steer servo array
-int16_t steer_servo[3];
-std_msgs::Int16MultiArray steer_servo_message;
-bool steer_update_needed = false;
+// Channel state (indexed by Channel)
+float   channel_position[CHANNEL_COUNT]; // Integrated (unrounded) value of every channel
+int16_t channel_value[CHANNEL_COUNT];   // Current value of every channel
+int16_t channel_sent[CHANNEL_COUNT];    // Value last published for every channel
+uint8_t channel_repeat[CHANNEL_COUNT];  // Pending re-sends of every channel
+int     repeats_pending = 0;            // Total pending re-sends
+uint32_t group_channels[GROUP_COUNT];   // Channels of every group (bit i = channel i)
 
-// Drive motor array
-int16_t drive_motors[5];
-std_msgs::Int16MultiArray drive_motor_message;
-bool drive_update_needed = false;
+// Latency tracing (see RoverCommand.msg)
+uint32_t next_trace_id = 0;
+ros::Time key_stamp;     // Stamp of the last key event not yet published (zero if none)
+ros::Time input_stamp;   // When it was received
 
-// Mast servo variable
-int16_t mast_servo = 0;
-std_msgs::Int16 mast_servo_message;
-int mast_release_timeout = 0;
-bool mast_update_needed = false;
+// Return home trajectory (planned when the home key is pressed)
+HomingTrajectory homing_trajectory;
+bool  homing_active = false;
+float homing_time = 0;
 
 
-// ************************************************* KEYBOARD HANDLERS ************************************************* //
-/***** keyDown() ***
-    Changes state of a keyboard key in "keys" map to "true".
-    @INPUT keyboard::Key& - the key that was pressed    */
-void keyDown(const keyboard::Key& key) {
-    keys[key.code] = true;
-}
+void wake_control_loop();
 
-/***** keyUp() ***
-    Changes state of a keyboard key in "keys" map to "false".
-    @INPUT keyboard::Key& - the key that was released    */
-void keyUp(const keyboard::Key& key) {
-    keys[key.code] = false;
-}
 // ************************************************* KEYBOARD HANDLERS ************************************************* //
+/***** keyDown() ***
+    Marks a keyboard key (and the action bound to it) as held.
+    Unbound keys and key repeats are ignored.
+    @INPUT keyboard::Key::ConstPtr& - the key that was pressed    */
+void keyDown(const keyboard::Key::ConstPtr& key) {
+    if (key->code >= KEY_CODE_COUNT || key_held[key->code]) {
+        return;
+    }
+    key_held[key->code] = true;
 
+    uint8_t action = key_action[key->code];
+    if (action == ACTION_NONE) {
+        return;
+    }
+    action_held[action]++;
+    actions_held++;
+    key_stamp = key->header.stamp;
+    input_stamp = ros::Time::now();
 
-/***** publish_arm_servo_update() ***
-    Publishes a new angle for the specified arm servo.
-    @INPUT int servo_index - index of servo to be published     */
-void publish_arm_servo_update() {
-    arm_servo_message.data[0] = arm_servo[0];
-    arm_servo_message.data[1] = arm_servo[1];
-    arm_servo_message.data[2] = arm_servo[2];
-    arm_servo_message.data[3] = arm_servo[3];
-    arm_servo_message.data[4] = arm_servo[4];
-    arm_servo_message.data[5] = arm_servo[5];
-    arm_cmd_manual->publish(arm_servo_message);
+    if (EVENT_DRIVEN) {
+        wake_control_loop();
+    }
 }
 
-void publish_steer_servo_update() {
-    steer_servo_message.data[0] = steer_servo[0];
-    steer_servo_message.data[1] = steer_servo[1];
-    steer_servo_message.data[2] = steer_servo[2];
-    steer_cmd_manual->publish(steer_servo_message);
-}
+/***** keyUp() ***
+    Marks a keyboard key (and the action bound to it) as released.  Event
+    driven, the channels are first stepped up to the release, so the time
+    since the last step still moves them as held.
+    @INPUT keyboard::Key::ConstPtr& - the key that was released    */
+void keyUp(const keyboard::Key::ConstPtr& key) {
+    if (key->code >= KEY_CODE_COUNT || !key_held[key->code]) {
+        return;
+    }
+    key_held[key->code] = false;
 
-/***** publish_drive_motor_update() ***
-    Publishes a new angle for the specified drive servo.
-    @INPUT int servo_index - index of servo to be published     */
-void publish_drive_motor_update() {
-    drive_motor_message.data[DRIVE_REAR] = drive_motors[DRIVE_REAR];
-    drive_motor_message.data[DRIVE_SIDE_RIGHT] = drive_motors[DRIVE_SIDE_RIGHT];
-    drive_motor_message.data[DRIVE_SIDE_LEFT] = drive_motors[DRIVE_SIDE_LEFT];
-    drive_motor_message.data[DRIVE_FRONT_RIGHT] = drive_motors[DRIVE_FRONT_RIGHT];
-    drive_motor_message.data[DRIVE_FRONT_LEFT] = drive_motors[DRIVE_FRONT_LEFT];
-    drive_cmd_manual->publish(drive_motor_message);
-}
+    uint8_t action = key_action[key->code];
+    if (action == ACTION_NONE) {
+        return;
+    }
+    if (EVENT_DRIVEN) {
+        // Moves the channel up to the release while the action is still held
+        // (wake_control_loop() below then steps with the action released)
+        control_step();
+    }
+    action_held[action]--;
+    actions_held--;
+    key_stamp = key->header.stamp;
+    input_stamp = ros::Time::now();
 
-void publish_mast_servo_update() {
-    mast_servo_message.data = mast_servo;
-    mast_cmd_manual->publish(mast_servo);
+    if (EVENT_DRIVEN) {
+        wake_control_loop();
+    }
 }
+// ************************************************* KEYBOARD HANDLERS ************************************************* //
 
-/***** initialize_servos() ***
-    Initialize all message and servo arrays */
-void initialize_servos() {
-
-    // Initialize arm servo array
-    arm_servo[0] = 0;
-    arm_servo[1] = 0;
-    arm_servo[2] = 0;
-    arm_servo[3] = 0;
-    arm_servo[4] = 0;
-    arm_servo[5] = 0;
-
-	// Initialize arm servo update message array
-    arm_servo_message.data.clear();
-    arm_servo_message.data.push_back(0);
-    arm_servo_message.data.push_back(0);
-    arm_servo_message.data.push_back(0);
-    arm_servo_message.data.push_back(0);
-    arm_servo_message.data.push_back(0);
-    arm_servo_message.data.push_back(0);
-
-    // Initialize steer servo array
-    steer_servo[0] = 0;
-    steer_servo[1] = 0;
-    steer_servo[2] = 0;
-
-    // Initialize steer servo update message array
-    steer_servo_message.data.clear();
-    steer_servo_message.data.push_back(0);
-    steer_servo_message.data.push_back(0);
-    steer_servo_message.data.push_back(0);
-
-    // Initialize drive motor array
-    drive_motors[0] = 0;
-    drive_motors[1] = 0;
-    drive_motors[2] = 0;
-    drive_motors[3] = 0;
-    drive_motors[4] = 0;
-
-    // Initialize drive motor update message array
-    drive_motor_message.data.clear();
-    drive_motor_message.data.push_back(0);
-    drive_motor_message.data.push_back(0);
-    drive_motor_message.data.push_back(0);
-    drive_motor_message.data.push_back(0);
-    drive_motor_message.data.push_back(0);
-}
 
-/***** initialize_key_states() ***
-    Initialize default key press states */
-void initialize_key_states() {
-    // Arm
-    keys[keyboard::Key::KEY_n] = false; // Base CCW
-    keys[keyboard::Key::KEY_m] = false; // Base CW
-    keys[keyboard::Key::KEY_u] = false; // Shoulder back
-    keys[keyboard::Key::KEY_j] = false; // Shoulder forward
-    keys[keyboard::Key::KEY_i] = false; // Elbow up
-    keys[keyboard::Key::KEY_k] = false; // Elbow down
-    keys[keyboard::Key::KEY_o] = false; // Wrist forward
-    keys[keyboard::Key::KEY_l] = false; // Wrist backward
-    keys[keyboard::Key::KEY_p] = false; // Return home 
-
-    // Steering
-    keys[keyboard::Key::KEY_a] = false; // Steer CCW
-    keys[keyboard::Key::KEY_d] = false; // Steer CW
-    keys[keyboard::Key::KEY_f] = false; // Steer reset (straight ahead)
-
-    // Motors
-    keys[keyboard::Key::KEY_w] = false; // Drive forward
-    keys[keyboard::Key::KEY_s] = false; // Drive backward
-    keys[keyboard::Key::KEY_x] = false; // Stop motors
-
-    // Gripper
-    keys[keyboard::Key::KEY_UP]    = false;    // Gripper Open
-    keys[keyboard::Key::KEY_DOWN]  = false;  // Gripper Close
-    keys[keyboard::Key::KEY_RIGHT] = false; // Gripper Rotate CW
-    keys[keyboard::Key::KEY_LEFT]  = false;  // Gripper Rotate CCW
-
-    // Mast
-    keys[keyboard::Key::KEY_q]  = false;  // Mast Rotate CW
-    keys[keyboard::Key::KEY_e]  = false;  // Mast Rotate CCW
+/***** publish_rover_command() ***
+    Publishes the current value of every channel in a single command.
+    A new message is allocated for every command and published by pointer,
+    so a translator nodelet in the same manager receives it without copying
+    (the message must not be touched after it is published).
+    The first command after a key event carries that event's stamps.
+    @INPUT uint32_t dirty_mask - channels of the groups that changed (bit i = channel i)
+    @INPUT ros::Time step_stamp - when the control step started     */
+void publish_rover_command(uint32_t dirty_mask, const ros::Time& step_stamp) {
+    manual_keyboard_control::RoverCommandPtr message(new manual_keyboard_control::RoverCommand());
+    message->trace_id = next_trace_id++;
+    message->key_stamp = key_stamp;
+    message->input_stamp = key_stamp.isZero() ? step_stamp : input_stamp;
+    message->header.stamp = ros::Time::now();
+    message->dirty_mask = dirty_mask;
+    for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+        message->channel[channel] = channel_value[channel];
+        channel_sent[channel] = channel_value[channel];
+    }
+    if (rover_cmd_sink != NULL) {
+        rover_cmd_sink(message);
+    } else {
+        rover_cmd_manual->publish(message);
+    }
 }
 
+/***** initialize_channels() ***
+    Initialize all channel values */
+void initialize_channels() {
+    for (int group = 0; group < GROUP_COUNT; group++) {
+        group_channels[group] = 0;
+    }
+    for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+        channel_position[channel] = 0;
+        channel_value[channel]  = 0;
+        channel_sent[channel]   = 0;
+        channel_repeat[channel] = 0;
+        group_channels[CHANNELS[channel].group] |= 1u << channel;
+    }
+    repeats_pending = 0;
+}
 
-int main(int argc, char **argv) {
-    // Initialize ROS elements
-    ros::init(argc, argv, "manual_keyboard_control");
-    ros::NodeHandle n;  
-    ros::Rate loop_rate(20);
-
-    // Publishers for sending commands to motor controller
-	arm_cmd_manual = new ros::Publisher();
-    steer_cmd_manual = new ros::Publisher();
-	drive_cmd_manual = new ros::Publisher();
-    mast_cmd_manual = new ros::Publisher();
-
-    *arm_cmd_manual = n.advertise<std_msgs::Int16MultiArray>("arm_cmd_manual", 1000);
-    *steer_cmd_manual = n.advertise<std_msgs::Int16MultiArray>("steer_cmd_manual", 1000);
-    *drive_cmd_manual = n.advertise<std_msgs::Int16MultiArray>("drive_cmd_manual", 1000);
-    *mast_cmd_manual = n.advertise<std_msgs::Int16>("mast_cmd_manual", 1000);
-    
-    // Keyboard subscribers
-    ros::Subscriber keydown = n.subscribe("keyboard/keydown", 10, keyDown);
-    ros::Subscriber keyup = n.subscribe("keyboard/keyup", 10, keyUp);
-
-    // Other Initialization code
-    initialize_servos();      
-    initialize_key_states();
-
-    std::cout << "STARTED PWM PUBLISHER!!!" << std::endl;
-
-    while (ros::ok())
-    {
-        // Arm home (p)
-        if (keys[keyboard::Key::KEY_p]) {
-            int target_angle = 0;
-            int angle_delta = 0;
-
-            // For each arm servo
-            for (int i = 0; i < 6; i++) {
-                // If the shoulder is extended and the wrist is not brought in
-                // then bring in the wrist (to reduce strain on shoulder servo)
-                //      Which means if the current servo is not the wrist, skip it
-                //      unless the wrist is retracted!
-                if (arm_servo[ARM_SHOULDER] > 55 && arm_servo[ARM_WRIST] != -40 && i != ARM_WRIST) {
-                    continue;
-                }
-
-                if (i == ARM_BASE && arm_servo[ARM_BASE] != 0 && arm_servo[ARM_SHOULDER] == 30) {
-                    // If current servo is the base, and the base is not at 0 degrees,
-                    // and the should is currently at 30 degrees (to avoid hitting things)
-                    // then set the base target angle to 0 degrees
-                    target_angle = 0;
-                } else if (i == ARM_SHOULDER && arm_servo[ARM_BASE] != 0) {
-                    // If the current servo is the shoulder, and the base is not 0 degrees,
-                    // set the shoulder target angle to 30 degrees.
-                    target_angle = 30;
-                } else if (i == ARM_ELBOW && (arm_servo[ARM_BASE] != 0 || arm_servo[ARM_SHOULDER] > 20)) {
-                    // If the current servo is the elbow, and either the base is not at 0 or the
-                    // shoulder is bigger than 20 degrees, set the target angle for the elbow 
-                    // to whatever the shoulder is plus 30 degrees (to avoid collisions)
-                    target_angle = arm_servo[ARM_SHOULDER] + 30;
-                } else if (i == ARM_WRIST && arm_servo[ARM_SHOULDER] > 50) {
-                    // If the current servo is the wrist, and the shoulder is at more than
-                    // 50 degrees, set the wrist angle to -40
-                    target_angle = 0;
-                } else if (i == ARM_GRIPPER_ROTATE) {
-                    target_angle = 0;
-                } else if (i == ARM_GRIPPER_CLAW) {
-                    continue;
-                } else {
-                    // Otherwise set the target angle to "home" (ie 0 degrees)
-                    target_angle = 0;
-                }
-
-                // Save change in angle
-                if (arm_servo[i] < target_angle) {
-                    angle_delta = 1;
-                } else if (arm_servo[i] > target_angle) {
-                    angle_delta = -1;
-                } else {
-                    angle_delta = 0;
-                }
-
-                // Double speed base, wrist gripper rotate or gripper claw
-                if (i == ARM_BASE || i == ARM_WRIST || i == ARM_GRIPPER_ROTATE || i == ARM_GRIPPER_CLAW) {
-                    if (arm_servo[i] - 1 != 0 && arm_servo[i] + 1 != 0) {
-                        angle_delta *= 2;
-                    }
-                }
-
-                // Publish change in angle
-                arm_servo[i] += angle_delta;
-            }
-            arm_update_needed = true;
+/***** parse_key_name() ***
+    Converts a key name from the keymap into a key code.
+    Accepts a single printable character ("w", "5", "["), one of the names in
+    KEY_NAMES ("up", "space"), "kp0" to "kp9", "f1" to "f12", or a raw code ("#273").
+    @INPUT const std::string& name - key name
+    @INPUT uint16_t& code - set to the key code
+    @RETURN bool - true if the name is a valid key    */
+bool parse_key_name(const std::string& name, uint16_t& code) {
+    if (name.size() == 1 && 32 < name[0] && name[0] < 127) {
+        // SDL key codes of printable keys are their (lower case) ASCII values
+        code = (uint16_t) tolower(name[0]);
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]); i++) {
+        if (name == KEY_NAMES[i].name) {
+            code = KEY_NAMES[i].code;
+            return true;
         }
+    }
 
-        // Arm base (m and n)
-        if (keys[keyboard::Key::KEY_n]) {
-            arm_servo[ARM_BASE] += 1;
-            arm_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_m]) {
-            arm_servo[ARM_BASE] -= 1;
-            arm_update_needed = true;
+    char * end = NULL;
+    long number = 0;
+    if (name.size() == 3 && name.compare(0, 2, "kp") == 0 && isdigit(name[2])) {
+        code = keyboard::Key::KEY_KP0 + (name[2] - '0');
+        return true;
+    } else if (name.size() > 1 && name[0] == 'f') {
+        number = strtol(name.c_str() + 1, &end, 10);
+        if (*end == '\0' && 1 <= number && number <= 12) {
+            code = keyboard::Key::KEY_F1 + (number - 1);
+            return true;
         }
-
-        // Arm shoulder (j and u)
-        if (keys[keyboard::Key::KEY_j]) {
-            arm_servo[ARM_SHOULDER] += 1;
-            arm_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_u]) {
-            arm_servo[ARM_SHOULDER] -= 1;
-            arm_update_needed = true;
+    } else if (name.size() > 1 && name[0] == '#') {
+        number = strtol(name.c_str() + 1, &end, 10);
+        if (*end == '\0' && 0 < number && number < KEY_CODE_COUNT) {
+            code = (uint16_t) number;
+            return true;
         }
+    }
+    return false;
+}
 
-        // Arm elbow (i and k)
-        if (keys[keyboard::Key::KEY_i]) {
-            arm_servo[ARM_ELBOW] += 1;
-            arm_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_k]) {
-            arm_servo[ARM_ELBOW] -= 1;
-            arm_update_needed = true;
+/***** compile_keymap() ***
+    Builds the key code -> action dispatch table from the "~keymap" parameters.
+    Each parameter is a space separated list of key names, e.g.
+        ~keymap/drive_forward: "w up"
+    Actions without a parameter keep the keys in DEFAULT_KEYMAP.
+    @INPUT ros::NodeHandle* pn - private node handle (NULL = DEFAULT_KEYMAP only)    */
+void compile_keymap(ros::NodeHandle* pn) {
+    memset(key_held, 0, sizeof(key_held));
+    memset(key_action, ACTION_NONE, sizeof(key_action));
+    memset(action_held, 0, sizeof(action_held));
+    actions_held = 0;
+
+    for (int action = 0; action < ACTION_COUNT; action++) {
+        std::string key_list = DEFAULT_KEYMAP[action].default_keys;
+        if (pn != NULL) {
+            pn->param<std::string>(std::string("keymap/") + DEFAULT_KEYMAP[action].name,
+                key_list, DEFAULT_KEYMAP[action].default_keys);
         }
 
-        // Arm wrist (o and l)
-        if (keys[keyboard::Key::KEY_o]) {
-            arm_servo[ARM_WRIST] += 1;
-            arm_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_l]) {
-            arm_servo[ARM_WRIST] -= 1;
-            arm_update_needed = true;
-        }
-        
-        // Arm gripper rotate (left arrow and right arrow)
-        if (keys[keyboard::Key::KEY_LEFT]) {
-            if (arm_servo[ARM_GRIPPER_ROTATE] + GRIPPER_ROTATE_INCREMENT >= GRIPPER_ROTATE_MAX) {
-                arm_servo[ARM_GRIPPER_ROTATE] = GRIPPER_ROTATE_MAX;
-            } else {
-                arm_servo[ARM_GRIPPER_ROTATE] += GRIPPER_ROTATE_INCREMENT;
+        std::istringstream names(key_list);
+        std::string name;
+        while (names >> name) {
+            uint16_t code;
+            if (!parse_key_name(name, code)) {
+                ROS_WARN("keymap/%s: unknown key \"%s\"", DEFAULT_KEYMAP[action].name, name.c_str());
+                continue;
             }
-            arm_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_RIGHT]) {
-            if (arm_servo[ARM_GRIPPER_ROTATE] - GRIPPER_ROTATE_INCREMENT <= GRIPPER_ROTATE_MIN) {
-                arm_servo[ARM_GRIPPER_ROTATE] = GRIPPER_ROTATE_MIN;
-            } else {
-                arm_servo[ARM_GRIPPER_ROTATE] -= GRIPPER_ROTATE_INCREMENT;
+            if (key_action[code] != ACTION_NONE) {
+                ROS_WARN("keymap/%s: key \"%s\" was already bound to %s", DEFAULT_KEYMAP[action].name,
+                    name.c_str(), DEFAULT_KEYMAP[key_action[code]].name);
             }
-            arm_update_needed = true;
+            key_action[code] = (uint8_t) action;
         }
+    }
+}
 
-        // Arm gripper rotate (up arrow and down arrow)
-        if (keys[keyboard::Key::KEY_UP]) {
-            // OPEN GRIPPER
-            if (arm_servo[ARM_GRIPPER_CLAW] - GRIPPER_CLAW_INCREMENT <= GRIPPER_CLAW_MIN) {
-                arm_servo[ARM_GRIPPER_CLAW] = GRIPPER_CLAW_MIN;
-            } else {
-                arm_servo[ARM_GRIPPER_CLAW] -= GRIPPER_CLAW_INCREMENT;
-            }
-            arm_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_DOWN]) {
-            // CLOSE GRIPPER
-            if (arm_servo[ARM_GRIPPER_CLAW] + GRIPPER_CLAW_INCREMENT >= GRIPPER_CLAW_MAX) {
-                arm_servo[ARM_GRIPPER_CLAW] = GRIPPER_CLAW_MAX;
-            } else {
-                arm_servo[ARM_GRIPPER_CLAW] += GRIPPER_CLAW_INCREMENT;
+
+/***** control_step() ***
+    Reads the current key states, integrates every channel over the time since
+    the last step in one pass over the channel table and publishes a command
+    if any (rounded) value changed.  */
+void control_step() {
+    // Time since the last step (a step after an idle period moves one 20Hz step's worth)
+    ros::Time now = ros::Time::now();
+    float dt = STEP_DT_MAX;
+    if (!last_step_time.isZero()) {
+        dt = std::max(0.0, std::min((now - last_step_time).toSec(), STEP_DT_MAX));
+    }
+    last_step_time = now;
+
+    // Arm home: plan a trajectory when the key is pressed, then follow it while it is held
+    if (action_held[ACTION_ARM_HOME]) {
+        float pose[HOMING_JOINTS];
+        if (!homing_active) {
+            for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+                pose[joint] = channel_position[HOMING_CHANNELS[joint]];
             }
-            arm_update_needed = true;
+            plan_arm_homing(pose, HOMING_SPEED, homing_trajectory);
+            homing_active = true;
+            homing_time = 0;
         }
 
-        // Steering (a and d and f)
-        // q = CCW; e = cw
-        if (keys[keyboard::Key::KEY_a]) {
-            steer_servo[STEER_BACK] += 3;
-            steer_servo[STEER_FRONT_RIGHT] += 3;
-            steer_servo[STEER_FRONT_LEFT] += 3;
-            steer_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_d]) {
-            steer_servo[STEER_BACK] -= 3;
-            steer_servo[STEER_FRONT_RIGHT] -= 3;
-            steer_servo[STEER_FRONT_LEFT] -= 3;
-            steer_update_needed = true;
-        }
-	    if (keys[keyboard::Key::KEY_f]) {
-            steer_servo[STEER_BACK] = 0;
-            steer_servo[STEER_FRONT_RIGHT] = 0;
-            steer_servo[STEER_FRONT_LEFT] = 0;
-            steer_update_needed = true;
+        homing_time += dt;
+        sample_arm_homing(homing_trajectory, homing_time, pose);
+        for (int joint = 0; joint < HOMING_JOINTS; joint++) {
+            channel_position[HOMING_CHANNELS[joint]] = pose[joint];
         }
+    } else {
+        homing_active = false;
+    }
 
-        // Drive motors (w and s and x)
-        if (keys[keyboard::Key::KEY_w]) {
-            (drive_motors[DRIVE_REAR] < 2000) ? drive_motors[DRIVE_REAR] += 100 : drive_motors[DRIVE_REAR] = 2000;
-            (drive_motors[DRIVE_SIDE_RIGHT] < 2000) ? drive_motors[DRIVE_SIDE_RIGHT] += 100 : drive_motors[DRIVE_SIDE_RIGHT] = 2000;
-            (drive_motors[DRIVE_SIDE_LEFT] < 2000) ? drive_motors[DRIVE_SIDE_LEFT] += 100 : drive_motors[DRIVE_SIDE_LEFT] = 2000;
-            (drive_motors[DRIVE_FRONT_RIGHT] < 2000) ? drive_motors[DRIVE_FRONT_RIGHT] += 100 : drive_motors[DRIVE_FRONT_RIGHT] = 2000;
-            (drive_motors[DRIVE_FRONT_LEFT] < 2000) ? drive_motors[DRIVE_FRONT_LEFT] += 100 : drive_motors[DRIVE_FRONT_LEFT] = 2000;
-            drive_update_needed = true;
-        } else if (keys[keyboard::Key::KEY_s]) {
-            (drive_motors[DRIVE_REAR] > -2000) ? drive_motors[DRIVE_REAR] -= 100 : drive_motors[DRIVE_REAR] = -2000;
-            (drive_motors[DRIVE_SIDE_RIGHT] > -2000) ? drive_motors[DRIVE_SIDE_RIGHT] -= 100 : drive_motors[DRIVE_SIDE_RIGHT] = -2000;
-            (drive_motors[DRIVE_SIDE_LEFT] > -2000) ? drive_motors[DRIVE_SIDE_LEFT] -= 100 : drive_motors[DRIVE_SIDE_LEFT] = -2000;
-            (drive_motors[DRIVE_FRONT_LEFT] > -2000) ? drive_motors[DRIVE_FRONT_RIGHT] -= 100 : drive_motors[DRIVE_FRONT_RIGHT] = -2000;
-            (drive_motors[DRIVE_FRONT_LEFT] > -2000) ? drive_motors[DRIVE_FRONT_LEFT] -= 100 : drive_motors[DRIVE_FRONT_LEFT] = -2000;
-            drive_update_needed = true;
+    // Every channel bound to a key
+    uint32_t dirty_groups = 0;
+    for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+        const ChannelConfig& config = CHANNELS[channel];
+        int direction = action_held[config.increase] ? 1 : (action_held[config.decrease] ? -1 : 0);
+        float position = channel_position[channel];
+
+        if (config.mode == MODE_HOLD) {
+            position += direction * config.rate * dt;
+        } else {
+            position = direction * config.rate;
         }
-		if (keys[keyboard::Key::KEY_x]) {
-            drive_motors[DRIVE_REAR] = 0;
-            drive_motors[DRIVE_SIDE_RIGHT] = 0;
-            drive_motors[DRIVE_SIDE_LEFT] = 0;
-            drive_motors[DRIVE_FRONT_RIGHT] = 0;
-            drive_motors[DRIVE_FRONT_LEFT] = 0;
-            drive_update_needed = true;
+        if (config.reset != ACTION_NONE && action_held[config.reset]) {
+            position = 0;
         }
-
-        // Mast Servo (q & w)
-        if (keys[keyboard::Key::KEY_q]) {
-            mast_servo = 5;
-            if (0 < mast_release_timeout) {
-                // If the mast was not previously moving
-                mast_release_timeout = 0;
-                mast_update_needed = true;
-            }
-        } else if (keys[keyboard::Key::KEY_e]) {
-            mast_servo = -5;
-            if (0 < mast_release_timeout) {
-                // If the mast was not previously moving
-                mast_release_timeout = 0;
-                mast_update_needed = true;
+        position = (position < config.min) ? config.min : ((position > config.max) ? config.max : position);
+        channel_position[channel] = position;
+        int16_t value = (int16_t) lroundf(position);
+
+        // Momentary channels re-send their return to 0 a few times
+        if (config.mode == MODE_MOMENTARY) {
+            uint8_t repeat = channel_repeat[channel];
+            if (value != 0) {
+                repeat = 0;
+            } else if (channel_sent[channel] != 0) {
+                repeat = config.repeats;
             }
-        } else if (mast_release_timeout < 5) {
-            // Only execute this code if mast was previously moving
-            mast_release_timeout++;
-            mast_servo = 0;
-            mast_update_needed = true;
+            repeats_pending += repeat - channel_repeat[channel];
+            channel_repeat[channel] = repeat;
         }
 
-        // Check if comamnd updates are needed
-        if (arm_update_needed) {
-            arm_update_needed = false;
-            publish_arm_servo_update();
-        }
-        if (steer_update_needed) {
-            steer_update_needed = false;
-            publish_steer_servo_update();
+        channel_value[channel] = value;
+        if (channel_value[channel] != channel_sent[channel]) {
+            dirty_groups |= 1u << config.group;
+        } else if (channel_repeat[channel] > 0) {
+            channel_repeat[channel]--;
+            repeats_pending--;
+            dirty_groups |= 1u << config.group;
         }
-        if (drive_update_needed) {
-            drive_update_needed = false;
-            publish_drive_motor_update();
-        }
-        if (mast_update_needed) {
-            mast_update_needed = false;
-            publish_mast_servo_update();
+    }
+
+    // Publish everything in one command if anything changed, with every
+    // channel of a changed group marked dirty
+    uint32_t dirty_mask = 0;
+    for (int group = 0; group < GROUP_COUNT; group++) {
+        if (dirty_groups & (1u << group)) {
+            dirty_mask |= group_channels[group];
         }
+    }
+    if (dirty_mask != 0) {
+        publish_rover_command(dirty_mask, now);
+    }
+    // A key event that changed nothing is not traced by a later command
+    key_stamp = ros::Time();
+}
 
-        // 
-        ros::spinOnce();
-        loop_rate.sleep();
+/***** control_active() ***
+    Returns true while any key is held or a momentary channel (the mast)
+    is still re-sending its release (stop) command.   */
+bool control_active() {
+    return actions_held > 0 || repeats_pending > 0;
+}
+
+/***** wake_control_loop() ***
+    Runs a control step as soon as a key changes state, then re-arms the
+    control timer so held keys keep repeating at control_rate.  The timer is
+    left stopped when nothing is held, so an idle rover publishes nothing.
+    Offline there is no timer: the caller runs control_step() itself.   */
+void wake_control_loop() {
+    control_step();
+    if (control_timer == NULL) {
+        return;
+    }
+    control_timer->stop();
+    if (control_active()) {
+        control_timer->start();
     }
+}
+
+/***** control_timer_callback() ***
+    Runs the control step at control_rate.  In event driven mode this only
+    happens while keys are held, in polling mode it never stops.  */
+void control_timer_callback(const ros::TimerEvent&) {
+    control_step();
+    if (EVENT_DRIVEN && !control_active()) {
+        control_timer->stop();
+    }
+}
+
+
+/***** start_manual_keyboard_control() ***
+    Creates the publisher, keyboard subscribers and control timer, and loads
+    the parameters and keymap.  Everything after this runs from callbacks,
+    so the same code is used by the standalone node and the nodelet.
+    @INPUT ros::NodeHandle& n  - node handle for the topics
+    @INPUT ros::NodeHandle& pn - private node handle for the parameters    */
+void start_manual_keyboard_control(ros::NodeHandle& n, ros::NodeHandle& pn) {
+    // Event driven (publish on key change) or fixed rate polling
+    pn.param<bool>("event_driven", EVENT_DRIVEN, true);
+    // Control steps per second (while keys are held in event driven mode)
+    pn.param<double>("control_rate", control_rate, DEFAULT_CONTROL_RATE);
+
+    // Publisher for sending commands to motor controller
+    rover_cmd_manual = new ros::Publisher();
+    *rover_cmd_manual = n.advertise<manual_keyboard_control::RoverCommand>("rover_cmd_manual", 1000);
+
+    // Keyboard subscribers
+    sub_keydown = new ros::Subscriber();
+    sub_keyup = new ros::Subscriber();
+    *sub_keydown = n.subscribe("keyboard/keydown", 10, keyDown);
+    *sub_keyup = n.subscribe("keyboard/keyup", 10, keyUp);
+
+    // Other Initialization code
+    initialize_channels();
+    compile_keymap(&pn);
+
+    // Event driven: control steps are run from the keyboard callbacks and the hold timer (stopped until a key is pressed)
+    // Polling: control steps are run from the timer alone
+    control_timer = new ros::Timer();
+    *control_timer = n.createTimer(ros::Duration(1.0 / control_rate), control_timer_callback, false, !EVENT_DRIVEN);
+
+    std::cout << "STARTED PWM PUBLISHER!!!" << std::endl;
+}
 
-    return 0;
+/***** start_manual_keyboard_control_offline() ***
+    Sets the teleop up without a node (see manual_keyboard_control.h)
+    @INPUT RoverCommandSink sink - gets every command
+    @INPUT bool event_driven - see ~event_driven
+    @INPUT double rate - see ~control_rate (the caller's step rate)    */
+void start_manual_keyboard_control_offline(RoverCommandSink sink, bool event_driven, double rate) {
+    EVENT_DRIVEN = event_driven;
+    control_rate = rate;
+    rover_cmd_sink = sink;
+    control_timer = NULL;
+    last_step_time = ros::Time();
+    key_stamp = ros::Time();
+    next_trace_id = 0;
+    homing_active = false;
+    initialize_channels();
+    compile_keymap(NULL);
 }
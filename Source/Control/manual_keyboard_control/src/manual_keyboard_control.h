@@ -0,0 +1,32 @@
+#ifndef MANUAL_KEYBOARD_CONTROL_H
+#define MANUAL_KEYBOARD_CONTROL_H
+
+#include "ros/ros.h"
+#include <keyboard/Key.h>
+#include <manual_keyboard_control/RoverCommand.h>
+
+/* Keyboard teleop
+
+  Turns keyboard/keydown and keyboard/keyup into RoverCommand messages on
+  rover_cmd_manual.  Used by manual_keyboard_control_node.cpp (standalone
+  node) and nodelets.cpp (ManualKeyboardControlNodelet).  The teleop keeps
+  its state in globals, so only one can be loaded per process.
+*/
+
+void start_manual_keyboard_control(ros::NodeHandle& n, ros::NodeHandle& pn);
+
+/* Offline use (teleop_benchmark.cpp): no node, timer or parameters (the
+  default keymap).  Every command goes to the sink instead of
+  rover_cmd_manual, key events are passed to keyDown()/keyUp() and the
+  caller runs control_step() at the control rate while control_active()
+  (always, when not event driven), setting ros::Time to its simulated clock. */
+typedef void (*RoverCommandSink)(const manual_keyboard_control::RoverCommandPtr& message);
+
+void start_manual_keyboard_control_offline(RoverCommandSink sink, bool event_driven, double rate);
+void keyDown(const keyboard::Key::ConstPtr& key);
+void keyUp(const keyboard::Key::ConstPtr& key);
+void control_step();
+bool control_active();
+bool parse_key_name(const std::string& name, uint16_t& code);  // As in the keymap
+
+#endif
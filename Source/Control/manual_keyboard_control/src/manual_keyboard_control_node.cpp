@@ -0,0 +1,16 @@
+#include "ros/ros.h"
+#include "manual_keyboard_control.h"
+
+/* Standalone keyboard teleop node (see nodelets.cpp for the nodelet) */
+int main(int argc, char **argv) {
+    // Initialize ROS elements
+    ros::init(argc, argv, "manual_keyboard_control");
+    ros::NodeHandle n;
+    ros::NodeHandle pn("~");
+
+    start_manual_keyboard_control(n, pn);
+
+    ros::spin();
+
+    return 0;
+}
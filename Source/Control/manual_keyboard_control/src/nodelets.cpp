@@ -0,0 +1,34 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include "manual_keyboard_control.h"
+#include "arduino_command_translator.h"
+
+/* Nodelet versions of the keyboard teleop and the PWM translator
+
+  Loading both (and the keyboard nodelet) into one nodelet manager lets the
+  key events, RoverCommand and arduino_cmd messages be passed by pointer
+  instead of being serialized over loopback TCPROS.  getNodeHandle() uses the
+  manager's single threaded queue, so the callbacks of the teleop never run
+  at the same time (the code keeps its state in globals).  The translator
+  hands its commands to its output thread through lock-free slots, so it
+  uses the manager's multi threaded queue instead.
+*/
+
+namespace manual_keyboard_control {
+
+class ManualKeyboardControlNodelet : public nodelet::Nodelet {
+    virtual void onInit() {
+        start_manual_keyboard_control(getNodeHandle(), getPrivateNodeHandle());
+    }
+};
+
+class ArduinoCommandTranslatorNodelet : public nodelet::Nodelet {
+    virtual void onInit() {
+        start_arduino_command_translator(getMTNodeHandle(), getMTPrivateNodeHandle());
+    }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(manual_keyboard_control::ManualKeyboardControlNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(manual_keyboard_control::ArduinoCommandTranslatorNodelet, nodelet::Nodelet)
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "pulse_tables.h"
+#include "calibration.h"
+
+/*----------    P U L S E   T A B L E   B E N C H M A R K    ----------
+  Checks that the lookup tables in pulse_tables.h give the same pulses as
+  the conversion functions the translator used before them, then times
+  both over the same inputs.
+
+  $ rosrun manual_keyboard_control pulse_table_benchmark [calibration file]
+
+  Also checks that the tables built at run time from the default calibration
+  (and from the calibration file, if given) match the compile time tables.
+
+  Exits with 1 if any pulse differs.  Inputs where the old angle_to_pulse()
+  wrapped a negative pulse around to 65xxx are skipped (and counted), since
+  the tables deliberately clamp those to the servo minimum instead.
+*/
+
+#define BENCHMARK_PASSES 2000
+
+//----------  O L D   C O N V E R S I O N S  ---------
+// # Copied from arduino_command_translator.cpp before the lookup tables
+uint16_t angle_to_pulse(int int_angle, int servo_neutral, int servo_full_turn, int servo_min, int servo_max) {
+  // Typecast angle to double to prevent overflow
+  double angle = int_angle * 1.0;
+  uint16_t pulse = (uint16_t) (servo_neutral + (((long)angle*(long)servo_full_turn)/360));
+  // Check if within range
+  if (pulse < servo_min) {
+    pulse = (uint16_t) servo_min;
+  } else if (pulse > servo_max) {
+    pulse = (uint16_t) servo_max;
+  }
+  return pulse;
+}
+uint16_t arm_angle_to_pulse(int int_angle) {
+  return angle_to_pulse(int_angle, ARM_PWM_NEUTRAL,
+    ARM_PWM_360_DEGREES, ARM_PWM_MIN, ARM_PWM_MAX);
+}
+uint16_t steer_angle_to_pulse(int int_angle) {
+  return angle_to_pulse(int_angle, STEER_PWM_NEUTRAL,
+    STEER_PWM_360_DEGREES, STEER_PWM_MIN, STEER_PWM_MAX);
+}
+uint16_t gripper_angle_to_pulse(int int_angle) {
+  return angle_to_pulse(int_angle,
+    GRIPPER_ROTATE_PWM_NEUTRAL, GRIPPER_ROTATE_PWM_360_DEGREES,
+    GRIPPER_ROTATE_PWM_MIN, GRIPPER_ROTATE_PWM_MAX);
+}
+uint16_t gripper_claw_to_pulse(int int_claw) {
+  return GRIPPER_CLAW_PWM_OPEN - (
+        (int_claw*1.0)/GRIPPER_CLAW_CONSTANT) *
+        (GRIPPER_CLAW_PWM_OPEN - GRIPPER_CLAW_PWM_CLOSED);
+}
+uint16_t drive_speed_to_pulse(int int_speed) {
+  // Typecast angle to double to prevent overflow
+  double speed = int_speed * 1.0;
+  uint16_t pulse;
+  if (int_speed < 0) {
+    speed = NEUTRAL_SPEED_PWM + (speed / 2000) * (NEUTRAL_SPEED_PWM - MAX_REVERSE_SPEED_PWM);
+  } else if (int_speed > 0) {
+    speed = NEUTRAL_SPEED_PWM + (speed / 2000) * (MAX_FORWARD_SPEED_PWM - NEUTRAL_SPEED_PWM);
+  } else {
+    speed = NEUTRAL_SPEED_PWM;
+  }
+  pulse = (uint16_t) speed;
+  return pulse;
+}
+uint16_t mast_speed_to_pulse(int int_speed) {
+  return MAST_SERVO_PWM_IMMOBILE + int_speed;
+}
+
+/***** old_convert_channels() ###
+  The old per channel conversion (same signs as the old callbacks)
+*/
+void old_convert_channels(const int16_t * value, uint16_t * pulse) {
+  for (int channel = 0; channel < 4; channel++) {
+    pulse[channel] = arm_angle_to_pulse(value[channel]);
+  }
+  pulse[4] = steer_angle_to_pulse(-value[4]);
+  pulse[5] = steer_angle_to_pulse(value[5]);
+  pulse[6] = steer_angle_to_pulse(value[6]);
+  pulse[7] = drive_speed_to_pulse(-value[7]);
+  for (int channel = 8; channel < 12; channel++) {
+    pulse[channel] = drive_speed_to_pulse(value[channel]);
+  }
+  pulse[12] = gripper_angle_to_pulse(value[12]);
+  pulse[13] = gripper_claw_to_pulse(value[13]);
+  pulse[14] = mast_speed_to_pulse(value[14]);
+}
+
+
+//----------  C O M P A R I S O N  ---------
+// # Old conversion and table domain of every channel
+struct ChannelCheck {
+  const char * name;
+  int min, max;
+};
+
+const ChannelCheck CHANNEL_CHECKS[PULSE_CHANNEL_COUNT] = {
+  { "arm base",          ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "arm shoulder",      ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "arm elbow",         ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "arm wrist",         ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "steer rear",        ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "steer front right", ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "steer front left",  ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "drive rear",        DRIVE_TABLE_MIN, DRIVE_TABLE_MAX },
+  { "drive side right",  DRIVE_TABLE_MIN, DRIVE_TABLE_MAX },
+  { "drive side left",   DRIVE_TABLE_MIN, DRIVE_TABLE_MAX },
+  { "drive front right", DRIVE_TABLE_MIN, DRIVE_TABLE_MAX },
+  { "drive front left",  DRIVE_TABLE_MIN, DRIVE_TABLE_MAX },
+  { "gripper rotate",    ANGLE_TABLE_MIN, ANGLE_TABLE_MAX },
+  { "gripper claw",      CLAW_TABLE_MIN,  CLAW_TABLE_MAX  },
+  { "mast",              MAST_TABLE_MIN,  MAST_TABLE_MAX  }
+};
+
+/***** wraps() ###
+  True if the old angle_to_pulse() wraps the pulse of this input around
+*/
+bool wraps(int channel, int value) {
+  int sign = CHANNEL_TABLES[channel].sign;
+  switch (channel) {
+    case 0: case 1: case 2: case 3:
+      return ARM_PWM_NEUTRAL + ((long)value * sign * ARM_PWM_360_DEGREES) / 360 < 0;
+    case 4: case 5: case 6:
+      return STEER_PWM_NEUTRAL + ((long)value * sign * STEER_PWM_360_DEGREES) / 360 < 0;
+    case 12:
+      return GRIPPER_ROTATE_PWM_NEUTRAL + ((long)value * GRIPPER_ROTATE_PWM_360_DEGREES) / 360 < 0;
+    default:
+      return false;
+  }
+}
+
+/***** compare_tables() ###
+  Returns the number of inputs where the tables and the old conversions differ
+*/
+int compare_tables() {
+  int mismatches = 0;
+  int skipped = 0;
+  for (int channel = 0; channel < PULSE_CHANNEL_COUNT; channel++) {
+    const ChannelCheck& check = CHANNEL_CHECKS[channel];
+    for (int value = check.min; value <= check.max; value++) {
+      if (wraps(channel, value)) {
+        skipped++;
+        continue;
+      }
+      int16_t values[PULSE_CHANNEL_COUNT] = { 0 };
+      uint16_t old_pulse[PULSE_CHANNEL_COUNT];
+      values[channel] = value;
+      old_convert_channels(values, old_pulse);
+      uint16_t new_pulse = convert_channel(channel, value);
+      if (old_pulse[channel] != new_pulse) {
+        if (mismatches < 20) {
+          printf("  MISMATCH %s(%d): old %u, table %u\n", check.name, value, old_pulse[channel], new_pulse);
+        }
+        mismatches++;
+      }
+    }
+  }
+  printf("compared every input of every channel: %d mismatches, %d wrapped inputs skipped\n", mismatches, skipped);
+  return mismatches;
+}
+
+
+/***** compare_calibration() ###
+  Returns the number of inputs where tables built from a calibration differ
+    from the compile time tables
+*/
+int compare_calibration(const Calibration& calibration, const char * name) {
+  CalibratedTables tables;
+  tables.calibration = calibration;
+  build_calibrated_tables(tables);
+
+  int mismatches = 0;
+  for (int channel = 0; channel < PULSE_CHANNEL_COUNT; channel++) {
+    const ChannelCheck& check = CHANNEL_CHECKS[channel];
+    for (int value = check.min; value <= check.max; value++) {
+      int16_t values[PULSE_CHANNEL_COUNT] = { 0 };
+      uint16_t pulse[PULSE_CHANNEL_COUNT];
+      values[channel] = value;
+      convert_channels(tables.channel, values, pulse);
+      if (pulse[channel] != convert_channel(channel, value)) {
+        if (mismatches < 20) {
+          printf("  MISMATCH %s %s(%d): calibrated %u, table %u\n", name, check.name, value,
+                 pulse[channel], convert_channel(channel, value));
+        }
+        mismatches++;
+      }
+    }
+  }
+  printf("compared %s calibration tables: %d mismatches\n", name, mismatches);
+  return mismatches;
+}
+
+
+//----------  T I M I N G  ---------
+double now_seconds() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// # Commands made of values the teleop actually sends (every input of every domain)
+#define COMMAND_COUNT (DRIVE_TABLE_MAX - DRIVE_TABLE_MIN + 1)
+int16_t commands[COMMAND_COUNT][PULSE_CHANNEL_COUNT];
+uint16_t pulses[PULSE_CHANNEL_COUNT];
+
+void fill_commands() {
+  for (int i = 0; i < COMMAND_COUNT; i++) {
+    for (int channel = 0; channel < PULSE_CHANNEL_COUNT; channel++) {
+      const ChannelCheck& check = CHANNEL_CHECKS[channel];
+      int value = check.min + (i * 7 + channel * 13) % (check.max - check.min + 1);
+      // Keep the comparison fair (no wrapped inputs in either benchmark)
+      commands[i][channel] = wraps(channel, value) ? 0 : value;
+    }
+  }
+}
+
+/***** time_conversion() ###
+  Returns the nanoseconds per converted command
+*/
+double time_conversion(void (*convert)(const int16_t *, uint16_t *), uint32_t& checksum) {
+  double start = now_seconds();
+  for (int pass = 0; pass < BENCHMARK_PASSES; pass++) {
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+      convert(commands[i], pulses);
+      checksum += pulses[i % PULSE_CHANNEL_COUNT];
+    }
+  }
+  return (now_seconds() - start) * 1e9 / ((double)BENCHMARK_PASSES * COMMAND_COUNT);
+}
+
+int main(int argc, char ** argv) {
+  int mismatches = compare_tables();
+
+  Calibration calibration;
+  default_calibration(calibration);
+  mismatches += compare_calibration(calibration, "default");
+  if (argc > 1) {
+    std::string error;
+    if (!load_calibration(argv[1], calibration, error)) {
+      printf("%s\n", error.c_str());
+      return 1;
+    }
+    mismatches += compare_calibration(calibration, argv[1]);
+  }
+
+  fill_commands();
+  uint32_t old_checksum = 0;
+  uint32_t new_checksum = 0;
+  double old_ns = time_conversion(old_convert_channels, old_checksum);
+  double new_ns = time_conversion(convert_channels, new_checksum);
+
+  printf("old conversion:   %7.2f ns/command (checksum %u)\n", old_ns, old_checksum);
+  printf("table conversion: %7.2f ns/command (checksum %u)\n", new_ns, new_checksum);
+  printf("speedup:          %7.2fx\n", old_ns / new_ns);
+
+  if (old_checksum != new_checksum) {
+    printf("CHECKSUMS DIFFER\n");
+    mismatches++;
+  }
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+#ifndef PULSE_TABLES_H
+#define PULSE_TABLES_H
+
+#include <stdint.h>
+#include <algorithm>
+
+/*-----------------------------------------------------------------------------------
+//---------------------   P U L S E   L O O K U P   T A B L E S   --------------------
+//-----------------------------------------------------------------------------------
+  Angle/speed to PWM pulse conversion for arduino_command_translator.
+
+  Every input the teleop can send is bounded (angles, claw 0-100, drive speed
+  +-2000, mast +-5), so the conversions are evaluated at compile time (C++11
+  constexpr) for every possible input and stored in one table per servo/motor
+  class.  At run time a conversion is a clamp (min/max, no branches) and a
+  table read.  convert_channels() converts all 15 RoverCommand channels in
+  one pass using the per-channel descriptors in CHANNEL_TABLES.
+
+  The *_pulse() functions below are the same math as the old double/long
+  conversion functions, except that the clamping is done before the result
+  is cast to uint16_t (the old angle_to_pulse() wrapped negative pulses
+  around to 65xxx, which then clamped to the servo *max*).
+*/
+
+
+//-----------------------------------------------------------------------------------
+//------------------------------   C O N S T A N T S   ------------------------------
+//-----------------------------------------------------------------------------------
+//----------   P W M    C O N S T A N T S   ----------
+#define PWM_FREQUENCY     50
+#define PWM_RESOLUTION    4096
+
+//----------   A R M   S E R V O   C O N S T A N T S   ----------
+// # Hitec HS-785HB 
+#define ARM_PWM_MIN          126  // "-315 degrees", min pulse length count (out of 4096@50Hz)
+#define ARM_PWM_MAX          504  // "+315 degrees", max pulse length count (out of 4096@50Hz)
+#define ARM_PWM_NEUTRAL      315  // "0 degrees", center pulse length count (out of 4096@50Hz)
+#define ARM_PWM_360_DEGREES  216  // "360 degrees", one full rotation
+
+//----------   S T E E R I N G   S E R V O   C O N S T A N T S   ----------
+#define STEER_PWM_MIN          105
+#define STEER_PWM_MAX          495 
+#define STEER_PWM_NEUTRAL      295
+#define STEER_PWM_360_DEGREES  720
+//#define STEER_PWM_360_DEGREES  716 // <--- ACTUAL VALUE ???
+
+//----------   G R I P P E R   S E R V O   C O N S T A N T S   ----------
+// # Hitec HS-422 (gripper rotation servo)
+#define GRIPPER_ROTATE_PWM_MIN         105
+#define GRIPPER_ROTATE_PWM_MAX         495
+#define GRIPPER_ROTATE_PWM_NEUTRAL     295
+#define GRIPPER_ROTATE_PWM_360_DEGREES 720
+// # Hitec HS-322HD (gripper claw servo)
+#define GRIPPER_CLAW_CONSTANT    100.0
+#define GRIPPER_CLAW_PWM_CLOSED 276
+#define GRIPPER_CLAW_PWM_OPEN   355
+
+//----------   D C   M O T O R   C O N S T A N T S   ----------
+// # If the motor pwms are too close to neutral (4096/2 +- ~5%)
+//#define FORWARD_DEADZONE_CUTOFF_PWM  2248 // Max DC motor pwm
+//#define REVERSE_DEADZONE_CUTOFF_PWM  1848 // Min DC motor pwm
+#define MAX_FORWARD_SPEED_PWM  345  // avoid extremes (SHOULD BE 345)
+#define MAX_REVERSE_SPEED_PWM  248  // avoid extremes 
+#define NEUTRAL_SPEED_PWM      292 	// Stopped DC motor pwm
+
+//----------    M A S T   S E R V O   C O N S T A N T S   ----------
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// !!!   NOTE THAT THE MAST SERVO IS CONTINUOUS ROTATION   !!!
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+#define MAST_SERVO_PWM_MAX 315
+#define MAST_SERVO_PWM_MIN 305
+#define MAST_SERVO_PWM_IMMOBILE 310
+
+//----------   T A B L E   D O M A I N S   ----------
+// # Inputs outside of these are clamped to the closest end
+#define ANGLE_TABLE_MIN  -360
+#define ANGLE_TABLE_MAX   360
+#define CLAW_TABLE_MIN      0
+#define CLAW_TABLE_MAX    100
+#define DRIVE_TABLE_MIN -2000
+#define DRIVE_TABLE_MAX  2000
+#define MAST_TABLE_MIN     -5
+#define MAST_TABLE_MAX      5
+
+#define PULSE_CHANNEL_COUNT 15
+
+
+//-----------------------------------------------------------------------------------
+//--------------------   C O N V E R S I O N   F U N C T I O N S   ------------------
+//-----------------------------------------------------------------------------------
+/***** Converting angles to PWM pulses
+  PWM_pulse = <neutral_pwm> + (angle/360) * <full_turn_pwm>, clamped to [min, max]
+*/
+constexpr uint16_t clamp_pulse(long pulse, int servo_min, int servo_max) {
+  return (uint16_t) (pulse < servo_min ? servo_min : (pulse > servo_max ? servo_max : pulse));
+}
+constexpr uint16_t angle_pulse(int angle, int servo_neutral, int servo_full_turn, int servo_min, int servo_max) {
+  return clamp_pulse(servo_neutral + ((long)angle * (long)servo_full_turn) / 360, servo_min, servo_max);
+}
+constexpr uint16_t arm_pulse(int angle) {
+  return angle_pulse(angle, ARM_PWM_NEUTRAL, ARM_PWM_360_DEGREES, ARM_PWM_MIN, ARM_PWM_MAX);
+}
+constexpr uint16_t steer_pulse(int angle) {
+  return angle_pulse(angle, STEER_PWM_NEUTRAL, STEER_PWM_360_DEGREES, STEER_PWM_MIN, STEER_PWM_MAX);
+}
+constexpr uint16_t gripper_rotate_pulse(int angle) {
+  return angle_pulse(angle, GRIPPER_ROTATE_PWM_NEUTRAL, GRIPPER_ROTATE_PWM_360_DEGREES,
+    GRIPPER_ROTATE_PWM_MIN, GRIPPER_ROTATE_PWM_MAX);
+}
+
+/***** claw_pulse() ###
+  0 = open, 100 = closed
+*/
+constexpr uint16_t claw_pulse(int claw, int servo_open, int servo_closed) {
+  return (uint16_t) (servo_open - ((claw * 1.0) / GRIPPER_CLAW_CONSTANT) * (servo_open - servo_closed));
+}
+constexpr uint16_t gripper_claw_pulse(int claw) {
+  return claw_pulse(claw, GRIPPER_CLAW_PWM_OPEN, GRIPPER_CLAW_PWM_CLOSED);
+}
+
+/***** speed_pulse() ###
+  Forward and reverse speeds are scaled separately so +-2000 reaches
+    max_forward / max_reverse and 0 is exactly neutral
+*/
+constexpr uint16_t speed_pulse(int speed, int neutral, int max_reverse, int max_forward) {
+  return (uint16_t) (speed < 0 ? neutral + ((speed * 1.0) / 2000) * (neutral - max_reverse) :
+                     speed > 0 ? neutral + ((speed * 1.0) / 2000) * (max_forward - neutral) :
+                                 neutral);
+}
+constexpr uint16_t drive_pulse(int speed) {
+  return speed_pulse(speed, NEUTRAL_SPEED_PWM, MAX_REVERSE_SPEED_PWM, MAX_FORWARD_SPEED_PWM);
+}
+
+/***** offset_pulse() ###
+  Continuous rotation servo: PWM_pulse = <immobile_pwm> + speed, clamped to [min, max]
+*/
+constexpr uint16_t offset_pulse(int speed, int immobile, int servo_min, int servo_max) {
+  return clamp_pulse(immobile + speed, servo_min, servo_max);
+}
+constexpr uint16_t mast_pulse(int speed) {
+  return offset_pulse(speed, MAST_SERVO_PWM_IMMOBILE, MAST_SERVO_PWM_MIN, MAST_SERVO_PWM_MAX);
+}
+
+
+//-----------------------------------------------------------------------------------
+//--------------------   T A B L E   G E N E R A T I O N   --------------------------
+//-----------------------------------------------------------------------------------
+// # Index sequence 0..N-1, built by halves so the template depth stays log2(N)
+//   (the drive table has 4001 entries, more than the compiler's recursion limit)
+template<int... I> struct index_seq {};
+
+template<class A, class B> struct concat_seq;
+template<int... A, int... B> struct concat_seq<index_seq<A...>, index_seq<B...> > {
+  typedef index_seq<A..., (int)sizeof...(A) + B...> type;
+};
+
+template<int N> struct make_index_seq {
+  typedef typename concat_seq<typename make_index_seq<N / 2>::type,
+                              typename make_index_seq<N - N / 2>::type>::type type;
+};
+template<> struct make_index_seq<0> { typedef index_seq<> type; };
+template<> struct make_index_seq<1> { typedef index_seq<0> type; };
+
+// # One pulse per input in [LO, HI]
+template<int LO, int HI> struct PulseTable {
+  static const int SIZE = HI - LO + 1;
+  uint16_t pulse[SIZE];
+};
+
+template<int LO, int HI, int... I>
+constexpr PulseTable<LO, HI> make_pulse_table(uint16_t (*convert)(int), index_seq<I...>) {
+  return PulseTable<LO, HI>{ { convert(LO + I)... } };
+}
+
+template<int LO, int HI>
+constexpr PulseTable<LO, HI> make_pulse_table(uint16_t (*convert)(int)) {
+  return make_pulse_table<LO, HI>(convert, typename make_index_seq<HI - LO + 1>::type());
+}
+
+//----------   T A B L E S   ----------
+constexpr PulseTable<ANGLE_TABLE_MIN, ANGLE_TABLE_MAX> ARM_PULSE_TABLE =
+  make_pulse_table<ANGLE_TABLE_MIN, ANGLE_TABLE_MAX>(arm_pulse);
+constexpr PulseTable<ANGLE_TABLE_MIN, ANGLE_TABLE_MAX> STEER_PULSE_TABLE =
+  make_pulse_table<ANGLE_TABLE_MIN, ANGLE_TABLE_MAX>(steer_pulse);
+constexpr PulseTable<ANGLE_TABLE_MIN, ANGLE_TABLE_MAX> GRIPPER_ROTATE_PULSE_TABLE =
+  make_pulse_table<ANGLE_TABLE_MIN, ANGLE_TABLE_MAX>(gripper_rotate_pulse);
+constexpr PulseTable<CLAW_TABLE_MIN, CLAW_TABLE_MAX> GRIPPER_CLAW_PULSE_TABLE =
+  make_pulse_table<CLAW_TABLE_MIN, CLAW_TABLE_MAX>(gripper_claw_pulse);
+constexpr PulseTable<DRIVE_TABLE_MIN, DRIVE_TABLE_MAX> DRIVE_PULSE_TABLE =
+  make_pulse_table<DRIVE_TABLE_MIN, DRIVE_TABLE_MAX>(drive_pulse);
+constexpr PulseTable<MAST_TABLE_MIN, MAST_TABLE_MAX> MAST_PULSE_TABLE =
+  make_pulse_table<MAST_TABLE_MIN, MAST_TABLE_MAX>(mast_pulse);
+
+
+//-----------------------------------------------------------------------------------
+//--------------------   C H A N N E L   C O N V E R S I O N   ----------------------
+//-----------------------------------------------------------------------------------
+// # How one RoverCommand channel is converted
+struct ChannelTable {
+  const uint16_t * zero;  // Table entry for an input of 0
+  int min;                // Smallest input in the table
+  int max;                // Largest input in the table
+  int sign;               // -1 for servos/motors mounted backwards
+};
+
+// # Same order as the RoverCommand channels (and the arduino_cmd array)
+constexpr ChannelTable CHANNEL_TABLES[PULSE_CHANNEL_COUNT] = {
+  { ARM_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,            ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Arm Base
+  { ARM_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,            ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Arm Shoulder
+  { ARM_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,            ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Arm Elbow
+  { ARM_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,            ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Arm Wrist
+  { STEER_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,          ANGLE_TABLE_MIN, ANGLE_TABLE_MAX, -1 }, // Rear Steer (mounted backwards)
+  { STEER_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,          ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Front Right Steer
+  { STEER_PULSE_TABLE.pulse - ANGLE_TABLE_MIN,          ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Front Left Steer
+  { DRIVE_PULSE_TABLE.pulse - DRIVE_TABLE_MIN,          DRIVE_TABLE_MIN, DRIVE_TABLE_MAX, -1 }, // Rear Drive (mounted backwards)
+  { DRIVE_PULSE_TABLE.pulse - DRIVE_TABLE_MIN,          DRIVE_TABLE_MIN, DRIVE_TABLE_MAX,  1 }, // Side Right Drive
+  { DRIVE_PULSE_TABLE.pulse - DRIVE_TABLE_MIN,          DRIVE_TABLE_MIN, DRIVE_TABLE_MAX,  1 }, // Side Left Drive
+  { DRIVE_PULSE_TABLE.pulse - DRIVE_TABLE_MIN,          DRIVE_TABLE_MIN, DRIVE_TABLE_MAX,  1 }, // Front Right Drive
+  { DRIVE_PULSE_TABLE.pulse - DRIVE_TABLE_MIN,          DRIVE_TABLE_MIN, DRIVE_TABLE_MAX,  1 }, // Front Left Drive
+  { GRIPPER_ROTATE_PULSE_TABLE.pulse - ANGLE_TABLE_MIN, ANGLE_TABLE_MIN, ANGLE_TABLE_MAX,  1 }, // Gripper Rotate
+  { GRIPPER_CLAW_PULSE_TABLE.pulse - CLAW_TABLE_MIN,    CLAW_TABLE_MIN,  CLAW_TABLE_MAX,   1 }, // Gripper Claw
+  { MAST_PULSE_TABLE.pulse - MAST_TABLE_MIN,            MAST_TABLE_MIN,  MAST_TABLE_MAX,   1 }  // Mast
+};
+
+/***** convert_channel() ###
+  Converts one channel value to its PWM pulse
+*/
+inline uint16_t convert_channel(int channel, int16_t value) {
+  const ChannelTable& table = CHANNEL_TABLES[channel];
+  int input = std::min(std::max(value * table.sign, table.min), table.max);
+  return table.zero[input];
+}
+
+/***** convert_channels() ###
+  Same as below, with tables built at run time (see calibration.h)
+*/
+inline void convert_channels(const ChannelTable * tables, const int16_t * value, uint16_t * pulse) {
+  for (int channel = 0; channel < PULSE_CHANNEL_COUNT; channel++) {
+    const ChannelTable& table = tables[channel];
+    int input = std::min(std::max(value[channel] * table.sign, table.min), table.max);
+    pulse[channel] = table.zero[input];
+  }
+}
+
+// # Expanded once per channel, so the descriptor of every channel is a compile time constant
+template<int... CHANNEL>
+inline void convert_channels(const int16_t * value, uint16_t * pulse, index_seq<CHANNEL...>) {
+  int expand[] = { (pulse[CHANNEL] = convert_channel(CHANNEL, value[CHANNEL]), 0)... };
+  (void) expand;
+}
+
+/***** convert_channels() ###
+  Converts every channel of a RoverCommand to its PWM pulse in one pass
+  @INPUT value - PULSE_CHANNEL_COUNT channel values
+  @OUTPUT pulse - PULSE_CHANNEL_COUNT PWM pulses
+*/
+inline void convert_channels(const int16_t * value, uint16_t * pulse) {
+  convert_channels(value, pulse, make_index_seq<PULSE_CHANNEL_COUNT>::type());
+}
+
+#endif
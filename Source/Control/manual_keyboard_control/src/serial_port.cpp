@@ -0,0 +1,91 @@
+#include "serial_port.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+/***** baud_to_speed() ***
+    Converts a baud rate to its termios speed, B0 if it is not a standard rate    */
+static speed_t baud_to_speed(int baud) {
+    switch (baud) {
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 500000: return B500000;
+        case 921600: return B921600;
+        default:     return B0;
+    }
+}
+
+int open_serial_port(const char * path, int baud) {
+    speed_t speed = baud_to_speed(baud);
+    if (speed == B0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct termios options;
+    if (tcgetattr(fd, &options) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&options);
+    options.c_cflag |= CLOCAL | CREAD;
+    options.c_cflag &= ~(CSTOPB | CRTSCTS);
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 0;
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    if (tcsetattr(fd, TCSANOW, &options) != 0) {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+bool write_serial_port(int fd, const uint8_t * data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+int read_serial_port(int fd, uint8_t * buffer, size_t length, int timeout_ms) {
+    struct pollfd readable;
+    readable.fd = fd;
+    readable.events = POLLIN;
+    int ready = poll(&readable, 1, timeout_ms);
+    if (ready <= 0) {
+        return (ready < 0 && errno == EINTR) ? 0 : ready;
+    }
+    ssize_t count = read(fd, buffer, length);
+    if (count < 0) {
+        return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    }
+    return (int) count;
+}
+
+void close_serial_port(int fd) {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Raw (termios) serial port access, for sending binary frames straight to the arduino */
+
+/***** open_serial_port() ***
+    Opens a tty in raw 8N1 mode, no flow control
+    @INPUT const char * path - device (/dev/ttyACM0, or a pseudo-terminal for testing)
+    @INPUT int baud          - a standard baud rate (9600 ... 921600)
+    @RETURN the file descriptor, -1 on error (errno is set)    */
+int open_serial_port(const char * path, int baud);
+
+/***** write_serial_port() ***
+    Writes every byte, retrying short writes
+    @RETURN false on error (errno is set)    */
+bool write_serial_port(int fd, const uint8_t * data, size_t length);
+
+/***** read_serial_port() ***
+    Reads whatever has been received, waiting up to timeout_ms for something to arrive
+    @RETURN the number of bytes read, 0 on timeout, -1 on error (errno is set)    */
+int read_serial_port(int fd, uint8_t * buffer, size_t length, int timeout_ms);
+
+void close_serial_port(int fd);
+
+#endif
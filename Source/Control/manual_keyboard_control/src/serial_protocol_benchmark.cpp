@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "serial_port.h"
+#include <RoverProtocol.h>    // Source/Arduino/libraries/RoverProtocol
+
+/*----------    S E R I A L   P R O T O C O L   B E N C H M A R K    ----------
+  Sends command frames through a pseudo-terminal pair (openpty) and decodes
+  them on the other side, the way the arduino does, for:
+    - binary   : RoverProtocol frames (arduino_command_translator _transport:=binary)
+    - rosserial: UInt16MultiArray keyframes and one channel delta frames, framed
+                 and deserialized the way rosserial (hydro and newer) does it
+
+  $ rosrun manual_keyboard_control serial_protocol_benchmark [frames]
+
+  A pty has no baud rate, so frames/s is the CPU cost of writing, framing and
+  decoding.  "wire" is how many frames/s fit through a real 115200 baud link
+  (10 bits per byte), and is what limits the rover.
+  Latency is measured one frame at a time (send, wait until it is decoded).
+  Exits with 1 if a frame is lost or decoded wrong.
+*/
+
+#define DEFAULT_FRAMES   20000
+#define LINK_BAUD        115200
+
+//----------  R O S S E R I A L   F R A M I N G  ---------
+#define ROSSERIAL_TOPIC_ID  100   // First subscriber topic id
+
+/***** rosserial_encode() ***
+  Frames a UInt16MultiArray (no layout dims) like rosserial_python does
+  @RETURN frame length    */
+size_t rosserial_encode(uint8_t * buffer, const uint16_t * data, uint32_t count) {
+  uint8_t payload[12 + 2 * ROVER_CHANNEL_COUNT + 2];
+  size_t length = 0;
+  // layout.dim (none), layout.data_offset, data length, data
+  for (int i = 0; i < 8; i++) payload[length++] = 0;
+  for (int i = 0; i < 4; i++) payload[length++] = (count >> (8 * i)) & 0xFF;
+  for (uint32_t i = 0; i < count; i++) {
+    payload[length++] = data[i] & 0xFF;
+    payload[length++] = data[i] >> 8;
+  }
+
+  size_t n = 0;
+  buffer[n++] = 0xFF;
+  buffer[n++] = 0xFE;
+  buffer[n++] = length & 0xFF;
+  buffer[n++] = length >> 8;
+  buffer[n++] = 255 - (((length & 0xFF) + (length >> 8)) % 256);
+  buffer[n++] = ROSSERIAL_TOPIC_ID & 0xFF;
+  buffer[n++] = ROSSERIAL_TOPIC_ID >> 8;
+  int checksum = (ROSSERIAL_TOPIC_ID & 0xFF) + (ROSSERIAL_TOPIC_ID >> 8);
+  for (size_t i = 0; i < length; i++) {
+    buffer[n++] = payload[i];
+    checksum += payload[i];
+  }
+  buffer[n++] = 255 - (checksum % 256);
+  return n;
+}
+
+// # Same states as ros::NodeHandle_::spinOnce()
+struct RosserialDecoder {
+  enum { FIRST_FF, PROTOCOL_VER, SIZE_L, SIZE_H, SIZE_CHECKSUM, TOPIC_L, TOPIC_H, MESSAGE, MSG_CHECKSUM } mode;
+  uint8_t  message_in[128];
+  int      bytes, index, topic, checksum;
+  uint32_t data_length;
+  uint16_t data[ROVER_CHANNEL_COUNT];
+
+  RosserialDecoder() : mode(FIRST_FF), bytes(0), index(0), topic(0), checksum(0), data_length(0) {}
+
+  // # UInt16MultiArray::deserialize() (generated code, byte at a time)
+  void deserialize(const uint8_t * inbuffer) {
+    int offset = 0;
+    uint32_t dim_length = 0;
+    for (int i = 0; i < 4; i++) dim_length |= ((uint32_t) inbuffer[offset + i]) << (8 * i);
+    offset += 4 + 12 * dim_length;  // (no dims are sent)
+    offset += 4;                    // data_offset
+    uint32_t length = 0;
+    for (int i = 0; i < 4; i++) length |= ((uint32_t) inbuffer[offset + i]) << (8 * i);
+    offset += 4;
+    data_length = std::min<uint32_t>(length, ROVER_CHANNEL_COUNT);
+    for (uint32_t i = 0; i < data_length; i++) {
+      uint16_t value = 0;
+      value |= ((uint16_t) inbuffer[offset + 0]) << 0;
+      value |= ((uint16_t) inbuffer[offset + 1]) << 8;
+      data[i] = value;
+      offset += 2;
+    }
+  }
+
+  bool push(uint8_t data) {
+    checksum += data;
+    switch (mode) {
+      case FIRST_FF:
+        if (data == 0xFF) { mode = PROTOCOL_VER; }
+        checksum = 0;
+        return false;
+      case PROTOCOL_VER:
+        mode = (data == 0xFE) ? SIZE_L : FIRST_FF;
+        return false;
+      case SIZE_L:
+        bytes = data; index = 0; mode = SIZE_H; checksum = data;
+        return false;
+      case SIZE_H:
+        bytes += data << 8; mode = SIZE_CHECKSUM;
+        return false;
+      case SIZE_CHECKSUM:
+        mode = ((checksum % 256) == 255 && bytes <= (int) sizeof(message_in)) ? TOPIC_L : FIRST_FF;
+        return false;
+      case TOPIC_L:
+        topic = data; mode = TOPIC_H; checksum = data;
+        return false;
+      case TOPIC_H:
+        topic += data << 8; mode = bytes == 0 ? MSG_CHECKSUM : MESSAGE;
+        return false;
+      case MESSAGE:
+        message_in[index++] = data;
+        if (--bytes == 0) mode = MSG_CHECKSUM;
+        return false;
+      case MSG_CHECKSUM:
+        mode = FIRST_FF;
+        if ((checksum % 256) == 255 && topic == ROSSERIAL_TOPIC_ID) {
+          deserialize(message_in);
+          return true;
+        }
+        return false;
+    }
+    return false;
+  }
+};
+
+
+//----------  B E N C H M A R K  ---------
+enum Protocol { BINARY, ROSSERIAL_KEYFRAME, ROSSERIAL_DELTA };
+const char * PROTOCOL_NAMES[] = { "binary", "rosserial keyframe", "rosserial delta (1 ch)" };
+
+double now_seconds() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/***** pulse_of() ***
+  The pulse sent on a channel in a frame (so the reader can check it)    */
+uint16_t pulse_of(int frame, int channel) {
+  return (uint16_t) (100 + (frame * 7 + channel * 31) % 400);
+}
+
+/***** encode() ***
+  Encodes frame number "frame" in the given protocol
+  @RETURN frame length    */
+size_t encode(Protocol protocol, int frame, uint8_t * buffer) {
+  uint16_t data[ROVER_CHANNEL_COUNT];
+  if (protocol == BINARY) {
+    RoverFrame f;
+    f.seq = (uint8_t) frame;
+    f.type = ROVER_FRAME_COMMAND;
+    f.mask = ROVER_KEYFRAME_MASK;
+    for (int i = 0; i < ROVER_CHANNEL_COUNT; i++) f.pulse[i] = pulse_of(frame, i);
+    return rover_encode_frame(buffer, &f);
+  }
+  if (protocol == ROSSERIAL_KEYFRAME) {
+    for (int i = 0; i < ROVER_CHANNEL_COUNT; i++) data[i] = pulse_of(frame, i);
+    return rosserial_encode(buffer, data, ROVER_CHANNEL_COUNT);
+  }
+  data[0] = 0xF000 | 1;
+  data[1] = (uint16_t) ((frame % ROVER_CHANNEL_COUNT) << 12 | pulse_of(frame, 0));
+  return rosserial_encode(buffer, data, 2);
+}
+
+struct Result {
+  size_t frame_bytes;
+  double frames_per_second;
+  double latency_p50_us, latency_p99_us, latency_max_us;
+  int errors;
+};
+
+/***** run() ***
+  Sends "frames" frames through a fresh pty pair
+  @INPUT paced - wait for every frame to be decoded before sending the next    */
+void run(Protocol protocol, int frames, bool paced, Result& result) {
+  int master, slave;
+  if (openpty(&master, &slave, NULL, NULL, NULL) != 0) {
+    perror("openpty");
+    result.errors++;
+    return;
+  }
+  struct termios options;
+  tcgetattr(slave, &options);
+  cfmakeraw(&options);
+  tcsetattr(slave, TCSANOW, &options);
+
+  std::vector<double> sent(frames), decoded(frames);
+  std::atomic<int> decoded_count(0);
+  int errors = 0;
+
+  std::thread reader([&]() {
+    RoverDecoder binary;
+    RosserialDecoder rosserial;
+    rover_decoder_init(&binary);
+    uint8_t chunk[256];
+    int frame = 0;
+    while (frame < frames) {
+      ssize_t n = read(slave, chunk, sizeof(chunk));
+      if (n <= 0) break;
+      for (ssize_t i = 0; i < n; i++) {
+        bool complete = protocol == BINARY ? rover_decoder_push(&binary, chunk[i]) : rosserial.push(chunk[i]);
+        if (!complete) continue;
+        decoded[frame] = now_seconds();
+        if (protocol == BINARY) {
+          if (binary.frame.seq != (uint8_t) frame || binary.frame.pulse[3] != pulse_of(frame, 3)) errors++;
+        } else if (protocol == ROSSERIAL_KEYFRAME) {
+          if (rosserial.data_length != ROVER_CHANNEL_COUNT || rosserial.data[3] != pulse_of(frame, 3)) errors++;
+        } else if ((rosserial.data[1] & 0x0FFF) != pulse_of(frame, 0)) {
+          errors++;
+        }
+        frame++;
+        decoded_count.store(frame, std::memory_order_release);
+      }
+    }
+  });
+
+  uint8_t buffer[64];
+  double start = now_seconds();
+  for (int frame = 0; frame < frames; frame++) {
+    sent[frame] = now_seconds();
+    size_t length = encode(protocol, frame, buffer);
+    result.frame_bytes = length;
+    write_serial_port(master, buffer, length);
+    if (paced) {
+      while (decoded_count.load(std::memory_order_acquire) <= frame) {}
+    }
+  }
+  reader.join();
+  double elapsed = now_seconds() - start;
+
+  close(master);
+  close(slave);
+
+  int received = decoded_count.load();
+  result.errors += errors + (frames - received);
+  if (!paced) {
+    result.frames_per_second = received / elapsed;
+  } else {
+    std::vector<double> latency;
+    for (int i = 0; i < received; i++) latency.push_back((decoded[i] - sent[i]) * 1e6);
+    std::sort(latency.begin(), latency.end());
+    if (!latency.empty()) {
+      result.latency_p50_us = latency[latency.size() / 2];
+      result.latency_p99_us = latency[latency.size() * 99 / 100];
+      result.latency_max_us = latency.back();
+    }
+  }
+}
+
+int main(int argc, char ** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+  int errors = 0;
+
+  // A corrupted frame must be dropped
+  RoverDecoder decoder;
+  rover_decoder_init(&decoder);
+  uint8_t buffer[ROVER_FRAME_SIZE];
+  uint8_t length = encode(BINARY, 1, buffer);
+  buffer[10] ^= 0x04;
+  bool accepted = false;
+  for (int i = 0; i < length; i++) accepted |= rover_decoder_push(&decoder, buffer[i]);
+  if (accepted || decoder.crc_errors != 1) {
+    printf("corrupted binary frame was not rejected\n");
+    errors++;
+  }
+
+  printf("%d frames per run, through a pty pair\n\n", frames);
+  printf("%-24s %6s %12s %12s %10s %10s %10s\n", "protocol", "bytes", "frames/s", "wire fr/s", "p50 us", "p99 us", "max us");
+  for (int p = BINARY; p <= ROSSERIAL_DELTA; p++) {
+    Result result;
+    memset(&result, 0, sizeof(result));
+    run((Protocol) p, frames, false, result);
+    run((Protocol) p, frames / 10, true, result);
+    printf("%-24s %6zu %12.0f %12.0f %10.1f %10.1f %10.1f\n", PROTOCOL_NAMES[p], result.frame_bytes,
+           result.frames_per_second, LINK_BAUD / 10.0 / result.frame_bytes,
+           result.latency_p50_us, result.latency_p99_us, result.latency_max_us);
+    errors += result.errors;
+  }
+
+  if (errors > 0) {
+    printf("\n%d ERRORS\n", errors);
+  }
+  return errors == 0 ? 0 : 1;
+}
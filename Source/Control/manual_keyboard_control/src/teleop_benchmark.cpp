@@ -0,0 +1,463 @@
+#include "ros/ros.h"
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <keyboard/Key.h>
+#include <std_msgs/UInt16MultiArray.h>
+#include <manual_keyboard_control/RoverCommand.h>
+#include "manual_keyboard_control.h"
+#include "arduino_command_translator.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <string>
+#include <vector>
+
+/*----------    T E L E O P   B E N C H M A R K    ----------
+  Replays recorded keyboard/keydown and keyboard/keyup messages through the
+  teleop (manual_keyboard_control.cpp) and the translator
+  (arduino_command_translator.cpp) in one thread, on a simulated clock.
+  No roscore, keyboard or arduino is needed.
+
+  $ rosbag record -O keys.bag /keyboard/keydown /keyboard/keyup
+  $ rosrun manual_keyboard_control teleop_benchmark keys.bag [options]
+      --golden <file>  compare the arduino_cmd frames with a golden log
+      --record <file>  write the arduino_cmd frames as a golden log
+      --repeat <n>     replay the recording n times, back to back (default 1)
+      --polling        run the teleop at a fixed rate (~event_driven:=false)
+      --rate <hz>      control rate (default 20)
+
+  The clock jumps from one key event (or control step) to the next, so a
+  recording replays in a fraction of its length.  Reported:
+    - RoverCommands and arduino_cmd frames per second of CPU time
+    - CPU time (thread CPU clock) and heap allocations of each stage
+  Golden log: one line per arduino_cmd frame, "<sim time (s)> <word> <word> ...",
+  so two versions of the teleop or translator can be compared frame by frame.
+  Exits with 1 if the frames differ from the golden log.
+
+  A recording that does not end in .bag is a key stream in text, one event
+  per line, the times above 0 and in order (keys named as in
+  config/keymap.yaml, # starts a comment):
+    <time (s)> down|up <key>
+  test_data/teleop_keys.txt is one (driving, steering, the arm and gripper,
+  held and tapped keys).  To check that a change to the teleop or the
+  translator keeps the frames, record them with the tree before the change
+  and compare after it (from the package directory):
+  $ rosrun manual_keyboard_control teleop_benchmark test_data/teleop_keys.txt \
+      --record /tmp/teleop_golden.txt
+  $ rosrun manual_keyboard_control teleop_benchmark test_data/teleop_keys.txt \
+      --golden /tmp/teleop_golden.txt
+  A difference is either a bug or an intended change to the frames.
+*/
+
+#define DEFAULT_RATE    20.0
+#define DRAIN_LIMIT     60.0   // Most seconds of control steps after the last event (a key held at the end)
+#define PASS_GAP        1.0    // Seconds between two passes of the recording
+
+//----------  A L L O C A T I O N   C O U N T I N G  ---------
+uint64_t allocations = 0;
+
+void * operator new(size_t size) {
+  allocations++;
+  void * block = malloc(size ? size : 1);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+void * operator new(size_t size, const std::nothrow_t&) noexcept {
+  allocations++;
+  return malloc(size ? size : 1);
+}
+void * operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return operator new(size, std::nothrow);
+}
+void operator delete(void * block) noexcept {
+  free(block);
+}
+void operator delete[](void * block) noexcept {
+  free(block);
+}
+
+//----------  S T A G E S  ---------
+enum StageIndex { STAGE_TELEOP, STAGE_TRANSLATOR, STAGE_COUNT };
+
+struct Stage {
+  const char * name;
+  uint64_t calls;
+  uint64_t cpu_ns;
+  uint64_t allocations;
+};
+Stage stages[STAGE_COUNT] = {
+  { "teleop",     0, 0, 0 },  // keyDown()/keyUp()/control_step()
+  { "translator", 0, 0, 0 },  // rover_cmd_manual_callback() + translate_pending_commands()
+};
+
+uint64_t thread_cpu_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+struct StageTimer {
+  Stage& stage;
+  uint64_t start_ns;
+  uint64_t start_allocations;
+  StageTimer(Stage& s) : stage(s), start_ns(thread_cpu_ns()), start_allocations(allocations) {}
+  ~StageTimer() {
+    stage.cpu_ns += thread_cpu_ns() - start_ns;
+    stage.allocations += allocations - start_allocations;
+    stage.calls++;
+  }
+};
+
+//----------  R E P L A Y  ---------
+struct KeyEvent {
+  ros::Time time;       // When it was recorded
+  bool down;
+  keyboard::Key::ConstPtr key;
+};
+
+struct Frame {
+  ros::Time time;
+  std::vector<uint16_t> words;
+};
+
+std::vector<manual_keyboard_control::RoverCommandPtr> pending_commands;  // Published by the current teleop call
+std::vector<Frame> frames;                                               // Every arduino_cmd frame
+uint64_t rover_commands = 0;
+uint64_t control_steps = 0;
+
+/***** teleop_sink() ***
+  Keeps a RoverCommand until the teleop call returns (reserved, no allocation)  */
+void teleop_sink(const manual_keyboard_control::RoverCommandPtr& message) {
+  pending_commands.push_back(message);
+}
+
+/***** translator_sink() ***
+  Records a frame (the copy is not counted as the translator's allocation)  */
+void translator_sink(const std_msgs::UInt16MultiArrayPtr& message) {
+  uint64_t before = allocations;
+  frames.push_back(Frame());
+  frames.back().time = ros::Time::now();
+  frames.back().words = message->data;
+  allocations = before;
+}
+
+/***** translate_commands() ***
+  Hands the commands of the last teleop call to the translator  */
+void translate_commands() {
+  for (size_t i = 0; i < pending_commands.size(); i++) {
+    StageTimer timer(stages[STAGE_TRANSLATOR]);
+    rover_cmd_manual_callback(pending_commands[i]);
+    translate_pending_commands();
+  }
+  rover_commands += pending_commands.size();
+  pending_commands.clear();
+}
+
+void run_control_step(const ros::Time& time) {
+  ros::Time::setNow(time);
+  {
+    StageTimer timer(stages[STAGE_TELEOP]);
+    control_step();
+  }
+  control_steps++;
+  translate_commands();
+}
+
+/***** replay() ***
+  Replays the events once, with the control steps the timer would have run
+  @INPUT offset - added to every event time
+  @RETURN the simulated time of the last event or step  */
+ros::Time replay(const std::vector<KeyEvent>& events, const ros::Duration& offset, bool event_driven, double rate) {
+  ros::Duration period(1.0 / rate);
+  ros::Time next_step;    // Zero while the timer is stopped
+  ros::Time now = events.front().time + offset;
+  if (!event_driven) {
+    next_step = now;
+  }
+
+  for (size_t i = 0; i < events.size(); i++) {
+    ros::Time event_time = events[i].time + offset;
+    while (!next_step.isZero() && next_step <= event_time) {
+      now = next_step;
+      run_control_step(now);
+      next_step = (event_driven && !control_active()) ? ros::Time() : now + period;
+    }
+
+    now = event_time;
+    ros::Time::setNow(now);
+    {
+      StageTimer timer(stages[STAGE_TELEOP]);
+      if (events[i].down) {
+        keyDown(events[i].key);
+      } else {
+        keyUp(events[i].key);
+      }
+    }
+    translate_commands();
+    if (event_driven) {
+      // wake_control_loop() restarts the timer from the event
+      next_step = control_active() ? now + period : ros::Time();
+    }
+  }
+
+  // Whatever the timer would still do
+  ros::Time drain_end = now + ros::Duration(event_driven ? DRAIN_LIMIT : PASS_GAP);
+  while (!next_step.isZero() && next_step <= drain_end) {
+    now = next_step;
+    run_control_step(now);
+    next_step = (event_driven && !control_active()) ? ros::Time() : now + period;
+  }
+  return now;
+}
+
+/***** load_events() ***
+  Reads the keyboard/keydown and keyboard/keyup messages of a bag
+  @RETURN false if the bag can't be read  */
+bool load_events(const char * path, std::vector<KeyEvent>& events) {
+  try {
+    rosbag::Bag bag;
+    bag.open(path, rosbag::bagmode::Read);
+    std::vector<std::string> topics;
+    topics.push_back("keyboard/keydown");
+    topics.push_back("/keyboard/keydown");
+    topics.push_back("keyboard/keyup");
+    topics.push_back("/keyboard/keyup");
+    rosbag::View view(bag, rosbag::TopicQuery(topics));
+    for (rosbag::View::iterator m = view.begin(); m != view.end(); ++m) {
+      keyboard::Key::ConstPtr key = m->instantiate<keyboard::Key>();
+      if (key) {
+        KeyEvent event;
+        event.time = m->getTime();
+        event.down = m->getTopic().find("keydown") != std::string::npos;
+        event.key = key;
+        events.push_back(event);
+      }
+    }
+    bag.close();
+  } catch (const rosbag::BagException& e) {
+    printf("%s: %s\n", path, e.what());
+    return false;
+  }
+  return true;
+}
+
+/***** load_key_stream() ***
+  Reads the events of a text key stream (see the top of the file)
+  @RETURN false if the file can't be read or has a bad line  */
+bool load_key_stream(const char * path, std::vector<KeyEvent>& events) {
+  FILE * file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  int number = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    number++;
+    char * comment = strchr(line, '#');
+    if (comment != NULL) {
+      *comment = '\0';
+    }
+    double time;
+    char direction[8], name[32];
+    int fields = sscanf(line, "%lf %7s %31s", &time, direction, name);
+    if (fields <= 0) {
+      continue;  // Blank
+    }
+    uint16_t code;
+    std::string dir = (fields == 3) ? direction : "";
+    if (fields != 3 || time <= 0 || (!events.empty() && ros::Time(time) < events.back().time)
+        || (dir != "down" && dir != "up") || !parse_key_name(name, code)) {
+      printf("%s:%d: expected \"<time (s)> down|up <key>\"\n", path, number);
+      fclose(file);
+      return false;
+    }
+    keyboard::KeyPtr key(new keyboard::Key());
+    key->code = code;
+    key->header.stamp = ros::Time(time);
+    KeyEvent event;
+    event.time = key->header.stamp;
+    event.down = (dir == "down");
+    event.key = key;
+    events.push_back(event);
+  }
+  fclose(file);
+  return true;
+}
+
+//----------  G O L D E N   L O G  ---------
+bool write_golden(const char * path) {
+  FILE * file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  for (size_t i = 0; i < frames.size(); i++) {
+    fprintf(file, "%u.%09u", frames[i].time.sec, frames[i].time.nsec);
+    for (size_t j = 0; j < frames[i].words.size(); j++) {
+      fprintf(file, " %u", frames[i].words[j]);
+    }
+    fprintf(file, "\n");
+  }
+  fclose(file);
+  return true;
+}
+
+/***** compare_golden() ***
+  @RETURN the number of frames that differ (or are missing/extra), -1 if the log can't be read  */
+long compare_golden(const char * path) {
+  FILE * file = fopen(path, "r");
+  if (file == NULL) {
+    perror(path);
+    return -1;
+  }
+  long differences = 0;
+  size_t index = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    unsigned sec = 0, nsec = 0;
+    int used = 0;
+    if (sscanf(line, "%u.%u%n", &sec, &nsec, &used) != 2) {
+      continue;
+    }
+    std::vector<uint16_t> words;
+    const char * cursor = line + used;
+    unsigned word;
+    int length;
+    while (sscanf(cursor, " %u%n", &word, &length) == 1) {
+      words.push_back((uint16_t) word);
+      cursor += length;
+    }
+
+    bool same = index < frames.size() && frames[index].time.sec == sec
+             && frames[index].time.nsec == nsec && frames[index].words == words;
+    if (!same) {
+      if (differences == 0) {
+        printf("first difference at frame %zu (golden time %u.%09u)\n", index, sec, nsec);
+      }
+      differences++;
+    }
+    index++;
+  }
+  fclose(file);
+  if (index < frames.size()) {
+    if (differences == 0) {
+      printf("first difference at frame %zu (not in the golden log)\n", index);
+    }
+    differences += frames.size() - index;
+  }
+  return differences;
+}
+
+//----------  M A I N  ---------
+void print_usage() {
+  printf("usage: teleop_benchmark <bag or key stream> [--golden <file>] [--record <file>] [--repeat <n>] [--polling] [--rate <hz>]\n");
+}
+
+int main(int argc, char ** argv) {
+  const char * bag_path = NULL;
+  const char * golden_path = NULL;
+  const char * record_path = NULL;
+  int repeat = 1;
+  bool event_driven = true;
+  double rate = DEFAULT_RATE;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--golden" && i + 1 < argc) {
+      golden_path = argv[++i];
+    } else if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (arg == "--polling") {
+      event_driven = false;
+    } else if (arg == "--rate" && i + 1 < argc) {
+      rate = atof(argv[++i]);
+    } else if (bag_path == NULL && arg[0] != '-') {
+      bag_path = argv[i];
+    } else {
+      print_usage();
+      return 2;
+    }
+  }
+  if (bag_path == NULL || repeat < 1 || rate <= 0) {
+    print_usage();
+    return 2;
+  }
+
+  std::vector<KeyEvent> events;
+  std::string path = bag_path;
+  bool bag = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bag") == 0;
+  if (!(bag ? load_events(bag_path, events) : load_key_stream(bag_path, events))) {
+    return 2;
+  }
+  if (events.empty()) {
+    printf("%s: no keyboard/keydown or keyboard/keyup messages\n", bag_path);
+    return 2;
+  }
+
+  // Simulated clock (ros::Time::now() returns whatever was set last)
+  ros::Time::init();
+  ros::Time::setNow(events.front().time);
+  start_manual_keyboard_control_offline(teleop_sink, event_driven, rate);
+  start_arduino_command_translator_offline(translator_sink);
+  pending_commands.reserve(64);
+
+  ros::Duration pass_length = events.back().time - events.front().time + ros::Duration(PASS_GAP);
+  ros::Time end;
+  for (int pass = 0; pass < repeat; pass++) {
+    ros::Duration offset(pass_length.toSec() * pass);
+    end = replay(events, offset, event_driven, rate);
+  }
+
+  uint64_t total_ns = 0;
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    total_ns += stages[stage].cpu_ns;
+  }
+  double total_s = total_ns / 1e9;
+  int downs = 0;
+  for (size_t i = 0; i < events.size(); i++) {
+    downs += events[i].down ? 1 : 0;
+  }
+
+  printf("key events:         %zu x %d (%d down, %zu up)\n", events.size(), repeat, downs, events.size() - downs);
+  printf("simulated time:     %.3f s\n", (end - events.front().time).toSec());
+  printf("control steps:      %llu\n", (unsigned long long) control_steps);
+  printf("RoverCommands:      %llu (%.0f/s of CPU time)\n", (unsigned long long) rover_commands,
+         total_s > 0 ? rover_commands / total_s : 0.0);
+  printf("arduino_cmd frames: %zu (%.0f/s of CPU time)\n", frames.size(), total_s > 0 ? frames.size() / total_s : 0.0);
+  printf("%-12s %10s %12s %12s %14s\n", "stage", "calls", "CPU ms", "us/call", "allocs/call");
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    const Stage& s = stages[stage];
+    printf("%-12s %10llu %12.3f %12.3f %14.2f\n", s.name, (unsigned long long) s.calls, s.cpu_ns / 1e6,
+           s.calls ? s.cpu_ns / 1e3 / s.calls : 0.0, s.calls ? (double) s.allocations / s.calls : 0.0);
+  }
+
+  if (record_path != NULL) {
+    if (!write_golden(record_path)) {
+      return 2;
+    }
+    printf("wrote %zu frames to %s\n", frames.size(), record_path);
+  }
+  if (golden_path != NULL) {
+    long differences = compare_golden(golden_path);
+    if (differences < 0) {
+      return 2;
+    }
+    if (differences > 0) {
+      printf("GOLDEN LOG DIFFERS: %ld frames\n", differences);
+      return 1;
+    }
+    printf("golden log matches (%zu frames)\n", frames.size());
+  }
+  return 0;
+}